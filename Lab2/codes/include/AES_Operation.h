@@ -0,0 +1,58 @@
+// AES-128/256 的 CTR 与 GCM 模式。运行时检测到 AES-NI 与 PCLMULQDQ 时，CTR 每次流水处理 8 个分组，
+// GHASH 每 4 个分组只做一次约减；否则使用常数时间的软件实现（位切片 S 盒、无查表的 GF(2^128) 乘法），
+// 执行时间与访存模式都不依赖密钥和数据
+#ifndef ENCCHAT_AESOP_H
+#define ENCCHAT_AESOP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define AES_BLOCK_SIZE 16
+#define AES_MAX_ROUNDS 14
+#define AES_GCM_NONCE_SIZE 12
+#define AES_GCM_TAG_SIZE 16
+#define AES_GCM_CHUNK_SIZE 4096         // GCM 按块交替做 CTR 与 GHASH，数据在两遍之间留在 L1 中
+
+class AesOp {
+private:
+    alignas(16) uint8_t roundKeys[(AES_MAX_ROUNDS + 1) * AES_BLOCK_SIZE];
+    alignas(16) uint8_t hashKeyPowers[4][AES_BLOCK_SIZE];  // PCLMUL 路径：H^1..H^4（字节反序）
+    uint64_t hashKey[2];                                    // 软件路径：H（大端的高低 64 位）
+    int rounds;
+
+    void EncryptBlocksGeneric(const uint8_t* in, uint8_t* out, size_t blocks) const;
+    void CtrGeneric(uint8_t* counter, const uint8_t* in, uint8_t* out, size_t length) const;
+    void CtrAesNi(uint8_t* counter, const uint8_t* in, uint8_t* out, size_t length) const;
+    void GhashGeneric(uint8_t* state, const uint8_t* data, size_t length) const;
+    void GhashPclmul(uint8_t* state, const uint8_t* data, size_t length) const;
+    void PrecomputePclmul();
+
+    // counter 的低 32 位按大端递增（GCM 的 inc32），处理完后指向下一个未用的计数器分组
+    void Ctr(uint8_t* counter, const uint8_t* in, uint8_t* out, size_t length) const;
+    // 吸收 data，末尾不足一个分组时补零
+    void Ghash(uint8_t* state, const uint8_t* data, size_t length) const;
+    void GcmTag(uint8_t* state, const uint8_t* nonce, size_t aadLength, size_t length, uint8_t* tag) const;
+
+public:
+    AesOp();
+    // length 为 16 或 32 字节
+    void SetKey(const uint8_t* key, int length);
+    void EncryptBlock(const uint8_t* in, uint8_t* out) const;
+    inline int KeyLength() const { return (rounds - 6) * 4; };
+    // 取回密钥（即前 KeyLength() 字节的轮密钥）
+    inline void GetKey(uint8_t* key) const { memcpy(key, roundKeys, KeyLength()); };
+
+    // CTR：初始计数器分组为 nonce || 00000000，加密与解密相同，in 与 out 可以相同
+    void CtrCrypt(const uint8_t* nonce, const char* in, char* out, size_t length) const;
+    // GCM（96 位 nonce）：加密 in 并输出 AES_GCM_TAG_SIZE 字节的标签，in 与 out 可以相同
+    void GcmSeal(const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                 const char* in, char* out, size_t length, uint8_t* tag) const;
+    // 校验标签并解密；标签不符时返回 false（此时 out 中的内容不可使用）
+    bool GcmOpen(const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                 const char* in, char* out, size_t length, const uint8_t* tag) const;
+
+    static bool HasAesNi();
+};
+
+#endif
@@ -0,0 +1,52 @@
+// 握手准入控制：每个握手都要做 RSA 解密与会话密钥编排（在 CryptoWorkers 上），连接风暴会挤占已建立会话的 CPU。
+// 每个来源地址一个令牌桶，在接受连接时就拒绝超过速率的来源；全局一个令牌桶限制每秒处理的密钥报文数，
+// 收到完整密钥报文的握手先进入服务器的有界队列，在每轮事件末尾、已建立会话的消息处理完之后按令牌出队
+#ifndef ENCCHAT_ADMISSION_H
+#define ENCCHAT_ADMISSION_H
+
+#include <cstdint>
+#include <unordered_map>
+
+#define ADMISSION_RATE_ENV "ENCCHAT_HANDSHAKE_RATE"                     // 全局每秒处理的握手数，0 表示不限
+#define ADMISSION_SOURCE_RATE_ENV "ENCCHAT_HANDSHAKE_RATE_PER_SOURCE"   // 每个来源地址每秒的新连接数，0 表示不限
+#define ADMISSION_DEFAULT_RATE 2000
+#define ADMISSION_DEFAULT_SOURCE_RATE 200
+#define ADMISSION_MAX_SOURCES 65536         // 来源桶超过这么多时清理已经回满的
+
+// 令牌桶：每秒补充 rate 个令牌，最多积累一秒的量；rate 为 0 时不限速
+class TokenBucket {
+private:
+    double rate;
+    double tokens;
+    uint64_t last;                  // 上次补充的时间（纳秒）
+
+    void Refill(uint64_t now);
+
+public:
+    TokenBucket(double rate = 0, uint64_t now = 0);
+    bool Take(uint64_t now);
+    // 桶已回满：这个来源最近一秒没有连接，可以丢弃它的状态
+    bool Full(uint64_t now) const;
+    // 距下一个令牌的纳秒数，现在就有时为 0
+    uint64_t NanosUntilToken(uint64_t now) const;
+};
+
+class HandshakeAdmission {
+private:
+    double sourceRate;
+    TokenBucket global;
+    std::unordered_map<uint32_t, TokenBucket> sources;      // 以 IPv4 地址为键
+
+    void Prune(uint64_t now);
+
+public:
+    // 读取 ADMISSION_RATE_ENV 与 ADMISSION_SOURCE_RATE_ENV
+    HandshakeAdmission();
+    // 接受连接时：这个来源是否还有令牌
+    bool AdmitSource(uint32_t address, uint64_t now);
+    // 处理一个密钥报文前取一个全局令牌
+    inline bool Take(uint64_t now) { return global.Take(now); };
+    inline uint64_t NanosUntilToken(uint64_t now) const { return global.NanosUntilToken(now); };
+};
+
+#endif
@@ -0,0 +1,23 @@
+// 协程版的 RSA 密钥交换：在 AsyncSocket 上按顺序收发握手报文，等待对端时挂起而不是阻塞线程
+#ifndef ENCCHAT_ASYNCPROTOCOL_H
+#define ENCCHAT_ASYNCPROTOCOL_H
+
+#include <cstdint>
+#include "AsyncSocket.h"
+#include "Coroutine.h"
+#include "Protocol.h"
+
+enum HandshakeStatus {
+    HANDSHAKE_DONE,
+    HANDSHAKE_SEND_FAILED,              // 发送 Hello / Key 失败
+    HANDSHAKE_TIMEOUT,                  // 等待对端报文超时
+    HANDSHAKE_RECV_FAILED               // 对端关闭或接收出错
+};
+
+// 服务器：发送公钥与 offered 特性，在 timeoutMs 内收齐加密的会话密钥并建立会话密码状态
+Task<HandshakeStatus> AcceptHandshake(AsyncSocket& socket, RSA& rsa, SessionCrypto& crypto, int timeoutMs,
+                                      uint64_t offered = HANDSHAKE_FEATURES_SUPPORTED);
+// 客户端：生成 DES 会话密钥，在 timeoutMs 内收齐公钥后加密发送；features 为希望启用的可选特性
+Task<HandshakeStatus> ConnectHandshake(AsyncSocket& socket, SessionCrypto& crypto, uint64_t features, int timeoutMs);
+
+#endif
@@ -0,0 +1,84 @@
+// 可等待的 socket：把非阻塞 fd 以边沿触发注册到 EventLoop，协程在 EAGAIN 时挂起，
+// 就绪或超时（时间轮定时器）时在事件循环线程上恢复。同一时刻最多一个协程等读、一个协程等写
+#ifndef ENCCHAT_ASYNCSOCKET_H
+#define ENCCHAT_ASYNCSOCKET_H
+
+#include <cstdint>
+#include <coroutine>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include "Coroutine.h"
+#include "EventLoop.h"
+#include "Frame.h"
+
+class AsyncSocket {
+public:
+    // co_await 的结果为 true 表示 fd 已就绪（或出错、对端关闭，由接下来的系统调用给出）；
+    // false 表示超时（errno 为 ETIMEDOUT）或 socket 已被 Cancel（errno 为 ECANCELED）
+    class ReadyAwaiter {
+    private:
+        AsyncSocket* socket;
+        bool write;
+        bool timedOut;
+        uint64_t deadline;              // 时间轮的格，0 表示不限时
+        TimerNode timer;
+
+        static void OnTimeout(void* context);
+
+    public:
+        ReadyAwaiter(AsyncSocket* socket, bool write, uint64_t deadline)
+            : socket(socket), write(write), timedOut(false), deadline(deadline) {
+            TimerWheel::Init(&timer, OnTimeout, this);
+        }
+        ReadyAwaiter(const ReadyAwaiter&) = delete;
+        ReadyAwaiter& operator=(const ReadyAwaiter&) = delete;
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle);
+        bool await_resume();
+    };
+
+private:
+    EventLoop* loop;
+    int fd;
+    bool registered;
+    std::coroutine_handle<> reader;
+    std::coroutine_handle<> writer;
+    bool* destroyed;                    // 分发过程中恢复的协程可能销毁本对象，由 OnEvents 检查
+
+    void OnEvents(uint32_t events);
+    uint64_t Deadline(int timeoutMs) const;
+    void Resume(std::coroutine_handle<>& slot);
+
+public:
+    // fd 必须已是非阻塞的；AsyncSocket 不拥有 fd，析构时只从事件循环注销，不关闭
+    AsyncSocket(EventLoop& loop, int fd);
+    ~AsyncSocket();
+    AsyncSocket(const AsyncSocket&) = delete;
+    AsyncSocket& operator=(const AsyncSocket&) = delete;
+
+    inline int Fd() const { return fd; };
+    inline EventLoop& Loop() { return *loop; };
+
+    // timeoutMs < 0 表示不限时
+    ReadyAwaiter Readable(int timeoutMs = -1);
+    ReadyAwaiter Writable(int timeoutMs = -1);
+
+    // 读满 length 字节，返回 length；对端提前关闭返回 0，出错或超时返回 -1（见 errno）
+    Task<ssize_t> ReadExactly(void* buffer, size_t length, int timeoutMs = -1);
+    // 写完 length 字节，返回 length；出错或超时返回 -1
+    Task<ssize_t> WriteAll(const void* buffer, size_t length, int timeoutMs = -1);
+    // 在监听 socket 上接受一个连接，返回非阻塞的新 fd，超时或出错返回 -1
+    Task<int> Accept(int timeoutMs = -1);
+    // 非阻塞 connect 并等待连通
+    Task<bool> Connect(const sockaddr_in& address, int timeoutMs = -1);
+
+    // 从事件循环注销，之后 fd 可以交给其他处理函数；不会唤醒等待中的协程
+    void Detach();
+    // 注销并唤醒等待中的协程（其等待返回 false），用于在关闭 fd 之前结束挂在上面的协程
+    void Cancel();
+};
+
+// 读取下一个完整帧，payload 指向 reader 的缓冲区，在下一次调用前有效；连接关闭或出错时返回 false
+Task<bool> ReadFrame(AsyncSocket& socket, FrameReader& reader, char*& payload, uint32_t& length, uint8_t& flags);
+
+#endif
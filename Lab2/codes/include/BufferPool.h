@@ -0,0 +1,51 @@
+// 缓冲池：slab 内存池，出站帧直接加密写入 slab，入站数据也先收进 slab。
+// 同一线程上的所有连接共用 ThreadLocal() 池，连接只在有数据待收发时才借用 slab
+#ifndef ENCCHAT_BUFFERPOOL_H
+#define ENCCHAT_BUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define SLAB_SIZE (64 * 1024)
+#define SLAB_ALIGN 4096             // 按页对齐，便于 MSG_ZEROCOPY 锁定用户页
+#define POOL_MAX_FREE_SLABS 8
+#define POOL_SHARED_MAX_FREE_SLABS 64   // 线程共享池缓存的空闲 slab 数（4 MB）
+
+struct Slab {
+    char* data;
+    uint32_t capacity;
+    uint32_t used;                  // 已分配出去的字节（顺序分配）
+    uint32_t refs;                  // 引用该 slab 的未发送段 + 未完成的零拷贝发送 + 正在填充
+    Slab* next;                     // 空闲链表
+};
+
+class BufferPool {
+private:
+    uint32_t slabSize;
+    int maxFree;
+    int freeCount;
+    Slab* freeList;
+    size_t borrowedBytes;           // 已借出、尚未归还的 slab 容量
+
+    static Slab* Allocate(uint32_t capacity);
+    static void Free(Slab* slab);
+
+public:
+    explicit BufferPool(uint32_t slabSize = SLAB_SIZE, int maxFree = POOL_MAX_FREE_SLABS);
+    ~BufferPool();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // 当前线程的共享池；借出的 slab 只能在同一线程上归还
+    static BufferPool& ThreadLocal();
+
+    // 取一个至少 minCapacity 字节的 slab，refs 初始为 1；超过 slabSize 的请求单独分配且不回收到池中
+    Slab* Acquire(uint32_t minCapacity);
+    // 引用计数减一，归零时回收
+    void Release(Slab* slab);
+    inline uint32_t GetSlabSize() const { return slabSize; };
+    inline size_t BorrowedBytes() const { return borrowedBytes; };
+    inline size_t CachedBytes() const { return (size_t)freeCount * slabSize; };
+};
+
+#endif
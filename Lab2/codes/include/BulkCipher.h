@@ -0,0 +1,30 @@
+// 大缓冲区的并行分组加解密：输入按 BULK_CHUNK_SIZE 切块交给工作窃取线程池，各块互不依赖的模式
+// （ECB、CTR 加解密、CBC 解密）并行执行，结果与串行逐分组处理完全相同。
+// ECB 需要 MAC 时各块的密文按块号顺序送入同一个 Sha256：加密时块一完成就由完成它的线程接着计算，
+// 解密时块在解密前先计算，等待的线程顺带计算后面的块，不再在加解密之外对整段数据单独走一遍
+#ifndef ENCCHAT_BULKCIPHER_H
+#define ENCCHAT_BULKCIPHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "DES_Operation.h"
+
+class Sha256;
+
+#define BULK_BLOCK_SIZE 8
+#define BULK_CHUNK_SIZE (8 * 1024)              // 每块输入输出合计 16KB，处理期间留在 L1 中
+#define BULK_PARALLEL_THRESHOLD (16 * 1024)     // 短于该长度时在调用线程上串行处理
+
+class BulkCipher {
+public:
+    // length 必须是 BULK_BLOCK_SIZE 的倍数；in 与 out 可以相同。mac 非空时按顺序吸收全部密文
+    static void EcbEncrypt(DesOp& des, const char* in, char* out, size_t length, Sha256* mac = nullptr);
+    static void EcbDecrypt(DesOp& des, const char* in, char* out, size_t length, Sha256* mac = nullptr);
+    // 计数器分组为 iv（按大端 64 位整数）加分组序号，加密与解密相同；length 可以是任意值
+    static void CtrCrypt(DesOp& des, const uint8_t* iv, const char* in, char* out, size_t length);
+    // CBC 加密每个分组依赖上一个密文分组，只能串行；解密各块只依赖前一块的最后一个密文分组，可以并行
+    static void CbcEncrypt(DesOp& des, const uint8_t* iv, const char* in, char* out, size_t length);
+    static void CbcDecrypt(DesOp& des, const uint8_t* iv, const char* in, char* out, size_t length);
+};
+
+#endif
@@ -0,0 +1,70 @@
+// 抓包：把一个会话收到的原始密文字节流按 recv 的分块连同时间间隔与协商出的会话密钥写入文件，
+// chat_replay 据此离线、可重复地回放服务器的拆帧、解密与分发路径
+#ifndef ENCCHAT_CAPTURE_H
+#define ENCCHAT_CAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Protocol.h"
+
+#define CAPTURE_DIR_ENV "ENCCHAT_CAPTURE_DIR"      // 设置后服务器为每个建立的会话写一个抓包文件
+#define CAPTURE_MAGIC 0x32504143434E45ull           // "ENCCAP2"（2 起会话密钥最长 32 字节）
+#define CAPTURE_BUFFER_SIZE (256 * 1024)            // 写入缓冲，避免每个 recv 块一次 write
+
+// 文件布局：头部 | 记录头 + 数据 | 记录头 + 数据 ...
+struct CaptureHeader {
+    uint64_t magic;
+    uint64_t startTime;         // 会话建立时刻，CLOCK_REALTIME 纳秒
+    uint64_t features;          // 协商出的握手特性
+    uint8_t sessionKey[SESSION_KEY_MAX_LENGTH];
+    uint8_t isServer;           // 抓包一侧的角色，决定回放时的收发方向
+    uint8_t reserved[7];
+};
+
+// 每个 recv 块一条记录：距上一条记录（第一条为会话建立）的微秒数与块长度
+struct CaptureRecord {
+    uint32_t interval;
+    uint32_t length;
+};
+
+class CaptureWriter {
+private:
+    FILE* file;
+    uint64_t last;              // 上一条记录的单调时钟纳秒
+
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    bool Open(const std::string& path, const uint8_t* sessionKey, uint64_t features, bool isServer);
+    void Append(const char* data, uint32_t length);
+    void Close();
+};
+
+// 读取端一次把整个文件读入内存，回放时不产生 I/O
+struct CaptureChunk {
+    uint32_t interval;
+    uint32_t length;
+    const char* data;
+};
+
+class CaptureReader {
+private:
+    std::vector<char> buffer;
+    CaptureHeader header;
+    std::vector<CaptureChunk> chunks;
+    uint64_t bytes;
+
+public:
+    CaptureReader();
+    bool Open(const char* path);
+    inline const CaptureHeader& Header() const { return header; };
+    inline const std::vector<CaptureChunk>& Chunks() const { return chunks; };
+    inline uint64_t Bytes() const { return bytes; };
+};
+
+#endif
@@ -0,0 +1,29 @@
+// 轻量压缩：LZ4 块格式（单遍哈希匹配，无熵编码），在加密前缩短明文，减少 DES 计算量与带宽
+#ifndef ENCCHAT_COMPRESS_H
+#define ENCCHAT_COMPRESS_H
+
+#include <cstdint>
+
+#define COMPRESS_MIN_LENGTH 64          // 短于此长度的消息不值得压缩
+#define COMPRESS_HASH_BITS 12
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_LAST_LITERALS 5        // 块末尾至少保留的字面量字节数
+#define COMPRESS_MF_LIMIT 12            // 距块末尾不足该长度时不再查找匹配
+#define COMPRESS_MAX_OFFSET 0xFFFF
+#define COMPRESS_SAMPLE_SIZE 512        // 熵估计的采样字节数
+
+class Compressor {
+public:
+    // 最坏情况（完全不可压缩）下的输出上界
+    static inline int Bound(int length) { return length + length / 255 + 16; }
+
+    // 快速熵估计：对采样字节统计碰撞概率，接近均匀分布（已加密/已压缩数据）时返回 false
+    static bool LooksCompressible(const char* data, int length);
+
+    // 压缩到 dest，返回输出长度；capacity 不足时返回 -1
+    static int Compress(const char* source, int length, char* dest, int capacity);
+    // 解压到 dest，返回输出长度；输入损坏或超出 capacity 时返回 -1
+    static int Decompress(const char* source, int length, char* dest, int capacity);
+};
+
+#endif
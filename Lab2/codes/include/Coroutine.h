@@ -0,0 +1,176 @@
+// 协程：惰性启动的 Task<T>（co_await 时才开始执行，结束时对称转移回等待者），
+// 以及在事件循环上分离运行的 Spawn。协程帧从线程本地的按大小分级的空闲链表分配，
+// 大量会话反复建立、结束时不经过 malloc
+#ifndef ENCCHAT_COROUTINE_H
+#define ENCCHAT_COROUTINE_H
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+#define FRAME_POOL_GRANULE 64           // 帧大小按 64 字节分级
+#define FRAME_POOL_CLASSES 64           // 4 KB 以内的帧走池，更大的直接 malloc
+#define FRAME_POOL_MAX_FREE 4096        // 每级最多缓存的空闲帧
+
+// 协程帧池：只在一个线程内使用（事件循环线程），无需加锁
+class FramePool {
+private:
+    struct FreeFrame {
+        FreeFrame* next;
+    };
+    FreeFrame* freeLists[FRAME_POOL_CLASSES];
+    uint32_t freeCounts[FRAME_POOL_CLASSES];
+
+public:
+    FramePool() {
+        for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+            freeLists[i] = nullptr;
+            freeCounts[i] = 0;
+        }
+    }
+    ~FramePool() {
+        for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+            while (freeLists[i] != nullptr) {
+                FreeFrame* frame = freeLists[i];
+                freeLists[i] = frame->next;
+                free(frame);
+            }
+        }
+    }
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    static FramePool& Local() {
+        static thread_local FramePool pool;
+        return pool;
+    }
+
+    void* Allocate(size_t size) {
+        size_t index = (size - 1) / FRAME_POOL_GRANULE;
+        if (index >= FRAME_POOL_CLASSES) {
+            return malloc(size);
+        }
+        FreeFrame* frame = freeLists[index];
+        if (frame == nullptr) {
+            return malloc((index + 1) * FRAME_POOL_GRANULE);
+        }
+        freeLists[index] = frame->next;
+        freeCounts[index]--;
+        return frame;
+    }
+
+    void Free(void* pointer, size_t size) {
+        size_t index = (size - 1) / FRAME_POOL_GRANULE;
+        if (index >= FRAME_POOL_CLASSES || freeCounts[index] >= FRAME_POOL_MAX_FREE) {
+            free(pointer);
+            return;
+        }
+        FreeFrame* frame = static_cast<FreeFrame*>(pointer);
+        frame->next = freeLists[index];
+        freeLists[index] = frame;
+        freeCounts[index]++;
+    }
+};
+
+template <typename T = void>
+class Task;
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;   // 等待本协程的协程，结束时转移过去
+
+    // 结束时直接恢复等待者（对称转移），深层的 co_await 链不会占用栈
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    static void* operator new(size_t size) { return FramePool::Local().Allocate(size); }
+    static void operator delete(void* pointer, size_t size) { FramePool::Local().Free(pointer, size); }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    // 项目不使用异常，协程中出现异常（如内存耗尽）直接终止
+    void unhandled_exception() { std::terminate(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    T value{};
+    Task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+// 协程的返回类型；Task 对象拥有协程帧，销毁 Task 即销毁帧
+template <typename T>
+class Task {
+public:
+    typedef TaskPromise<T> promise_type;
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    T await_resume() {
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(handle.promise().value);
+        }
+    }
+};
+
+template <typename T>
+inline Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// 分离运行的协程：立即开始执行，结束时自行销毁帧
+struct DetachedTask {
+    struct promise_type {
+        static void* operator new(size_t size) { return FramePool::Local().Allocate(size); }
+        static void operator delete(void* pointer, size_t size) { FramePool::Local().Free(pointer, size); }
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// 启动一个 Task 并运行到第一次挂起；之后由事件循环中的 I/O 就绪或定时器恢复
+inline DetachedTask Spawn(Task<void> task) {
+    co_await task;
+}
+
+#endif
@@ -0,0 +1,56 @@
+// 跨会话的 DES 批量加密：服务器在一轮事件中要发给许多会话的帧先只写好帧头与填充后的明文，
+// 把其中的分组登记到批里，到本轮结束（或积累了 CRYPTO_BATCH_MAX_BLOCKS 个分组、
+// 最早登记的分组等待超过截止时间）时一起加密。每 CRYPTO_BATCH_LANES 个分组不论来自哪个会话，
+// 各自带着本会话的子密钥交错执行 DesTables 的查表 16 轮（与 DesKeySearch 共用），密文写回各帧原处；
+// 认证会话的 HMAC 随后在密文上计算。登记的帧在 Flush 之前不能发出，所属的会话也不能释放
+#ifndef ENCCHAT_CRYPTOBATCH_H
+#define ENCCHAT_CRYPTOBATCH_H
+
+#include <cstdint>
+#include <vector>
+#include "SHA256.h"
+#include "DesTables.h"
+
+#define CRYPTO_BATCH_LANES DES_TABLE_LANES               // 交错执行的分组数
+#define CRYPTO_BATCH_MAX_BLOCKS 1024                    // 积累这么多分组（8 KB）时立即加密
+#define CRYPTO_BATCH_DEADLINE_ENV "ENCCHAT_CRYPTO_BATCH_US"    // 最早登记的分组最多等待的微秒数
+#define CRYPTO_BATCH_DEFAULT_DEADLINE_US 200
+
+class DesOp;
+
+class CryptoBatch {
+private:
+    // 一帧的加密工作
+    struct Job {
+        const DesOp* des;
+        uint32_t schedule;      // 在 schedules 中的下标
+        char* data;             // 填充后的明文，原地加密
+        uint32_t blocks;
+        const Hmac* mac;        // 认证会话：加密后在密文上继续 context，标签写到 tag
+        char* tag;
+        Sha256 context;
+    };
+
+    std::vector<Job> jobs;
+    std::vector<uint64_t> schedules;    // 按 DesTables::Schedule 的格式打包的子密钥，16 个一组，同一会话连续的帧共用一组
+    uint32_t pendingBlocks;
+    uint64_t firstQueued;
+    uint64_t deadline;                  // 纳秒
+
+    void Queue(const Job& job);
+    static void EncryptLanes(const uint64_t* const* laneSchedules, char* const* blocks);
+
+public:
+    CryptoBatch();
+    // 登记 data 处 length 字节（8 的倍数）已填充的明文
+    void Add(const DesOp& des, char* data, int length);
+    // 同上，加密后把密文接着送入 context，再把截断为 FRAME_TAG_LENGTH 字节的 HMAC 写到 tag
+    void Add(const DesOp& des, char* data, int length, const Hmac& mac, const Sha256& context, char* tag);
+    // 加密全部登记的帧
+    void Flush();
+    inline bool Empty() const { return jobs.empty(); };
+    // 与 DesOp 的逐位实现比较若干随机密钥与分组的加密结果
+    static bool SelfTest();
+};
+
+#endif
@@ -0,0 +1,83 @@
+// 公钥运算工作线程：握手中的 RSA 解密、会话密钥编排与服务器密钥的定期更换交给专门的线程，
+// I/O 线程从不等待公钥运算。任务经无锁 MPMC 队列交给工作线程，完成后放进同样的完成队列，
+// 再写 eventfd 唤醒事件循环，由 I/O 线程执行任务的完成回调
+#ifndef ENCCHAT_CRYPTOWORKERS_H
+#define ENCCHAT_CRYPTOWORKERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <semaphore>
+#include <thread>
+#include <vector>
+#include "Metrics.h"
+
+#define CRYPTO_WORKERS_ENV "ENCCHAT_CRYPTO_THREADS"     // 工作线程数，默认 CRYPTO_WORKERS_DEFAULT
+#define CRYPTO_WORKERS_DEFAULT 2
+#define CRYPTO_WORKERS_CAPACITY 1024                    // 同时在途的任务上限（2 的幂）
+
+// 一个任务：work 在工作线程上执行，complete 之后在 I/O 线程上执行
+struct CryptoTask {
+    std::function<void()> work;
+    std::function<void()> complete;
+};
+
+// 有界无锁多生产者 / 多消费者队列：每个槽带一个序号，生产者与消费者各自用 CAS 推进位置，
+// 再由槽的序号交接槽的所有权，不需要锁
+class CryptoTaskQueue {
+private:
+    struct alignas(CACHE_LINE_SIZE) Cell {
+        std::atomic<uint64_t> sequence;
+        CryptoTask* task;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    uint64_t mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> tail;    // 下一个写入的位置
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head;    // 下一个读取的位置
+
+public:
+    // capacity 须为 2 的幂
+    explicit CryptoTaskQueue(size_t capacity);
+    CryptoTaskQueue(const CryptoTaskQueue&) = delete;
+    CryptoTaskQueue& operator=(const CryptoTaskQueue&) = delete;
+
+    // 队列满时返回 false
+    bool TryPush(CryptoTask* task);
+    // 队列空时返回 nullptr
+    CryptoTask* TryPop();
+};
+
+class CryptoWorkers {
+private:
+    CryptoTaskQueue jobs;
+    CryptoTaskQueue completions;
+    std::counting_semaphore<> pending;  // jobs 中的任务数
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping;
+    int eventFd;
+    std::atomic<bool> signaled;         // eventfd 已写入、I/O 线程还没有取走完成队列
+    uint32_t inFlight;                  // 已提交、完成回调尚未执行的任务数（只在 I/O 线程上访问）
+
+    void WorkerLoop();
+
+public:
+    // threads 为 0 时读取 CRYPTO_WORKERS_ENV
+    explicit CryptoWorkers(int threads = 0);
+    // 停止并等待工作线程；未完成的任务直接丢弃，不执行完成回调
+    ~CryptoWorkers();
+    CryptoWorkers(const CryptoWorkers&) = delete;
+    CryptoWorkers& operator=(const CryptoWorkers&) = delete;
+
+    // 注册到事件循环，可读时调用 Complete()
+    inline int Fd() const { return eventFd; };
+    // I/O 线程：提交任务，在途任务已达 CRYPTO_WORKERS_CAPACITY 时返回 false
+    bool Submit(std::function<void()> work, std::function<void()> complete);
+    // I/O 线程：执行所有已完成任务的完成回调
+    void Complete();
+    inline uint32_t InFlight() const { return inFlight; };
+};
+
+#endif
@@ -3,7 +3,12 @@
 
 #include <cstdint>
 
+class Sha256;
+
 class DesOp {
+    // 查表实现（密钥搜索与跨会话批量加密共用）直接使用这里的置换表、S 盒与子密钥
+    friend class DesTables;
+
 private:
     uint8_t key[8] = {0};
     uint8_t subKeys[16][6] = {0};
@@ -33,7 +38,20 @@ public:
     uint8_t* GetKey();
     void RandomGenKey();
     void Encrypt(char* plainText, int plainTextLength, char*& cipherText, int& cipherTextLength);
+    // 直接加密到调用者提供的缓冲区（至少 CipherLength(plainTextLength) 字节），返回密文长度；
+    // mac 非空时每产生一个密文分组就送入 MAC，与加密在同一遍完成
+    int EncryptTo(const char* plainText, int plainTextLength, char* cipherText, Sha256* mac = nullptr);
+    static inline int CipherLength(int plainTextLength) { return plainTextLength + 8 - plainTextLength % 8; };
     void Decrypt(char* cipherText, int cipherTextLength, char*& plainText, int& plainTextLength);
+    // 原地解密并校验填充，返回明文长度，-1 表示长度或填充非法；
+    // mac 非空时每个密文分组在解密前送入 MAC
+    int DecryptInPlace(char* cipherText, int cipherTextLength, Sha256* mac = nullptr);
+    // 解密到调用者提供的缓冲区（可与密文相同），只写出去掉填充后的明文；
+    // 明文超过 capacity 时返回 -1
+    int DecryptTo(const char* cipherText, int cipherTextLength, char* plainText, int capacity, Sha256* mac = nullptr);
+    // 单分组加解密（in 与 out 可以相同）；只读取子密钥，可在多个线程上同时调用
+    void EncryptBlock(const uint8_t* in, uint8_t* out);
+    void DecryptBlock(const uint8_t* in, uint8_t* out);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+// 数据报传输：每条消息是一个独立加密的 UDP 数据报，丢包只影响这一条，没有 TCP 的队头阻塞。
+// 会话密钥仍通过 TCP 上的 RSA 握手协商（HANDSHAKE_FEATURE_DATAGRAM），数据报头带着由会话密钥派生的
+// 会话号与本方向的序号，接收方用滑动窗口位图拒绝重放。可靠消息由对方成批确认，超时未确认时用原序号
+// 原样重发；已经到达过的副本被窗口丢弃并再次确认，因此每条消息最多交付一次。比窗口还旧的重发既不交付也不确认，
+// 由发送方重试用尽后记为放弃，丢失总能被发送方看到
+#ifndef ENCCHAT_DATAGRAM_H
+#define ENCCHAT_DATAGRAM_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "Handoff.h"
+#include "Protocol.h"
+#include "TimerWheel.h"
+
+#define DATAGRAM_HEADER_SIZE 17             // 会话号（8）| 序号（8，大端）| 标志（1），整体作为认证的附加数据
+#define DATAGRAM_MAX_SIZE 1400              // 不超过常见路径 MTU，避免 IP 分片
+#define DATAGRAM_MAX_MESSAGE (DATAGRAM_MAX_SIZE - DATAGRAM_HEADER_SIZE - FRAME_TAG_LENGTH - 8)    // 8 为 DES 的最大填充
+#define DATAGRAM_FLAG_RELIABLE 0x01         // 需要确认，超时重发
+#define DATAGRAM_FLAG_ACK 0x02              // 载荷为对方可靠数据报的序号列表
+#define DATAGRAM_REPLAY_WINDOW 1024         // 反重放位图的位数；落后最新序号不到 960 的乱序数据报一定能被接受
+#define DATAGRAM_BATCH 64                   // recvmmsg / sendmmsg 一次处理的数据报数
+#define DATAGRAM_INITIAL_RTO_MS 50
+#define DATAGRAM_MIN_RTO_MS 10
+#define DATAGRAM_MAX_RTO_MS 2000
+#define DATAGRAM_MAX_RETRIES 8              // 重发这么多次仍未确认即放弃
+#define DATAGRAM_MAX_UNACKED 512            // 未确认的可靠消息上限，超过时拒绝发送（背压）
+#define DATAGRAM_LOSS_ENV "ENCCHAT_DATAGRAM_LOSS"   // 丢包模拟：收发时各按此百分比随机丢弃，用于测试重传
+
+enum DatagramResult {
+    DATAGRAM_MESSAGE,                       // 一条新消息，明文已原地解密
+    DATAGRAM_HANDLED,                       // 确认等由通道自己处理的数据报
+    DATAGRAM_DROPPED                        // 过短、重放或认证失败
+};
+
+// 滑动窗口反重放（RFC 6479 的做法）：位图按 64 位一字环形使用，窗口前移时整字清零，不必逐位移动
+class ReplayWindow {
+private:
+    uint64_t bitmap[DATAGRAM_REPLAY_WINDOW / 64];
+    uint64_t top;                           // 已接受的最大序号 + 1，0 表示尚未收到
+
+public:
+    ReplayWindow();
+    // 序号比窗口新，或在窗口内尚未出现过；在认证之前调用，重放的数据报不必解密
+    bool Check(uint64_t sequence) const;
+    // 序号仍在窗口内且已经接受过；比窗口还旧的无从判断，返回 false
+    bool Seen(uint64_t sequence) const;
+    // 认证通过后记录
+    void Update(uint64_t sequence);
+    void Save(HandoffWriter& out) const;
+    bool Restore(HandoffReader& in);
+};
+
+// UDP socket 与收发批：一次 recvmmsg 收满 DATAGRAM_BATCH 个数据报；发送先排入批，批满或 Flush 时一次 sendmmsg
+class DatagramSocket {
+private:
+    struct Batch {
+        char buffers[DATAGRAM_BATCH][DATAGRAM_MAX_SIZE];
+        sockaddr_in addresses[DATAGRAM_BATCH];
+        iovec vectors[DATAGRAM_BATCH];
+        mmsghdr messages[DATAGRAM_BATCH];
+        int count;
+    };
+
+    int fd;
+    std::unique_ptr<Batch> in;
+    std::unique_ptr<Batch> out;
+    uint32_t lossThreshold;                 // 模拟丢包：随机数低于它的数据报被丢弃
+    uint64_t lossState;
+    bool receiveLoss;                       // 模拟丢包也作用于收到的数据报
+
+    bool Lose();
+
+public:
+    DatagramSocket();
+    ~DatagramSocket();
+    // 绑定 port（0 为临时端口）
+    bool Open(int port);
+    // 接管已绑定的 socket（热重启时从旧进程传来）
+    bool Adopt(int fd);
+    inline int Fd() const { return fd; };
+    // 模拟丢包只作用于发出的数据报：回显测试借此让丢失只发生在去程，每条丢失都应被本端记为放弃
+    void SendLossOnly();
+
+    // 收一批，返回个数，没有数据时返回 0。被截断或模拟丢弃的数据报长度记为 0
+    int Receive();
+    inline char* Data(int i) { return in->buffers[i]; };
+    inline int Length(int i) const { return (int)in->messages[i].msg_len; };
+    inline const sockaddr_in& From(int i) const { return in->addresses[i]; };
+
+    // 预留一个发往 to 的 DATAGRAM_MAX_SIZE 字节缓冲，批满时先 Flush
+    char* Reserve(const sockaddr_in& to);
+    void Commit(int length);
+    // 发出批中的全部数据报；内核缓冲区满时丢弃剩余的（可靠消息会重发），返回发出的个数
+    int Flush();
+};
+
+// 未确认的可靠数据报：保存加密后的原样字节，重发时不再加密
+struct DatagramPending {
+    uint64_t sequence;
+    uint64_t sentAt;                        // 最近一次发送的时刻（纳秒）
+    int retries;
+    bool done;                              // 已确认或已放弃，等待从队头移除
+    std::vector<char> bytes;
+};
+
+// 一个会话在一侧的数据报状态：发送序号、反重放窗口、待确认的可靠数据报与待回复的确认
+class DatagramChannel {
+private:
+    SessionCrypto& crypto;
+    sockaddr_in peer;
+    bool hasPeer;
+    uint64_t sendSequence;
+    ReplayWindow window;
+    std::deque<DatagramPending> unacked;    // 按序号递增
+    size_t outstanding;                     // unacked 中尚未完成的个数
+    std::vector<uint64_t> acks;             // 待确认的对方序号
+    uint64_t smoothedRtt;                   // 纳秒，0 表示还没有样本
+    uint64_t rttVariance;
+    uint64_t rto;
+    uint64_t retransmits;
+    uint64_t abandoned;
+    uint64_t rejected;
+
+    char* Seal(DatagramSocket& socket, uint8_t flags, const char* text, int length, int& datagramLength);
+    void OnAck(const char* body, int length, uint64_t now);
+
+public:
+    TimerNode timer;                        // 服务器用来调度重发
+
+    explicit DatagramChannel(SessionCrypto& crypto);
+    inline uint64_t Id() const { return crypto.datagramId; };
+    inline bool HasPeer() const { return hasPeer; };
+    void SetPeer(const sockaddr_in& address);
+    inline uint64_t Rto() const { return rto; };
+    inline size_t Outstanding() const { return outstanding; };
+    inline bool AckPending() const { return !acks.empty(); };
+    inline uint64_t Retransmits() const { return retransmits; };
+    inline uint64_t Abandoned() const { return abandoned; };
+    inline uint64_t Rejected() const { return rejected; };
+
+    // 加密一条消息排入 socket 的发送批，reliable 时保留副本等待确认。
+    // 返回数据报字节数；消息过长、没有对方地址或未确认的消息过多时返回 -1
+    int Send(DatagramSocket& socket, const char* text, int length, bool reliable, uint64_t now);
+    // 处理一个属于本通道的数据报；返回 DATAGRAM_MESSAGE 时 text 指向原地解密的明文，reliable 为其标志
+    DatagramResult Receive(char* datagram, int length, const sockaddr_in& from, uint64_t now,
+                           char*& text, int& textLength, bool& reliable);
+    // 把积累的确认排入发送批
+    void SendAcks(DatagramSocket& socket);
+    // 重发到期的可靠数据报，放弃重试次数用尽的；返回距下一次重发的纳秒数，没有待确认的数据报时返回 0
+    uint64_t Retransmit(DatagramSocket& socket, uint64_t now);
+
+    // 热重启：序号、反重放窗口、RTT 估计与待确认的数据报原样交接，新进程接着重发与确认。
+    // sentAt 取自系统范围的单调时钟，在新进程中依然有效
+    void Save(HandoffWriter& out) const;
+    bool Restore(HandoffReader& in);
+
+    // 读出数据报头中的会话号，用于在会话间分派
+    static bool PeekId(const char* datagram, int length, uint64_t& id);
+};
+
+#endif
@@ -0,0 +1,68 @@
+// 查表实现的 DES 轮函数，供密钥搜索（DesKeySearch）与跨会话批量加密（CryptoBatch）共用：
+// S 盒与 P 置换合并为每个 S 盒一张 64 项的表，初始 / 末置换按输入的每个字节查表后相或；
+// 子密钥按轮打包成 64 位（第 i 个字节为第 i 个 S 盒的 6 位子密钥），DES_TABLE_LANES 个分组
+// 各带一组子密钥交错执行 16 轮，隐藏查表延迟
+#ifndef ENCCHAT_DESTABLES_H
+#define ENCCHAT_DESTABLES_H
+
+#include <cstdint>
+
+#define DES_TABLE_LANES 8               // 交错执行的分组数
+
+class DesOp;
+
+class DesTables {
+private:
+    uint32_t sp[8][64];                 // S 盒输出经 P 置换后的 32 位值
+    uint64_t ip[8][256];                // 初始置换，下标为输入的第几个字节及其值
+    uint64_t fp[8][256];                // 末置换
+
+    DesTables();
+
+    inline static uint32_t RotateLeft(uint32_t value, int count) {
+        return (value << count) | (value >> ((32 - count) & 31));
+    }
+    inline static uint64_t Apply(const uint64_t (*table)[256], uint64_t in) {
+        uint64_t out = 0;
+        for (int i = 0; i < 8; i++) {
+            out |= table[i][(in >> (56 - 8 * i)) & 0xFF];
+        }
+        return out;
+    }
+
+public:
+    // 进程内共享的一份表，第一次使用时构造
+    static const DesTables& Instance();
+    // 按 DES 的置换表（从 1 开始编号）逐位置换
+    static uint64_t Permute(uint64_t in, int inBits, const uint8_t* table, int outBits);
+
+    inline uint64_t InitialPermutation(uint64_t block) const { return Apply(ip, block); };
+    inline uint64_t FinalPermutation(uint64_t block) const { return Apply(fp, block); };
+    // 由 64 位密钥（大端）从头编排
+    static void Schedule(uint64_t key, uint64_t* schedule);
+    // 打包 DesOp 已经生成的子密钥
+    static void Schedule(const DesOp& des, uint64_t* schedule);
+    // left / right 为各通道 IP 之后的两半，schedules[lane] 为该通道的 16 轮子密钥；
+    // 结束时 (right << 32) | left 即末置换之前的 R16 || L16。放在头文件里以便在调用处展开
+    inline void Rounds(uint32_t* left, uint32_t* right, const uint64_t* const* schedules) const {
+        for (int round = 0; round < 16; round++) {
+            for (int lane = 0; lane < DES_TABLE_LANES; lane++) {
+                uint32_t r = right[lane];
+                uint64_t k = schedules[lane][round];
+                // E 扩展的第 i 组是 R 的第 4i 到 4i+5 位（循环），旋转后取高 6 位
+                uint32_t f = sp[0][((RotateLeft(r, 31) >> 26) ^ k) & 0x3F]
+                           ^ sp[1][((RotateLeft(r, 3) >> 26) ^ (k >> 8)) & 0x3F]
+                           ^ sp[2][((RotateLeft(r, 7) >> 26) ^ (k >> 16)) & 0x3F]
+                           ^ sp[3][((RotateLeft(r, 11) >> 26) ^ (k >> 24)) & 0x3F]
+                           ^ sp[4][((RotateLeft(r, 15) >> 26) ^ (k >> 32)) & 0x3F]
+                           ^ sp[5][((RotateLeft(r, 19) >> 26) ^ (k >> 40)) & 0x3F]
+                           ^ sp[6][((RotateLeft(r, 23) >> 26) ^ (k >> 48)) & 0x3F]
+                           ^ sp[7][((RotateLeft(r, 27) >> 26) ^ (k >> 56)) & 0x3F];
+                right[lane] = left[lane] ^ f;
+                left[lane] = r;
+            }
+        }
+    }
+};
+
+#endif
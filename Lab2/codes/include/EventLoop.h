@@ -0,0 +1,67 @@
+// 事件循环：基于 epoll 的单线程 I/O 多路复用
+#ifndef ENCCHAT_EVENTLOOP_H
+#define ENCCHAT_EVENTLOOP_H
+
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "TimerWheel.h"
+
+#define EVENT_LOOP_MAX_EVENTS 64
+
+class EventLoop {
+public:
+    // 回调参数为 epoll 返回的事件掩码（EPOLLIN / EPOLLOUT / EPOLLERR ...）
+    typedef std::function<void(uint32_t)> Handler;
+    // 忙轮询回调：poll 返回 true 表示处理了数据；park 登记休眠，返回 false 表示登记时又有了数据
+    typedef std::function<bool()> Poller;
+
+private:
+    int epollFd;
+    int wakeFd;                         // eventfd，用于跨线程 / 信号处理函数唤醒
+    std::atomic<bool> stopped;          // Stop() 可能早于 Run() 被调用，因此记录“已停止”而不是“运行中”
+    // 回调放在堆上，保证分发过程中 map 重排或注销时回调对象本身地址不变
+    std::unordered_map<int, std::unique_ptr<Handler>> handlers;
+    std::vector<std::unique_ptr<Handler>> retired;  // 本轮分发中被移除的回调，分发结束后再析构
+    TimerWheel timers;
+    struct PollerState {
+        Poller poll;
+        Poller park;
+        uint64_t spinNanos;
+    };
+    std::unique_ptr<PollerState> poller;
+    std::unique_ptr<PollerState> retiredPoller;     // 在轮询回调中被替换的，本轮结束后再析构
+    std::function<void()> roundEnd;
+    uint64_t lastActivity;
+
+    void DrainWakeup();
+    int PollTimeout(int timeout);
+
+public:
+    EventLoop();
+    ~EventLoop();
+
+    // 注册 / 修改 / 注销文件描述符，返回false表示 epoll_ctl 失败
+    bool Add(int fd, uint32_t events, Handler handler);
+    bool Modify(int fd, uint32_t events);
+    void Remove(int fd);
+
+    // 阻塞运行直到 Stop() 被调用；没有事件时线程休眠到下一个定时器需要处理的时刻，
+    // 没有定时器时完全休眠。每次醒来先成批处理到期的定时器，再分发 I/O 事件
+    void Run();
+    // 忙轮询不经 fd 通知的数据源（共享内存环）：设置后每轮先调用 poll，最近 spinNanos 内分发过事件
+    // 或轮询到数据时 epoll_wait 不休眠，超过后调用 park 再阻塞等待。poll 为空时取消
+    void SetPoller(Poller poll, Poller park, uint64_t spinNanos);
+    // 每轮分发完本批事件后调用（Stop() 之后的那一轮也调用），用于合并处理本轮各回调积累的工作
+    inline void SetRoundEnd(std::function<void()> hook) { roundEnd = std::move(hook); };
+    // 线程安全且可在信号处理函数中调用：置位后通过 eventfd 立即唤醒 epoll_wait
+    void Stop();
+    inline bool IsRunning() const { return !stopped; };
+    // 只能在事件循环线程上使用
+    inline TimerWheel& Timers() { return timers; };
+};
+
+#endif
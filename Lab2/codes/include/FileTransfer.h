@@ -0,0 +1,70 @@
+// 文件传输：发送端把文件映射到内存，分块直接加密进发送队列；
+// 接收端预分配输出文件并映射，文件数据帧直接解密到映射区中
+#ifndef ENCCHAT_FILETRANSFER_H
+#define ENCCHAT_FILETRANSFER_H
+
+#include <cstdint>
+#include <string>
+#include "BufferPool.h"
+#include "Protocol.h"
+
+#define FRAME_FLAG_FILE_OFFER 0x10      // 文件元数据：8 字节大端文件长度 + 文件名
+#define FRAME_FLAG_FILE_DATA 0x20       // 文件数据块，按顺序拼接
+#define FILE_CHUNK_SIZE (SLAB_SIZE / 2 - 64)        // 两个数据帧（含帧头、填充与标签）恰好装入一个 slab
+#define FILE_FLUSH_BATCH (256 * 1024)               // 每排入这么多字节 Flush 一次，让 socket 发送与加密重叠
+#define FILE_READAHEAD (4 * 1024 * 1024)            // 提前 MADV_WILLNEED 的窗口，让磁盘读取与加密重叠
+#define FILE_MAX_NAME 255
+#define FILE_RECEIVED_PREFIX "received_"
+#define FILE_MAX_SIZE_ENV "ENCCHAT_FILE_MAX_MB"       // 接收文件的大小上限（MB），默认 FILE_DEFAULT_MAX_MB
+#define FILE_DEFAULT_MAX_MB 4096
+
+class FileSender {
+private:
+    int fd;
+    char* map;
+    uint64_t size;
+    uint64_t offset;            // 已排入发送队列的字节数
+    uint64_t readahead;         // 已请求预读到的位置
+    uint64_t startTime;
+    std::string name;
+    void Close();
+
+public:
+    FileSender();
+    ~FileSender();
+    // 打开并映射文件，排入元数据帧
+    bool Start(const char* path, SendQueue& queue, SessionCrypto& crypto);
+    // 排入数据块直到发送队列到达高水位或文件结束；返回 false 表示 socket 错误
+    bool Pump(SendQueue& queue, SessionCrypto& crypto, int socketFd);
+    // 打印传输速率并释放文件；数据未全部排入时视为取消
+    void Finish();
+    inline bool Active() const { return fd >= 0; }
+    inline bool Done() const { return offset >= size; }
+};
+
+class FileReceiver {
+private:
+    int fd;
+    char* map;
+    uint64_t size;
+    uint64_t offset;
+    uint64_t startTime;
+    std::string path;
+    void Close();
+
+public:
+    FileReceiver();
+    ~FileReceiver();
+    // 解析元数据，创建并预分配输出文件
+    bool Begin(const char* offer, int length);
+    // 把一帧文件数据直接解密到输出文件的映射中；返回 false 表示数据非法或超出声明的长度
+    bool Write(SessionCrypto& crypto, char* payload, uint32_t length, uint8_t flags);
+    // 打印传输速率并关闭输出文件
+    void Finish();
+    // 丢弃未接收完整的输出文件
+    void Abort();
+    inline bool Active() const { return fd >= 0; }
+    inline bool Done() const { return offset >= size; }
+};
+
+#endif
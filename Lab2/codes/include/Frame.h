@@ -0,0 +1,76 @@
+// 帧格式：4 字节大端头部（高 8 位为标志位，低 24 位为载荷长度）+ 密文载荷
+#ifndef ENCCHAT_FRAME_H
+#define ENCCHAT_FRAME_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include "BufferPool.h"
+#include "Handoff.h"
+
+class SharedMemoryChannel;
+
+#define FRAME_HEADER_SIZE 4
+#define FRAME_MAX_PAYLOAD 0x00FFFFFFu
+#define FRAME_MAX_LENGTH (SLAB_SIZE - FRAME_HEADER_SIZE)   // 协议允许的最大载荷：一帧总能装进一个 slab，头部声明更长的视为非法
+#define FRAME_FLAG_AUTH 0x01            // 载荷末尾带 MAC 标签
+#define FRAME_FLAG_COMPRESSED 0x02      // 明文经过压缩
+#define FRAME_FLAG_KEEPALIVE 0x04       // 空载荷的保活帧，接收方直接丢弃
+#define FRAME_FLAG_SHARED_MEMORY 0x08   // 空载荷的切换帧：发送方之后的帧都写入共享内存环（见 SharedMemory.h）
+// 传输层标志；其余位由上层消息类型使用，服务器转发时原样保留
+#define FRAME_FLAGS_TRANSPORT (FRAME_FLAG_AUTH | FRAME_FLAG_COMPRESSED | FRAME_FLAG_KEEPALIVE | FRAME_FLAG_SHARED_MEMORY)
+
+inline void EncodeFrameHeader(char* header, uint32_t length, uint8_t flags) {
+    header[0] = (char)flags;
+    header[1] = (char)((length >> 16) & 0xFF);
+    header[2] = (char)((length >> 8) & 0xFF);
+    header[3] = (char)(length & 0xFF);
+}
+
+inline uint32_t DecodeFrameHeader(const char* header, uint8_t& flags) {
+    flags = (uint8_t)header[0];
+    return ((uint32_t)(uint8_t)header[1] << 16) | ((uint32_t)(uint8_t)header[2] << 8) | (uint32_t)(uint8_t)header[3];
+}
+
+// 接收端的拆帧缓冲：一次 recv 可能包含多帧或半帧。
+// 缓冲区从线程共享池借用，只在有未处理的数据（半帧）时持有，空闲连接不占接收缓冲
+class FrameReader {
+private:
+    BufferPool* pool;
+    Slab* slab;
+    uint32_t begin;
+    uint32_t end;
+    SharedMemoryChannel* shared;    // 协商了共享内存时非空，收到切换帧后 Fill 改从环中读取
+
+    void Release();
+    char* Prepare(uint32_t& available);
+    ssize_t FillShared(int fd);
+
+public:
+    explicit FrameReader(BufferPool& pool = BufferPool::ThreadLocal());
+    ~FrameReader();
+    FrameReader(const FrameReader&) = delete;
+    FrameReader& operator=(const FrameReader&) = delete;
+
+    // 共享内存通道的生命周期须长于 reader
+    inline void UseSharedMemory(SharedMemoryChannel* channel) { shared = channel; };
+    // recv 一次，返回读到的字节数；0 表示对端关闭，-1 表示出错（见 errno）。
+    // 切换到共享内存后从环中取数据，环空时才读 socket（门铃与关闭）。
+    // 缓冲区中的帧头声明的长度超过 FRAME_MAX_LENGTH 时不再读取，返回 -1，errno 为 EMSGSIZE
+    ssize_t Fill(int fd);
+    // 从内存追加数据（回放抓包时代替 recv），返回实际拷入的字节数，可能少于 length；帧头非法时为 0
+    size_t Feed(const char* data, size_t length);
+    // 下一帧的头部声明的长度超过 FRAME_MAX_LENGTH：连接应当关闭
+    bool Oversized() const;
+    // 最近一次 Fill 读到的 length 字节（位于缓冲区末尾），在下一次 Fill 或 Next 前有效
+    inline const char* Tail(size_t length) const { return slab->data + end - length; };
+    // 取出下一个完整帧，载荷指向内部缓冲区，可原地解密，直到下一次 Fill 或 Next 返回 false 前有效；
+    // 缓冲区中的数据全部取完后，返回 false 的那次调用把缓冲区还给池。
+    // 切换帧由 reader 自己处理：之后 socket 上只剩门铃，缓冲区中剩余的字节一并丢弃
+    bool Next(char*& payload, uint32_t& length, uint8_t& flags);
+    inline bool Holding() const { return slab != nullptr; };
+    // 热重启：交出 / 接回缓冲区中尚未拆完的半帧
+    void Save(HandoffWriter& out) const;
+    bool Restore(HandoffReader& in);
+};
+
+#endif
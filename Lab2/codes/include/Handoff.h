@@ -0,0 +1,82 @@
+// 热重启：旧进程把监听 socket、UDP socket 与全部会话的连接经 Unix socket（SCM_RIGHTS）交给新进程，
+// 每个会话附带序列化的状态（会话密钥与特性、双向序号、未拆完的半帧、尚未发出的密文、数据报与共享内存状态），
+// 新进程接着收发，客户端既不断线也不必重新握手。两个进程在 HANDOFF_SOCKET_ENV 指定的路径上会合：
+// 服务器启动时先连接该路径，有旧进程在监听就接管它的会话，否则正常启动；之后自己在该路径上等待下一个新进程。
+// 交接分两步确认：新进程恢复完状态后回复确认，旧进程停止一切收发后再回复完成，新进程这时才开始处理事件；
+// 任何一步失败时旧进程照常服务，新进程退出
+#ifndef ENCCHAT_HANDOFF_H
+#define ENCCHAT_HANDOFF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define HANDOFF_SOCKET_ENV "ENCCHAT_HANDOFF_SOCKET"
+#define HANDOFF_MAGIC 0x45434846u           // "ECHF"
+#define HANDOFF_VERSION 1                   // 状态格式的版本，不一致时拒绝交接
+#define HANDOFF_CHUNK (32 * 1024)           // 每条 SOCK_SEQPACKET 消息的最大载荷
+#define HANDOFF_FDS_PER_MESSAGE 64          // 每条消息附带的描述符数（内核上限 SCM_MAX_FD 为 253）
+#define HANDOFF_TIMEOUT_MS 10000            // 交接中每次收发的超时
+
+// 序列化：整数按本机字节序（新旧进程在同一台机器上），描述符单独传递，数据中只记录其下标
+class HandoffWriter {
+private:
+    std::vector<char> data;
+    std::vector<int> fds;
+
+public:
+    void Put(const void* source, size_t length);
+    inline void PutU8(uint8_t value) { Put(&value, sizeof(value)); };
+    inline void PutU32(uint32_t value) { Put(&value, sizeof(value)); };
+    inline void PutU64(uint64_t value) { Put(&value, sizeof(value)); };
+    // 带 64 位长度前缀的字节串
+    void PutBytes(const void* source, size_t length);
+    void PutFd(int fd);
+
+    // 发送全部数据与描述符，返回 false 表示失败（对方退出或超时）
+    bool Send(int sock) const;
+};
+
+// 反序列化：越界或格式不符时置为失败，之后的读取都返回 0，调用者最后检查 Ok()
+class HandoffReader {
+private:
+    std::vector<char> data;
+    std::vector<int> fds;
+    size_t position;
+    bool failed;
+
+public:
+    HandoffReader();
+    // 关闭没有被 TakeFd 取走的描述符
+    ~HandoffReader();
+    HandoffReader(const HandoffReader&) = delete;
+    HandoffReader& operator=(const HandoffReader&) = delete;
+
+    // 接收 HandoffWriter::Send 发出的全部内容
+    bool Receive(int sock);
+
+    bool Get(void* dest, size_t length);
+    uint8_t GetU8();
+    uint32_t GetU32();
+    uint64_t GetU64();
+    // 取出 length 字节，返回指向内部缓冲区的指针，在 reader 析构前有效；不足时返回 nullptr
+    const char* Take(size_t length);
+    // PutBytes 写入的字节串
+    const char* GetBytes(size_t& length);
+    // 取得描述符的所有权，失败时返回 -1
+    int TakeFd();
+    inline bool Ok() const { return !failed; };
+    inline bool AtEnd() const { return position == data.size(); };
+};
+
+// 旧进程：在 path 上监听（文件权限只允许本用户连接），返回非阻塞的监听 socket，失败时返回 -1
+int HandoffListen(const char* path);
+// 旧进程：接受一个新进程的连接并校验对方与自己属于同一用户，没有连接或校验失败时返回 -1
+int HandoffAccept(int listenSocket);
+// 新进程：连接旧进程，没有旧进程在监听时返回 -1
+int HandoffConnect(const char* path);
+// 两步确认中的一步：发送 / 等待一个只含 HANDOFF_MAGIC 的消息
+bool HandoffSignal(int sock);
+bool HandoffWait(int sock);
+
+#endif
@@ -0,0 +1,41 @@
+// 直方图：HDR 风格的对数-线性分桶，O(1) 记录，相对误差不超过 1/64
+#ifndef ENCCHAT_HISTOGRAM_H
+#define ENCCHAT_HISTOGRAM_H
+
+#include <cstdint>
+
+#define HISTOGRAM_SUB_BITS 7                                    // 每个 2 的幂区间再分 2^(SUB_BITS-1) 个子桶
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_HALF_COUNT (HISTOGRAM_SUB_COUNT / 2)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_COUNT + (64 - HISTOGRAM_SUB_BITS) * HISTOGRAM_HALF_COUNT)
+
+class Histogram {
+private:
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+
+public:
+    static int IndexOf(uint64_t value);
+    static uint64_t ValueAt(int index);     // 桶的上界（含）
+
+    Histogram();
+    void Reset();
+    void Record(uint64_t value);
+    void Merge(const Histogram& other);
+    // 按桶累加（用于从其他形式的分桶计数重建直方图），sum 需由调用者另行提供
+    void AddBucket(int index, uint64_t count);
+    inline void AddSum(uint64_t value) { sum += value; };
+
+    // quantile 取值 [0, 1]，返回不小于该分位数的桶上界
+    uint64_t Percentile(double quantile) const;
+    inline uint64_t Count() const { return total; };
+    inline uint64_t Min() const { return total ? min : 0; };
+    inline uint64_t Max() const { return max; };
+    inline uint64_t Sum() const { return sum; };
+    inline double Mean() const { return total ? (double)sum / total : 0.0; };
+};
+
+#endif
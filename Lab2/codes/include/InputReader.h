@@ -0,0 +1,58 @@
+// 输入线程：在独立线程上读取标准输入写入 SPSC 环，事件循环线程（消费者）成批取出、加密并发送。
+// 消费者把环取空后登记休眠，生产者只在这时通过 eventfd 唤醒它：输入稀疏时没有额外延迟，
+// 输入密集时不为每次写入产生唤醒的系统调用。环满时生产者同样等待消费者腾出空间，形成背压
+#ifndef ENCCHAT_INPUTREADER_H
+#define ENCCHAT_INPUTREADER_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include "SpscRing.h"
+
+#define INPUT_RING_SIZE (1024 * 1024)
+#define INPUT_READ_SIZE (256 * 1024)            // 一次 read 的最大字节数
+
+class InputReader {
+private:
+    SpscRing ring;
+    int inputFd;
+    int notifyFd;                               // 消费者的唤醒 eventfd，注册在事件循环中
+    int spaceFd;                                // 生产者等待空间的 eventfd
+    int stopFd;                                 // 通知生产者退出
+    std::thread thread;
+    std::atomic<bool> finished;                 // 生产者已读到 EOF 或出错，不再写入
+    std::atomic<bool> failed;
+    std::atomic<bool> consumerParked;
+    std::atomic<bool> producerParked;
+
+    void Run();
+    bool WaitFor(int fd);
+    void WakeConsumer();
+
+public:
+    InputReader();
+    ~InputReader();
+    InputReader(const InputReader&) = delete;
+    InputReader& operator=(const InputReader&) = delete;
+
+    // 启动读取线程，fd 可以是终端、管道或普通文件
+    bool Start(int fd);
+    // 结束并回收读取线程（可在其阻塞于读取或等待空间时调用）
+    void Stop();
+    inline int NotifyFd() const { return notifyFd; };
+
+    // 以下只在消费者线程上调用
+    // 返回可连续读取的输入字节数，data 在 Consume 之前有效
+    inline size_t Peek(const char*& data) { return ring.ReadableRegion(data); };
+    void Consume(size_t length);
+    // 清除 eventfd 上的唤醒计数
+    void ClearNotify();
+    // 环已取空：登记休眠并返回 true，之后有新输入时 NotifyFd 变为可读；
+    // 登记时发现新输入则返回 false，调用者应继续读取
+    bool Park();
+    // 输入已结束且全部取出
+    bool AtEnd();
+    inline bool Failed() const { return failed.load(std::memory_order_acquire); };
+};
+
+#endif
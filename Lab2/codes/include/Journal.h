@@ -0,0 +1,128 @@
+// 消息日志：只追加的加密帧日志。段文件预分配并映射进内存，追加只是一次内存拷贝，不产生系统调用；
+// 后台线程按组提交 fdatasync 并提前准备下一个段。稀疏索引从段尾向前增长，读取端直接在映射上扫描
+#ifndef ENCCHAT_JOURNAL_H
+#define ENCCHAT_JOURNAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#define JOURNAL_DIR_ENV "ENCCHAT_JOURNAL_DIR"      // 设置后聊天程序把收到的帧写入该目录
+#define JOURNAL_SEGMENT_SIZE (64ull * 1024 * 1024)
+#define JOURNAL_MAGIC 0x314C4E524A434E45ull         // "ENCJRNL1"
+#define JOURNAL_ALIGN 8
+#define JOURNAL_INDEX_INTERVAL (64 * 1024)          // 每写入这么多字节记录一个索引项
+#define JOURNAL_SYNC_BYTES (1024 * 1024)            // 未同步字节数超过该值时立即唤醒后台线程
+#define JOURNAL_SYNC_INTERVAL_MS 20                 // 组提交的最长间隔
+
+// 段文件布局：头部 | 记录（向后增长）... 空闲 ... 索引项（从段尾向前增长）
+struct JournalSegmentHeader {
+    uint64_t magic;
+    uint64_t firstSequence;     // 0 表示尚未启用的预备段
+    uint64_t segmentSize;
+    uint64_t reserved[5];
+};
+
+// 记录头之后紧跟数据，整条记录按 8 字节对齐；length 为 0 表示段内记录结束
+struct JournalRecordHeader {
+    uint32_t length;
+    uint32_t checksum;
+    uint64_t sequence;
+    uint64_t timestamp;         // CLOCK_REALTIME 纳秒
+};
+
+struct JournalIndexEntry {
+    uint64_t sequence;
+    uint64_t timestamp;
+    uint64_t offset;            // 记录在段内的偏移
+};
+
+struct JournalSegment {
+    std::string path;
+    int fd;
+    char* base;
+    uint64_t size;
+    uint64_t writeOffset;
+    uint64_t indexCount;
+    uint64_t lastIndexedOffset;
+};
+
+// 读取端返回的记录，data 直接指向段映射，在读取下一个段之前有效
+struct JournalRecord {
+    uint64_t sequence;
+    uint64_t timestamp;
+    const char* data;
+    uint32_t length;
+};
+
+class Journal {
+private:
+    std::string dir;
+    uint64_t nextSegmentNumber;
+    JournalSegment* active;
+    JournalSegment* spare;                  // 后台线程预先创建好的下一个段
+    std::vector<JournalSegment*> sealed;    // 已写满，等待最后一次同步后关闭
+    uint64_t nextSequence;
+    uint64_t unsyncedBytes;
+    std::atomic<uint64_t> appendedSequence; // 已写入映射的最大序号
+    std::atomic<uint64_t> durableSequence;  // 已落盘的最大序号
+    std::atomic<bool> syncRequested;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread flusher;
+
+    JournalSegment* CreateSegment();
+    bool Recover(const std::string& path);
+    bool Rollover();
+    void FlusherLoop();
+    static void CloseSegment(JournalSegment* segment);
+
+public:
+    Journal();
+    ~Journal();
+    // 打开（不存在则创建）日志目录，从最后一个段恢复写入位置并启动后台同步线程
+    bool Open(const char* path);
+    // 追加一条记录（prefix 与 data 拼接），返回序号；记录超过段容量时返回 0
+    uint64_t Append(const char* prefix, uint32_t prefixLength, const char* data, uint32_t length);
+    inline uint64_t Append(const char* data, uint32_t length) { return Append(nullptr, 0, data, length); }
+    inline uint64_t DurableSequence() const { return durableSequence.load(std::memory_order_acquire); }
+    inline bool IsOpen() const { return active != nullptr; }
+    // 同步全部数据并关闭
+    void Close();
+};
+
+class JournalReader {
+private:
+    std::vector<std::string> paths;
+    size_t current;
+    int fd;
+    const char* base;
+    uint64_t size;
+    uint64_t offset;
+    uint64_t expected;          // 下一条记录应有的序号，用来识别段尾残留的旧数据
+
+    bool MapSegment(size_t index);
+    bool ReadSegmentStart(size_t index, uint64_t& sequence, uint64_t& timestamp);
+    void Unmap();
+    bool Seek(uint64_t key, bool byTime);
+
+public:
+    JournalReader();
+    ~JournalReader();
+    bool Open(const char* path);
+    // 定位到序号不小于 sequence 的第一条记录
+    inline bool SeekSequence(uint64_t sequence) { return Seek(sequence, false); }
+    // 定位到时间戳不早于 timestamp 的第一条记录
+    inline bool SeekTime(uint64_t timestamp) { return Seek(timestamp, true); }
+    // 读取下一条记录（不拷贝数据）；没有更多记录时返回 false
+    bool Next(JournalRecord& record);
+};
+
+uint64_t JournalNow();
+
+#endif
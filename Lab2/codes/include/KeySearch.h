@@ -0,0 +1,42 @@
+// 已知明文的 DES 密钥穷举：在基准密钥上枚举最低若干个有效密钥位，统计每秒尝试的密钥数。
+// 子密钥是密钥位的线性函数（GF(2) 上的置换与选择），候选密钥按格雷码顺序枚举，
+// 相邻候选只差一位，新的密钥编排只需把该位的贡献异或进 16 个轮子密钥；
+// 加密使用 DesTables 的查表轮函数，同时推进 KEYSEARCH_LANES 个候选密钥
+#ifndef ENCCHAT_KEYSEARCH_H
+#define ENCCHAT_KEYSEARCH_H
+
+#include <cstdint>
+#include <vector>
+#include "DesTables.h"
+
+#define KEYSEARCH_EFFECTIVE_BITS 56     // 每字节最低位为校验位，不参与密钥编排
+#define KEYSEARCH_LANES DES_TABLE_LANES // 交错执行的候选密钥数
+#define KEYSEARCH_CHUNK_BITS 16         // 每个并行任务枚举 2^16 个候选密钥
+
+class DesKeySearch {
+private:
+    const DesTables& tables;
+    uint64_t bitSchedules[KEYSEARCH_EFFECTIVE_BITS][16];  // 每个有效密钥位对各轮子密钥的贡献
+    uint32_t plainLeft, plainRight;                     // IP(明文)
+    uint64_t target;                                    // IP(密文)，即末轮输出 R16 || L16
+
+    void Encrypt(const uint64_t (*schedules)[16], uint64_t* out) const;
+
+public:
+    DesKeySearch();
+    // 8 字节明文/密文对
+    void SetPair(const uint8_t* plainText, const uint8_t* cipherText);
+    // 子密钥按 DesTables 的格式打包
+    inline static void Schedule(uint64_t key, uint64_t* schedule) { DesTables::Schedule(key, schedule); };
+    // 把偏移量的第 t 位放到第 t 个有效密钥位（从最后一个字节的低位向前数）
+    static uint64_t SpreadKeyBits(uint64_t offset);
+    static uint64_t BytesToKey(const uint8_t* bytes);
+    static void KeyToBytes(uint64_t key, uint8_t* bytes);
+    // 与 DesOp 的逐位实现比较若干随机密钥的加密结果
+    bool SelfTest() const;
+    // 枚举格雷码序号 [first, first + count)（first、count 均为 KEYSEARCH_LANES 的倍数）对应的候选密钥
+    // baseKey ^ SpreadKeyBits(gray(i))，把与明文/密文对匹配的密钥追加到 found
+    void Search(uint64_t baseKey, uint64_t first, uint64_t count, std::vector<uint64_t>& found) const;
+};
+
+#endif
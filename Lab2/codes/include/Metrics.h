@@ -0,0 +1,130 @@
+// 指标：每个线程独占一组按缓存行对齐的计数器与直方图，写入无锁无竞争，读取时再汇总
+#ifndef ENCCHAT_METRICS_H
+#define ENCCHAT_METRICS_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "Histogram.h"
+
+#define CACHE_LINE_SIZE 64
+#define METRICS_DEFAULT_INTERVAL 10     // 定期导出文件的默认间隔（秒）
+
+// 环境变量：设置任意一个即启动导出线程
+#define METRICS_SOCKET_ENV "ENCCHAT_METRICS_SOCKET"         // Unix socket 路径，连接即返回当前指标
+#define METRICS_FILE_ENV "ENCCHAT_METRICS_FILE"             // 定期覆盖写入的导出文件
+#define METRICS_INTERVAL_ENV "ENCCHAT_METRICS_INTERVAL"
+
+enum MetricCounter {
+    METRIC_BYTES_IN,
+    METRIC_BYTES_OUT,
+    METRIC_FRAMES_IN,
+    METRIC_FRAMES_OUT,
+    METRIC_HANDSHAKES,
+    METRIC_ACTIVE_SESSIONS,             // 仪表量：各线程分别加减，汇总后为当前值
+    METRIC_BACKPRESSURE_EVENTS,
+    METRIC_BACKPRESSURE_NS,
+    METRIC_COMPRESSED_FRAMES,
+    METRIC_COMPRESS_SAVED_BYTES,
+    METRIC_HANDSHAKE_TIMEOUTS,
+    METRIC_IDLE_EVICTIONS,
+    METRIC_KEEPALIVES,
+    METRIC_SESSION_BYTES,               // 仪表量：会话结构本身占用的内存
+    METRIC_BUFFER_BYTES,                // 仪表量：借出中的收发缓冲区
+    METRIC_DATAGRAMS_IN,
+    METRIC_DATAGRAMS_OUT,
+    METRIC_DATAGRAM_RETRANSMITS,
+    METRIC_DATAGRAM_REJECTED,           // 重放、重复或认证失败的数据报
+    METRIC_SHARED_MEMORY_WAKEUPS,       // 共享内存对方已休眠、经 socket 发出的门铃
+    METRIC_HANDOFF_SESSIONS,            // 热重启时从旧进程接过来的会话
+    METRIC_CRYPTO_BATCHES,              // 跨会话批量加密的批数
+    METRIC_CRYPTO_BATCH_BLOCKS,         // 批量加密的 DES 分组数，除以批数即平均批大小
+    METRIC_HANDSHAKES_ADMITTED,         // 取得全局令牌、开始解密会话密钥的握手
+    METRIC_HANDSHAKES_QUEUED,           // 到达的那一轮没有轮到、在准入队列中等过的握手
+    METRIC_HANDSHAKES_REJECTED,         // 准入队列已满或来源超过速率而被拒绝的连接
+    METRIC_COUNTER_COUNT
+};
+
+enum MetricHistogram {
+    METRIC_ENCRYPT_NS,
+    METRIC_DECRYPT_NS,
+    METRIC_HANDSHAKE_NS,
+    METRIC_RSA_KEYGEN_NS,
+    METRIC_HISTOGRAM_COUNT
+};
+
+// 单写者计数器：只有所属线程写入，用 relaxed load + store 代替带锁前缀的原子加
+struct alignas(CACHE_LINE_SIZE) PaddedCounter {
+    std::atomic<uint64_t> value;
+
+    inline void Add(uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+struct alignas(CACHE_LINE_SIZE) HistogramShard {
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> counts[HISTOGRAM_BUCKETS];
+
+    inline void Record(uint64_t value) {
+        std::atomic<uint64_t>& bucket = counts[Histogram::IndexOf(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
+
+struct MetricShard {
+    PaddedCounter counters[METRIC_COUNTER_COUNT];
+    HistogramShard histograms[METRIC_HISTOGRAM_COUNT];
+    MetricShard* next;                  // 全局分片链表，只追加不删除
+};
+
+struct MetricsSnapshot {
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    Histogram histograms[METRIC_HISTOGRAM_COUNT];
+};
+
+class Metrics {
+private:
+    static std::atomic<MetricShard*> shards;
+    static MetricShard* Register();
+
+public:
+    // 当前线程的分片，首次使用时注册（仅此一次加锁）
+    static inline MetricShard& Local() {
+        static thread_local MetricShard* shard = Register();
+        return *shard;
+    }
+    static inline void Add(MetricCounter counter, uint64_t n = 1) {
+        Local().counters[counter].Add(n);
+    }
+    static inline void Record(MetricHistogram histogram, uint64_t value) {
+        Local().histograms[histogram].Record(value);
+    }
+    static inline uint64_t NowNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 汇总所有线程的分片
+    static void Snapshot(MetricsSnapshot& snapshot);
+    // Prometheus 文本格式
+    static std::string Format();
+    // 按环境变量启动后台导出线程；未配置时不做任何事
+    static void StartExporter();
+    static void StopExporter();
+};
+
+// 作用域计时：析构时把经过的纳秒数记入直方图
+class MetricTimer {
+private:
+    MetricHistogram histogram;
+    uint64_t start;
+
+public:
+    explicit MetricTimer(MetricHistogram histogram) : histogram(histogram), start(Metrics::NowNanos()) {}
+    ~MetricTimer() { Metrics::Record(histogram, Metrics::NowNanos() - start); }
+};
+
+#endif
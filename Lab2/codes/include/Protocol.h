@@ -0,0 +1,126 @@
+// 协议：RSA 密钥交换报文与加密帧的编解码，聊天程序、多会话服务器与压测工具共用
+#ifndef ENCCHAT_PROTOCOL_H
+#define ENCCHAT_PROTOCOL_H
+
+#include <cstdint>
+#include <memory>
+#include "AES_Operation.h"
+#include "CryptoBatch.h"
+#include "DES_Operation.h"
+#include "Frame.h"
+#include "RSA_Operation.h"
+#include "Handoff.h"
+#include "SHA256.h"
+#include "SendQueue.h"
+
+#define DEFAULT_SERVER_IP "127.0.0.1"
+#define DEFAULT_SERVER_PORT 8888
+#define EXIT_COMMAND "quit"
+#define SESSION_KEY_MAX_LENGTH 32       // 会话密钥最大字节数（AES-256），每个字节单独用 RSA 加密
+#define RSA_KEYGEN_RETRY 3
+
+// 握手中协商的可选特性（服务器在 Hello 中给出支持的集合，客户端在 Key 中给出选定的子集）
+#define HANDSHAKE_FEATURE_AUTH 0x1      // 认证帧：HMAC-SHA256 与加解密融合
+#define HANDSHAKE_FEATURE_COMPRESS 0x2  // 加密前压缩（LZ4 块格式）
+#define HANDSHAKE_FEATURE_AES128 0x4    // 会话密码 AES-128：认证时为 GCM，否则为 CTR；都未选定时为 DES
+#define HANDSHAKE_FEATURE_AES256 0x8    // 会话密码 AES-256
+#define HANDSHAKE_FEATURE_DATAGRAM 0x10 // 会话也可以通过 UDP 数据报收发消息（要求认证），见 Datagram.h
+#define HANDSHAKE_FEATURE_SHARED_MEMORY 0x20    // 同一主机上的两端改用共享内存环传帧，见 SharedMemory.h；只在对端为本机地址时提供和请求
+#define HANDSHAKE_FEATURES_CIPHER (HANDSHAKE_FEATURE_AES128 | HANDSHAKE_FEATURE_AES256)
+#define HANDSHAKE_FEATURES_SUPPORTED (HANDSHAKE_FEATURE_AUTH | HANDSHAKE_FEATURE_COMPRESS | HANDSHAKE_FEATURES_CIPHER | \
+                                      HANDSHAKE_FEATURE_DATAGRAM | HANDSHAKE_FEATURE_SHARED_MEMORY)
+#define HANDSHAKE_FEATURES_REQUESTED (HANDSHAKE_FEATURE_AUTH | HANDSHAKE_FEATURE_COMPRESS | HANDSHAKE_FEATURES_CIPHER)
+
+#define FRAME_TAG_LENGTH 16             // 截断为 128 位的 HMAC-SHA256 标签或 GCM 标签，附在密文之后
+#define MAC_KEY_LABEL "encchat-mac-v1"
+#define DATAGRAM_ID_LABEL "encchat-datagram-v1"
+#define SHARED_MEMORY_ID_LABEL "encchat-shm-v1"
+#define COMPRESSED_HEADER_SIZE 4        // 压缩载荷前的 4 字节大端原始长度
+// 压缩帧声明的原始长度上限：解压出的消息在任何会话上（DES 最多填充 8 字节）都能重新封装成一个合法的帧
+#define COMPRESSED_MAX_ORIGINAL_LENGTH (FRAME_MAX_LENGTH - FRAME_TAG_LENGTH - 8 - COMPRESSED_HEADER_SIZE)
+
+// 服务器 -> 客户端：公钥与模数
+struct HandshakeHello {
+    uint64_t e;
+    uint64_t n;
+    uint64_t features;
+};
+
+// 客户端 -> 服务器：RSA 加密后的会话密钥，只用前 SessionKeyLength(features) 项，其余为 0
+struct HandshakeKey {
+    uint64_t sessionKey_enc[SESSION_KEY_MAX_LENGTH];
+    uint64_t features;
+};
+
+// 会话的对称密码状态：DES 或 AES 会话密钥，启用认证时的 MAC 密钥（仅 DES），双向序号，以及是否压缩。
+// AES 帧的 nonce 为方向字节与序号，每一帧（无论是否认证）都使用新的序号
+struct SessionCrypto {
+    DesOp des;
+    std::unique_ptr<AesOp> aes;         // 只有 AES 会话才分配
+    bool authenticated = false;
+    bool compressed = false;
+    Hmac mac;
+    uint64_t sendSequence = 0;
+    uint64_t recvSequence = 0;
+    uint8_t sendDirection = 0;          // 方向字节参与 MAC，防止把帧反射回发送者
+    uint8_t recvDirection = 0;
+    uint64_t datagramId = 0;            // 协商了数据报时由会话密钥派生的会话号，双方无需另行交换
+    uint64_t sharedMemoryId = 0;        // 协商了共享内存时由会话密钥派生，决定共享内存对象的名字
+};
+
+// 生成服务器 RSA 密钥，最多重试 RSA_KEYGEN_RETRY 次
+bool GenerateServerKey(RSA& rsa);
+
+// 在对方提供的特性中选出请求的子集，并且至多保留一种会话密码：两种 AES 都可用时选 AES-128
+// （轮数少，吞吐更高）。客户端用它决定 Key 中的特性，服务器用它再校验一遍
+uint64_t SelectFeatures(uint64_t offered, uint64_t requested);
+// 协商结果对应的会话密钥字节数：DES 为 8，AES-128 为 16，AES-256 为 32
+int SessionKeyLength(uint64_t features);
+// 客户端：生成随机会话密钥
+void GenerateSessionKey(uint8_t* sessionKey, int keyLength);
+// 客户端：用服务器公钥加密会话密钥
+void EncryptSessionKey(const uint8_t* sessionKey, int keyLength, const HandshakeHello& hello, HandshakeKey& out);
+// 服务器：用私钥解出会话密钥
+void DecryptSessionKey(RSA& rsa, const HandshakeKey& in, int keyLength, uint8_t* sessionKey);
+
+// 按协商结果设置会话密码状态；DES 认证会话的 MAC 密钥由会话密钥派生
+void SetupSessionCrypto(SessionCrypto& crypto, const uint8_t* sessionKey, uint64_t features, bool isServer);
+// 热重启：交出 / 接回会话的密码状态。只传会话密钥、协商结果与双向序号，新进程据此重建轮密钥与 MAC 密钥，
+// 不依赖新旧版本的对象布局
+void SaveSessionCrypto(HandoffWriter& out, SessionCrypto& crypto);
+bool RestoreSessionCrypto(HandoffReader& in, SessionCrypto& crypto, bool isServer);
+// 会话密码的名称，用于状态输出
+const char* SessionCipherName(const SessionCrypto& crypto);
+// length 字节的明文加密后的载荷长度（含填充与标签）
+int SealedLength(const SessionCrypto& crypto, int length);
+
+// 加密一条消息并作为一帧排入发送队列（直接加密进 slab），返回排入的字节数；
+// 封装后（压缩之后）超过 FRAME_MAX_LENGTH 的消息不排入，返回 -1。
+// 启用压缩且消息看起来可压缩时先压缩，启用认证时 MAC 在加密的同一遍中计算。
+// batch 非空时 DES 会话的帧只写好帧头与填充后的明文，加密与 MAC 登记到 batch 中，
+// 调用者须在发出这一帧（以及释放会话）之前调用 batch->Flush()；AES 会话与大消息照常当场加密
+int QueueMessage(SendQueue& queue, SessionCrypto& crypto, const char* text, int length, uint8_t flags = 0,
+                 CryptoBatch* batch = nullptr);
+// 批量发送中的一条明文消息
+struct MessageSpan {
+    const char* text;
+    int length;
+};
+
+// 把一批消息按顺序加密成连续的帧排入发送队列，返回排入的字节数；与逐条 QueueMessage 的结果相同。
+// 压缩与帧的预留在调用线程上依次完成，合计超过 BULK_PARALLEL_THRESHOLD 时各帧的加密与 MAC
+// 分组交给线程池并行处理
+int QueueMessages(SendQueue& queue, SessionCrypto& crypto, const MessageSpan* messages, int count, uint8_t flags = 0);
+// 原地校验并解密一帧载荷，返回明文长度，plainText 指向明文；-1 表示格式非法或认证失败。
+// 压缩帧解压到线程本地缓冲区，plainText 在下一次调用前有效
+int OpenMessage(SessionCrypto& crypto, char* payload, uint32_t length, uint8_t flags, char*& plainText);
+// 同 OpenMessage，但明文直接解密到 dest（未压缩帧不经过中间缓冲区），超过 capacity 时返回 -1
+int OpenMessageTo(SessionCrypto& crypto, char* payload, uint32_t length, uint8_t flags, char* dest, int capacity);
+
+// 数据报的认证加密：与帧相同的密码与标签，附加数据为数据报头。数据报可能乱序或重复到达，
+// 序号由调用者给出，也不会推进会话的收发序号。返回载荷长度 / 明文长度，-1 表示认证失败
+int SealDatagram(SessionCrypto& crypto, uint64_t sequence, const char* header, int headerLength,
+                 const char* text, int length, char* payload);
+int OpenDatagram(SessionCrypto& crypto, uint64_t sequence, const char* header, int headerLength, char* payload, int length);
+
+#endif
@@ -38,6 +38,12 @@ public:
     // 获取模数 n
     inline uint64_t GetModulus() { return n; };
 
+    // 获取私钥 d（热重启时交给新进程）
+    inline uint64_t GetPrivateKey() { return d; };
+
+    // 直接设置密钥（热重启时接过旧进程的密钥），只用于解密
+    void SetKey(uint64_t e, uint64_t d, uint64_t n);
+
     // 静态加密函数：使用公钥 e 对明文进行加密
     static uint64_t Encrypt(uint32_t plainText, uint64_t e, uint64_t n);
 
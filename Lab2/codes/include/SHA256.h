@@ -0,0 +1,52 @@
+// SHA-256 与 HMAC-SHA256：支持增量 Update，便于与分组加密在同一遍数据上融合；
+// 运行时检测到 SHA 扩展指令（SHA-NI）时用硬件压缩函数
+#ifndef ENCCHAT_SHA256_H
+#define ENCCHAT_SHA256_H
+
+#include <cstdint>
+#include <cstddef>
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+
+class Sha256 {
+    friend class Hmac;
+
+private:
+    uint32_t state[8];
+    uint8_t buffer[SHA256_BLOCK_SIZE];
+    uint32_t bufferLength;
+    uint64_t totalLength;
+
+    static void CompressGeneric(uint32_t* state, const uint8_t* data, size_t blocks);
+    static void CompressShaNi(uint32_t* state, const uint8_t* data, size_t blocks);
+    static void Compress(uint32_t* state, const uint8_t* data, size_t blocks);
+
+public:
+    Sha256();
+    void Init();
+    void Update(const void* data, size_t length);
+    void Final(uint8_t* digest);
+
+    static void Hash(const void* data, size_t length, uint8_t* digest);
+    static bool HasShaNi();
+};
+
+// HMAC-SHA256：内外两层的初始状态在设置密钥时各压缩一次，之后每条消息只需复制状态
+class Hmac {
+private:
+    // 只保存吸收内外层填充块后的链接值（各 32 字节），不保留完整的哈希对象，减小每个会话的状态
+    uint32_t innerState[8];
+    uint32_t outerState[8];
+
+    static Sha256 Resume(const uint32_t* state);
+
+public:
+    void SetKey(const uint8_t* key, size_t length);
+    // 返回已吸收内层填充的哈希对象，调用者继续 Update 消息内容
+    inline Sha256 Begin() const { return Resume(innerState); }
+    // 完成 MAC，输出 SHA256_DIGEST_SIZE 字节
+    void Finish(Sha256& context, uint8_t* mac) const;
+};
+
+#endif
@@ -0,0 +1,108 @@
+// 出站队列：帧直接加密进 slab，排队后用一次 sendmsg 聚合发送，大帧走 MSG_ZEROCOPY。
+// slab 从线程共享池借用，队列清空后立即归还，空闲连接不持有发送缓冲
+#ifndef ENCCHAT_SENDQUEUE_H
+#define ENCCHAT_SENDQUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include <sys/types.h>
+#include "BufferPool.h"
+#include "Handoff.h"
+
+class SharedMemoryChannel;
+
+#define ZEROCOPY_THRESHOLD (16 * 1024)  // 小于该长度时拷贝比锁页和完成通知更便宜
+#define SEND_QUEUE_MAX_IOV 64
+#define SEND_QUEUE_HIGH_WATERMARK (1024 * 1024)    // 排队字节数超过该值时暂停生产者
+#define SEND_QUEUE_LOW_WATERMARK (256 * 1024)      // 回落到该值以下时恢复生产者
+
+struct SendSegment {
+    Slab* slab;
+    uint32_t offset;
+    uint32_t length;
+};
+
+// 背压统计
+struct SendQueueStats {
+    uint64_t pauses;                // 触及高水位的次数
+    uint64_t pausedNanos;           // 处于暂停状态的累计时间
+    uint64_t partialWrites;         // 内核只接收了部分数据的写次数
+    uint64_t wouldBlock;            // 写时遇到 EAGAIN 的次数
+};
+
+struct ZeroCopyPending {
+    uint32_t id;
+    Slab* slab;
+};
+
+class SendQueue {
+private:
+    BufferPool* pool;
+    Slab* current;                  // 正在顺序填充的 slab
+    // 队列用 vector 加头部下标实现：空 vector 不分配内存，取空后整体清零复用
+    std::vector<SendSegment> segments;
+    uint32_t segmentHead;
+    size_t queuedBytes;
+
+    bool zeroCopy;                  // SO_ZEROCOPY 是否已开启
+    uint32_t zeroCopyNextId;        // 内核为每次成功的 MSG_ZEROCOPY 调用递增的序号
+    std::vector<ZeroCopyPending> zeroCopyPending;
+    uint32_t zeroCopyHead;
+
+    size_t highWatermark;
+    size_t lowWatermark;
+    bool paused;
+    uint64_t pausedSince;
+    SendQueueStats stats;
+
+    SharedMemoryChannel* shared;    // 协商了共享内存时非空
+    size_t socketBytes;             // 切换帧及其之前、仍须经 socket 发出的字节数
+
+    void Consume(size_t length);
+    void ReleaseIdle();
+    void FinishFlush();
+    ssize_t FlushShared(int fd);
+    static uint64_t NowNanos();
+
+public:
+    explicit SendQueue(BufferPool& pool = BufferPool::ThreadLocal());
+    ~SendQueue();
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    // 对 socket 开启 SO_ZEROCOPY，失败时退化为普通拷贝发送
+    bool EnableZeroCopy(int fd);
+
+    // 预留 length 字节的连续空间供调用者直接写入（加密），随后必须 Commit 同样的长度
+    char* Reserve(uint32_t length);
+    void Commit(uint32_t length);
+
+    // 共享内存通道的生命周期须长于队列
+    inline void UseSharedMemory(SharedMemoryChannel* channel) { shared = channel; };
+
+    // 尽可能多地发送已排队数据（非阻塞，短写会记录偏移留待下次续写），
+    // 返回本次写出的字节数，-1 表示连接出错。对方映射了共享内存后，先在 socket 上发出切换帧，
+    // 之后的数据写入环，环满时留在队列中，等对方腾出空间后按门铃
+    ssize_t Flush(int fd);
+    // 读取错误队列中的零拷贝完成通知，释放对应 slab
+    void ReapCompletions(int fd);
+    inline bool CompletionsPending() const { return zeroCopyHead < zeroCopyPending.size(); };
+
+    void SetWatermarks(size_t high, size_t low);
+    // 高于高水位后为 true，直到 Flush 使排队量回落到低水位以下；生产者应在此期间停止入队
+    inline bool IsPaused() const { return paused; };
+    inline const SendQueueStats& GetStats() const { return stats; };
+
+    inline size_t Pending() const { return queuedBytes; };
+    inline bool Empty() const { return queuedBytes == 0; };
+    // 需要等待 socket 可写才能继续；写共享内存环时不需要（对方腾出空间后会按门铃）
+    bool WaitsForSocket() const;
+    // 热重启：交出 / 接回尚未发出的密文与零拷贝序号（内核按 socket 计数，新进程须接着编号）。
+    // 已发出、等待零拷贝完成通知的 slab 不必交接：内核持有页面的引用，旧进程退出后数据仍然有效
+    void Save(HandoffWriter& out) const;
+    bool Restore(HandoffReader& in);
+    // 当前借用的 slab 是否存在（用于统计会话内存）
+    inline bool Holding() const { return current != nullptr || segmentHead < segments.size() || zeroCopyHead < zeroCopyPending.size(); };
+};
+
+#endif
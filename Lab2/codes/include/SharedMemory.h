@@ -0,0 +1,108 @@
+// 同机传输：两端都在本机时（HANDSHAKE_FEATURE_SHARED_MEMORY），帧不再经过 TCP 回环协议栈，
+// 而是写入共享内存中的一对单生产者 / 单消费者字节环，帧格式与会话加密和 socket 路径完全相同。
+// 共享内存对象的名字由会话密钥派生，两端各自打开（不存在则创建，全零即两个空环），无需额外交换报文。
+// 发送方确认对方也已映射后，先在 TCP 上发一个切换帧（FRAME_FLAG_SHARED_MEMORY），之后的帧都写入环；
+// 接收方读到切换帧后改从环中读取。因此两端看到的不是同一个对象（例如不同的 /dev/shm）时会话照常走 TCP。
+// TCP 连接保留用于唤醒与关闭检测：空闲一端登记休眠后阻塞在 epoll 上，对方写入数据或腾出空间时
+// 通过 socket 发一个保活帧作为门铃；活跃期间两端在事件循环里忙轮询环（见 EventLoop::SetPoller），
+// 消息不经过任何系统调用。写方向的关闭也记在共享内存中而不是 shutdown socket，关闭后仍能发门铃
+#ifndef ENCCHAT_SHAREDMEMORY_H
+#define ENCCHAT_SHAREDMEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include "Handoff.h"
+
+#define SHARED_MEMORY_RING_SIZE (1024 * 1024)           // 每个方向的环，2 的幂
+#define SHARED_MEMORY_SPIN_ENV "ENCCHAT_SHM_SPIN_US"    // 最近一次活动后忙轮询的微秒数，0 表示不轮询
+#define SHARED_MEMORY_DEFAULT_SPIN_US 50
+
+// 一个方向的环：生产者与消费者各自的位置分处不同缓存行，并缓存对方的位置（与 SpscRing 相同）
+struct SharedRing {
+    alignas(64) std::atomic<uint64_t> head;     // 消费者已读到的位置
+    uint64_t cachedTail;
+    alignas(64) std::atomic<uint64_t> tail;     // 生产者已写到的位置
+    uint64_t cachedHead;
+};
+
+// 共享内存对象的布局，全零为合法的初始状态。下标为端号：服务器（接受连接的一端）为 0
+struct SharedSegment {
+    alignas(64) std::atomic<uint32_t> attached;         // 已映射的端数，到 2 时由后到的一端删除名字
+    alignas(64) std::atomic<uint32_t> parked[2];        // 该端已登记休眠，需要门铃唤醒
+    std::atomic<uint32_t> closed[2];                    // 该端不再写入（相当于 shutdown(SHUT_WR)）
+    SharedRing rings[2];                                // 由该端写入
+};
+
+class SharedMemoryChannel {
+private:
+    SharedSegment* segment;
+    int fd;                     // 共享内存对象，保留下来供热重启时交给新进程
+    char* data[2];              // 两个方向的环缓冲区
+    size_t mappedSize;
+    int side;
+    char name[32];
+    bool sending;               // 已发出切换帧，之后的帧写入环
+    bool receiving;             // 已收到切换帧，之后的帧从环中读取
+    bool endSeen;               // 已向上层报告过对方关闭
+
+    inline SharedRing& Out() { return segment->rings[side]; };
+    inline SharedRing& In() { return segment->rings[1 - side]; };
+    bool Map(int fd, uint64_t id, int side);
+
+public:
+    SharedMemoryChannel();
+    ~SharedMemoryChannel();
+    SharedMemoryChannel(const SharedMemoryChannel&) = delete;
+    SharedMemoryChannel& operator=(const SharedMemoryChannel&) = delete;
+
+    // 打开（必要时创建）由 id 命名的共享内存对象并映射；isServer 决定本端写哪个环
+    bool Open(uint64_t id, bool isServer);
+    // 解除映射并删除名字（对方可能还没有按名字打开，之后也打不开）
+    void Close();
+    // 只解除映射、关闭描述符，不删除名字：热重启交接后对象仍归新进程使用
+    void Detach();
+    inline bool IsOpen() const { return segment != nullptr; };
+    // 热重启：交出对象的描述符与切换状态；新进程据此重新映射，不再按名字打开（名字可能已删除）
+    void Save(HandoffWriter& out) const;
+    bool Restore(HandoffReader& in, uint64_t id);
+
+    // 对方也已映射同一个对象，可以切换
+    bool PeerAttached() const;
+    inline bool Sending() const { return sending; };
+    inline void StartSending() { sending = true; };
+    inline bool Receiving() const { return receiving; };
+    inline void StartReceiving() { receiving = true; };
+
+    // 生产者：尽可能多地写入，返回写入的字节数
+    size_t Write(const char* source, size_t length);
+    // 消费者：返回可连续读取的字节数，data 在 Consume 之前有效
+    size_t ReadableRegion(const char*& source);
+    void Consume(size_t length);
+    bool Readable();
+    bool Writable();
+
+    // 对方已关闭写方向；先读标志再查环，看到标志时对方关闭前写入的数据一定可见
+    bool PeerClosed() const;
+    inline void SetEndSeen() { endSeen = true; };
+    // 关闭本端写方向并唤醒对方
+    void Shutdown(int fd);
+
+    // wantData 时有可读数据（或尚未报告的关闭），或 wantSpace 时环中有空间：应当处理本通道
+    // （同时撤销休眠登记，对方不必再按门铃）
+    bool Pending(bool wantData, bool wantSpace);
+    // 登记休眠；登记后再确认一次仍无事可做时返回 true，之后的门铃会让 socket 变为可读
+    bool Park(bool wantData, bool wantSpace);
+    // 写入数据或腾出空间之后调用：对方已休眠时通过 socket 发门铃
+    void Wake(int fd);
+    // 读掉 socket 上积累的门铃；连接已断开时返回 false（errno 为 ECONNRESET 或 recv 的错误）
+    bool DrainDoorbells(int fd);
+
+    // 对端地址是本机（回环地址或与本端地址相同）
+    static bool IsLocalPeer(int fd);
+    // 忙轮询时长（纳秒），读取 SHARED_MEMORY_SPIN_ENV
+    static uint64_t SpinNanos();
+};
+
+#endif
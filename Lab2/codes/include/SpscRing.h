@@ -0,0 +1,39 @@
+// 单生产者 / 单消费者无锁字节环：两端各自只写自己的位置（分处不同缓存行），
+// 并缓存对方的位置，只有看起来满 / 空时才重新读取对方的原子变量
+#ifndef ENCCHAT_SPSCRING_H
+#define ENCCHAT_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define SPSC_RING_DEFAULT_SIZE (1024 * 1024)   // 向上取整到 2 的幂
+
+class SpscRing {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t mask;
+    alignas(64) std::atomic<uint64_t> head;     // 消费者已读到的位置
+    uint64_t cachedTail;                        // 消费者上次看到的 tail
+    alignas(64) std::atomic<uint64_t> tail;     // 生产者已写到的位置
+    uint64_t cachedHead;                        // 生产者上次看到的 head
+
+public:
+    explicit SpscRing(size_t size = SPSC_RING_DEFAULT_SIZE);
+    ~SpscRing();
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    inline size_t Capacity() const { return capacity; };
+
+    // 生产者：返回可连续写入的字节数（到缓冲区末尾为止），data 指向写入位置；写完后 Produce
+    size_t WritableRegion(char*& data);
+    void Produce(size_t length);
+
+    // 消费者：返回可连续读取的字节数，data 在 Consume 之前有效
+    size_t ReadableRegion(const char*& data);
+    void Consume(size_t length);
+};
+
+#endif
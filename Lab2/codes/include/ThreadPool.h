@@ -0,0 +1,56 @@
+// 工作窃取线程池：把 [0, chunks) 按参与线程数切成连续区间，各线程从自己区间的前端逐块领取，
+// 领完后从其他线程区间的后端窃取一半。每个区间是一个 64 位原子量（高 32 位结束、低 32 位开始），
+// 领取与窃取都只需一次 CAS；调用线程自己也参与计算
+#ifndef ENCCHAT_THREADPOOL_H
+#define ENCCHAT_THREADPOOL_H
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include "Metrics.h"
+
+#define POOL_MAX_THREADS 64
+#define POOL_THREADS_ENV "ENCCHAT_BULK_THREADS"     // 覆盖默认线程数（硬件线程数）
+
+struct alignas(CACHE_LINE_SIZE) StealRange {
+    std::atomic<uint64_t> range;
+};
+
+struct ParallelJob {
+    const std::function<void(uint32_t)>* function;
+    int participants;
+    std::atomic<uint32_t> remaining;        // 尚未完成的块数
+    StealRange ranges[POOL_MAX_THREADS];
+};
+
+class WorkStealingPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable idle;
+    std::mutex submitMutex;                 // 同一时刻只运行一个任务，嵌套或并发提交时退化为串行
+    ParallelJob* job;
+    uint64_t generation;
+    int active;                             // 正在访问当前任务的工作线程数
+    bool stopping;
+
+    void WorkerLoop(int index);
+    static void Participate(ParallelJob& job, int index);
+
+public:
+    // threads 为参与计算的线程总数（含调用线程）
+    explicit WorkStealingPool(int threads);
+    ~WorkStealingPool();
+    // 进程内共享的线程池，线程数取 ENCCHAT_BULK_THREADS 或硬件线程数
+    static WorkStealingPool& Instance();
+    inline int Concurrency() const { return (int)workers.size() + 1; }
+    // 对 [0, chunks) 中每个块调用 function，全部完成后返回
+    void ParallelFor(uint32_t chunks, const std::function<void(uint32_t)>& function);
+};
+
+#endif
@@ -0,0 +1,54 @@
+// 分层时间轮：4 层、每层 64 个槽，第 0 层一格为 TIMER_TICK_MS 毫秒。
+// 定时器是嵌入在所有者结构中的侵入式双向链表节点，插入与取消都是 O(1)；
+// 高层的槽在低层转完一圈时整体下沉（cascade），到期的定时器在每次推进时成批回调
+#ifndef ENCCHAT_TIMERWHEEL_H
+#define ENCCHAT_TIMERWHEEL_H
+
+#include <cstdint>
+
+#define TIMER_TICK_MS 10
+#define TIMER_LEVEL_BITS 6
+#define TIMER_LEVEL_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_LEVELS 4              // 可直接表示 2^24 格（约 46 小时），更远的定时器到时再重新放置
+#define TIMER_TICKS(ms) (((uint64_t)(ms) + TIMER_TICK_MS - 1) / TIMER_TICK_MS)
+
+struct TimerNode {
+    TimerNode* next;
+    TimerNode** pprev;              // 指向前一个节点的 next（或槽头），为空表示未挂在时间轮上
+    uint64_t expires;               // 到期的格数
+    void (*callback)(void* context);
+    void* context;
+};
+
+class TimerWheel {
+private:
+    TimerNode* slots[TIMER_LEVELS][TIMER_LEVEL_SLOTS];
+    uint64_t occupied[TIMER_LEVELS];    // 每层非空槽的位图，用于计算下一次需要醒来的时间
+    uint64_t current;                   // 已处理到的格
+    uint64_t count;
+
+    void Place(TimerNode* node);
+    void Cascade(int level);
+    static void Unlink(TimerNode* node);
+
+public:
+    TimerWheel();
+
+    static uint64_t NowTicks();
+    inline uint64_t Now() const { return current; };
+    inline bool Empty() const { return count == 0; };
+
+    // 初始化节点；callback 在时间轮推进时（事件循环线程上）调用
+    static void Init(TimerNode* node, void (*callback)(void*), void* context);
+    static inline bool Pending(const TimerNode* node) { return node->pprev != nullptr; };
+    // 在 ticks 格之后到期（至少一格）；已在时间轮上的节点先取消
+    void Schedule(TimerNode* node, uint64_t ticks);
+    void Cancel(TimerNode* node);
+
+    // 推进到 now 格，逐格处理到期的定时器；返回触发的定时器数
+    uint64_t Advance(uint64_t now);
+    // 距下一次必须推进的毫秒数（下一个第 0 层定时器或下一次下沉），没有定时器时返回 -1
+    int NextTimeoutMs() const;
+};
+
+#endif
@@ -0,0 +1,79 @@
+// 热路径追踪：编译期开关（-DENCCHAT_TRACE=ON），每线程无锁环形缓冲，TSC 时间戳，导出 Chrome trace-event JSON
+// 关闭时所有宏展开为空，不产生任何代码
+#ifndef ENCCHAT_TRACE_H
+#define ENCCHAT_TRACE_H
+
+#define TRACE_FILE_ENV "ENCCHAT_TRACE_FILE"
+#define TRACE_DEFAULT_FILE "encchat_trace.json"
+
+#ifdef ENCCHAT_TRACE
+
+#include <cstdint>
+#include <atomic>
+
+#define TRACE_RING_SIZE (1 << 16)       // 每线程保留最近的事件数，写满后覆盖最旧的
+
+struct TraceEvent {
+    const char* name;                   // 必须是字符串字面量
+    uint64_t begin;                     // TSC
+    uint64_t end;
+};
+
+struct TraceBuffer {
+    std::atomic<uint64_t> head;         // 已写入的事件总数，只有所属线程递增
+    uint32_t tid;
+    TraceBuffer* next;
+    TraceEvent events[TRACE_RING_SIZE];
+};
+
+class Trace {
+private:
+    static std::atomic<TraceBuffer*> buffers;
+    static TraceBuffer* Register();
+
+public:
+    static inline TraceBuffer& Local() {
+        static thread_local TraceBuffer* buffer = Register();
+        return *buffer;
+    }
+    static uint64_t Now();
+    static inline void Emit(const char* name, uint64_t begin, uint64_t end) {
+        TraceBuffer& buffer = Local();
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        TraceEvent& event = buffer.events[head & (TRACE_RING_SIZE - 1)];
+        event.name = name;
+        event.begin = begin;
+        event.end = end;
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+    // 写出所有线程缓冲区中的事件；应在各线程静止时调用（例如退出前）
+    static bool Dump(const char* path);
+    static void DumpFromEnv();
+};
+
+class TraceScope {
+private:
+    const char* name;
+    uint64_t begin;
+
+public:
+    explicit TraceScope(const char* name) : name(name), begin(Trace::Now()) {}
+    ~TraceScope() { Trace::Emit(name, begin, Trace::Now()); }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+// 追踪单个表达式（通常是一次系统调用）并返回其值
+#define TRACE_CALL(name, expr) [&]() { TRACE_SCOPE(name); return (expr); }()
+#define TRACE_DUMP() Trace::DumpFromEnv()
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_CALL(name, expr) (expr)
+#define TRACE_DUMP() ((void)0)
+
+#endif
+
+#endif
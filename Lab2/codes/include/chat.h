@@ -12,16 +12,30 @@ typedef int socklen_t;
 #include <unistd.h>
 #endif
 
-#include <thread>
-#include <atomic>
+#include <vector>
+#include "EventLoop.h"
+#include "Coroutine.h"
+#include "AsyncSocket.h"
+#include "AsyncProtocol.h"
+#include "Frame.h"
+#include "SendQueue.h"
 #include "DES_Operation.h"
 #include "RSA_Operation.h"//added
+#include "Protocol.h"
+#include "FileTransfer.h"
+#include "Journal.h"
+#include "InputReader.h"
+#include "SharedMemory.h"
 
-#define DEFAULT_SERVER_IP "127.0.0.1"
-#define DEFAULT_SERVER_PORT 8888
 #define MAX_MESSAGE_LENGTH 512
-#define EXIT_COMMAND "quit"
 #define KEY "Luhaozhe"
+#define FILE_SEND_COMMAND "/send "  // 输入 "/send <路径>" 发送文件
+#define PIPE_BATCH_SIZE (256 * 1024)        // 管道模式一批加密发送的最大明文字节数
+#define PIPE_FRAME_SIZE FILE_CHUNK_SIZE     // 管道模式每帧明文长度，两帧装满一个 slab
+#define PIPE_OUTPUT_SIZE (256 * 1024)       // 管道模式输出缓冲区，攒满或一批帧处理完才写出
+#define CHAT_ACCEPT_TIMEOUT_MS 10000        // 服务器等待客户端连接
+#define CHAT_CONNECT_TIMEOUT_MS 10000       // 客户端等待连接建立
+#define CHAT_HANDSHAKE_TIMEOUT_MS 5000      // 等待对端的握手报文
 
 class Chat {
     private:
@@ -31,23 +45,57 @@ class Chat {
         const char* serverIp;
         int serverPort;
         char message[MAX_MESSAGE_LENGTH];
-        char buffer[MAX_MESSAGE_LENGTH];
-        std::atomic<bool> isRunning;
-        std::atomic<bool> exited;
-        std::thread receiveThread;
-        DesOp des;
+        int messageLength;      // message 中尚未凑成完整一行的输入字节数
+        bool exited;
+        bool inputOpen;         // 标准输入尚未读到 EOF
+        uint32_t socketEvents;  // socket 当前在 epoll 中关注的事件（有积压时加上 EPOLLOUT 以续写）
+        bool pipeMode;          // 无交互的管道模式：标准输入按块加密发送，收到的明文原样写到标准输出
+        bool writeShutdown;     // 管道模式下输入结束且数据全部写出后已关闭写方向
+        bool peerClosed;        // 管道模式下对端已关闭写方向，不再关注 socket 可读
+        bool chatting;          // 握手完成、聊天处理函数已注册
+        std::vector<char> pipeOutput;
+        size_t pipeOutputLength;
+        EventLoop loop;         // 标准输入、socket 与唤醒 eventfd 在同一个线程内多路复用
+        SendQueue sendQueue;    // 出站帧直接加密进 slab，批量发送
+        InputReader input;      // 标准输入在独立线程上读取，经 SPSC 环交给事件循环线程
+        std::vector<MessageSpan> batch;     // 本次从环中取出、待一起加密的消息
+        FrameReader reader;
+        SessionCrypto crypto;   // DES 会话密钥与可选的消息认证状态
+        SharedMemoryChannel shared;     // 两端在同一主机上时协商，帧改经共享内存环收发
+        FileSender fileSender;
+        FileReceiver fileReceiver;
+        Journal journal;        // 设置 ENCCHAT_JOURNAL_DIR 时记录收到的消息帧（加密形式）
         RSA rsa; //added
         void Init();
-        void Connect();
-        void Send();
-        void ReceiveThread();
+        Task<void> AcceptPeer();    // 协程：接受连接并完成密钥交换，成功后开始聊天
+        Task<void> ConnectPeer();
+        void Send(const char* text, int length);
+        bool Flush();
+        void UpdateInterest();
+        void PumpFile();
+        void PumpInput();
+        size_t QueueLines(const char* data, size_t length);
+        size_t QueuePipeInput(const char* data, size_t length);
+        bool HandleLine(const char* line, int length);
+        void SendBatch();
+        void OnInputEnd();
+        void WriteOutput();
+        void OnSocket(uint32_t events);
+        void OnReceive();
+        void StartChat();
+        void StartSharedMemory();
+        bool PollShared();
+        void FinishChat();
         void Close();
     
     public:
         Chat();
         ~Chat();
+        void SetEndpoint(const char* ip, int port);
+        void SetPipeMode(bool enabled);
         void RunServer();
         void RunClient();
+        void Stop();            // 线程安全，立即结束聊天循环
     };
 
 #endif
\ No newline at end of file
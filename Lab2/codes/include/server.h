@@ -0,0 +1,178 @@
+// 多会话服务器：一个事件循环同时服务大量客户端，每个会话独立完成 RSA 密钥交换
+#ifndef ENCCHAT_SERVER_H
+#define ENCCHAT_SERVER_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Admission.h"
+#include "Datagram.h"
+#include "EventLoop.h"
+#include "Frame.h"
+#include "Handoff.h"
+#include "Protocol.h"
+#include "Metrics.h"
+#include "Capture.h"
+#include "CryptoBatch.h"
+#include "CryptoWorkers.h"
+#include "SharedMemory.h"
+
+#define SERVER_LISTEN_BACKLOG 4096
+#define SERVER_HANDSHAKE_TIMEOUT_MS (10 * 1000)         // 接受连接后须在此时间内收到会话密钥
+#define SERVER_IDLE_TIMEOUT_MS (5 * 60 * 1000)          // 已建立的会话这么久没有收到数据即断开
+#define SERVER_KEEPALIVE_MS (60 * 1000)                 // 这么久没有发出数据时发送一个保活帧
+#define SERVER_KEY_ROTATION_MS (60 * 60 * 1000)         // 服务器 RSA 密钥的更换周期
+#define SERVER_ACCEPT_BATCH 64                          // 每轮最多接受的连接数，其余留到下一轮
+#define SERVER_MAX_QUEUED_HANDSHAKES 1024               // 等待全局令牌的握手上限，队列满时直接拒绝新连接
+#define SERVER_HANDSHAKES_PER_ROUND 16                  // 每轮最多处理的握手数，两批之间先服务已建立的会话
+
+enum ServerMode {
+    SERVER_MODE_RELAY,      // 转发给其他所有会话（聊天室）
+    SERVER_MODE_ECHO        // 原样回送给发送者（压测用）
+};
+
+enum SessionState : uint8_t {
+    SESSION_AWAIT_KEY,      // 已发送公钥，等待客户端的 DES 会话密钥
+    SESSION_ESTABLISHED
+};
+
+// 服务器密钥：定期更换，握手中的会话继续持有发给它的那一把
+struct ServerKey {
+    RSA rsa;
+    HandshakeHello hello;
+};
+
+// 只在密钥交换期间需要的状态，会话建立后释放
+struct SessionHandshake {
+    uint64_t acceptTime;        // 用于统计握手耗时
+    int keyLength;              // 已收到的密钥报文字节数
+    bool queued;                // 密钥报文已收齐，在准入队列中等待处理
+    bool waited;                // 到达的那一轮没有轮到，已计入 METRIC_HANDSHAKES_QUEUED
+    bool decrypting;            // 已交给工作线程解密会话密钥
+    bool peerClosed;            // 排队或解密期间对方关闭了发送方向，建立后读完已缓冲的帧再关闭
+    uint64_t job;               // 工作线程任务的编号，用于认出完成时会话是否还是同一个
+    uint64_t features;          // Hello 中提供的特性（共享内存只提供给本机上的客户端）
+    std::shared_ptr<ServerKey> key;
+    HandshakeKey keyMessage;
+};
+
+// 工作线程上完成的握手运算：解密出的会话密钥、协商结果与据此建立的会话密码状态
+struct HandshakeResult {
+    SessionCrypto crypto;
+    uint8_t sessionKey[SESSION_KEY_MAX_LENGTH];
+    uint64_t features;
+};
+
+class Server;
+
+// 会话按访问频率排布：每次事件分发都要访问的字段在第一条缓存行内。
+// RSA 私钥由所有会话共享（见 Server::key），收发缓冲只在有数据待处理时从线程共享池借用，
+// 空闲会话只剩这个结构本身
+struct alignas(CACHE_LINE_SIZE) Session {
+    int fd;
+    uint32_t events;            // 当前在 epoll 中关注的事件
+    SessionState state;
+    bool readPaused;            // 自己的发送队列超过高水位时暂停读取（回显模式的背压）
+    bool dirty;                 // 本轮有待 Flush 的数据
+    // 最近一次收到 / 发出数据的时间轮格数（低 32 位）。收发时只更新时间戳，
+    // 会话定时器到期时再据此判断是否空闲或需要保活，无需每条消息都重新调度定时器
+    uint32_t lastReceive;
+    uint32_t lastSend;
+    std::unique_ptr<SessionHandshake> handshake;
+    FrameReader reader;
+    // 握手截止、空闲驱逐与保活共用一个定时器，总是指向其中最早的一个
+    TimerNode timer;
+    Server* server;
+    SendQueue sendQueue;
+    SessionCrypto crypto;
+    std::unique_ptr<DatagramChannel> datagram;  // 协商了数据报的会话才有
+    std::unique_ptr<SharedMemoryChannel> shared;    // 协商了共享内存的会话才有
+};
+
+class Server {
+private:
+    EventLoop loop;
+    int listenSocket;
+    int signalFd;
+    int handoffSocket;                  // 等待新进程接管的 Unix socket（设置了 HANDOFF_SOCKET_ENV 时）
+    std::string handoffPath;
+    bool handedOff;                     // 会话已交给新进程，本进程不再收发
+    int port;
+    ServerMode mode;
+    std::shared_ptr<ServerKey> key;     // 所有会话共用的服务器密钥，定期更换
+    TimerNode keyTimer;
+    std::vector<std::unique_ptr<Session>> sessions;     // 以 fd 为下标
+    size_t sessionCount;
+    std::vector<Session*> dirtySessions;
+    std::string captureDir;             // 非空时为每个建立的会话抓包
+    std::vector<std::unique_ptr<CaptureWriter>> captures;   // 以 fd 为下标，不占会话结构
+    DatagramSocket datagrams;           // 与 TCP 同端口的 UDP socket，所有会话共用
+    std::unordered_map<uint64_t, Session*> datagramSessions;    // 以数据报会话号为键
+    std::vector<Session*> ackSessions;  // 本批收到了可靠数据报、待回复确认的会话
+    std::vector<Session*> sharedSessions;   // 经共享内存收发的会话，由事件循环忙轮询
+    HandshakeAdmission admission;
+    std::deque<Session*> handshakeQueue;    // 密钥报文已收齐、等待全局令牌的握手，先到先处理
+    TimerNode admissionTimer;               // 队列非空而令牌用完时，在下一个令牌补充时唤醒事件循环
+    // 握手的 RSA 解密、会话密钥编排与服务器密钥的定期更换在这里进行，事件循环线程不做公钥运算
+    CryptoWorkers workers;
+    uint64_t handshakeJobs;
+    // 本轮发给各 DES 会话的帧合并加密，每次 Flush 会话之前完成；自检失败时为 false，逐会话加密
+    CryptoBatch batch;
+    bool batching;
+
+    uint64_t handshakes;
+    uint64_t messages;
+    uint64_t dropped;           // 中继时因目标会话背压或消息在目标会话上超长而丢弃的消息数
+    uint64_t timeouts;          // 握手超时
+    uint64_t evictions;         // 空闲驱逐
+
+    bool Listen();
+    std::unique_ptr<Session> NewSession(int fd);
+    Session* AddSession(std::unique_ptr<Session> session);
+    void OnAccept();
+    void OnSession(Session* session, uint32_t events);
+    bool OnKeyMessage(Session* session, uint32_t events);
+    void QueueHandshake(Session* session);
+    void AdmitHandshakes();
+    bool StartHandshake(Session* session);
+    void OnHandshakeDone(int fd, uint64_t job, HandshakeResult& result);
+    bool FinishHandshake(Session* session, const uint8_t* sessionKey, uint64_t features);
+    bool OnFrames(Session* session);
+    void Deliver(Session* target, const char* text, int length, uint8_t flags);
+    bool FlushSession(Session* session);
+    void FlushDirty();
+    void UpdateInterest(Session* session);
+    void CloseSession(Session* session);
+    void PrintMemory();
+    bool RotateKey();
+    void RotateKeyInBackground();
+    void OnSessionTimer(Session* session);
+    void QueueKeepalive(Session* session);
+    void StartCapture(Session* session, const uint8_t* sessionKey, uint64_t features);
+    void OnDatagrams();
+    void OnDatagram(char* data, int length, const sockaddr_in& from, uint64_t now);
+    void SendDatagram(Session* target, const char* text, int length, bool reliable, uint64_t now);
+    void OnDatagramTimer(Session* session);
+    bool StartDatagram(Session* session);
+    void StartSharedMemory(Session* session);
+    void AttachSharedMemory(Session* session, std::unique_ptr<SharedMemoryChannel> channel);
+    bool PollShared();
+    bool ParkShared();
+    void OnHandoff();
+    void SaveState(HandoffWriter& out);
+    void SaveSession(HandoffWriter& out, Session* session);
+    bool TakeOver(int sock);
+    bool RestoreSession(HandoffReader& in);
+
+public:
+    Server(int port = DEFAULT_SERVER_PORT, ServerMode mode = SERVER_MODE_RELAY);
+    ~Server();
+    // 运行直到 Stop() 或收到 SIGINT / SIGTERM
+    bool Run();
+    void Stop();
+};
+
+#endif
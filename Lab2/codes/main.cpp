@@ -1,17 +1,72 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 #include "chat.h"
+#include "server.h"
+#include "Metrics.h"
+#include "Trace.h"
 
-int main() {
-    Chat chat;
-    char isServer;
-    std::cout << "Are you Server or Client? (s/c): ";
-    std::cin >> isServer;
-    if (isServer == 's') {
-        chat.RunServer();
-    } else if (isServer == 'c') {
-        chat.RunClient();
+static void Usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--role s|c|r|e] [--host IP] [--port PORT]" << std::endl;
+    std::cerr << "Without arguments the role is asked interactively. With --role s or c the program runs headless:" << std::endl;
+    std::cerr << "stdin is streamed over the encrypted channel and received data is written to stdout." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    char role = 0;
+    const char* host = DEFAULT_SERVER_IP;
+    int port = DEFAULT_SERVER_PORT;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (strcmp(arg, "--role") == 0) {
+            role = value[0];
+        } else if (strcmp(arg, "--host") == 0) {
+            host = value;
+        } else if (strcmp(arg, "--port") == 0) {
+            port = atoi(value);
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    bool headless = argc > 1;
+    if (headless && role == 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    Metrics::StartExporter();
+    if (!headless) {
+        std::cout << "Are you Server, Client, Relay or Echo server? (s/c/r/e): ";
+        std::cin >> role;
+    }
+    if (role == 's' || role == 'c') {
+        Chat chat;
+        chat.SetEndpoint(host, port);
+        // 管道模式下标准输出只用于数据，状态信息改写到标准错误
+        std::streambuf* output = std::cout.rdbuf();
+        if (headless) {
+            std::cout.rdbuf(std::cerr.rdbuf());
+            chat.SetPipeMode(true);
+        }
+        if (role == 's') {
+            chat.RunServer();
+        } else {
+            chat.RunClient();
+        }
+        std::cout.rdbuf(output);
+    } else if (role == 'r' || role == 'e') {
+        Server server(port, role == 'e' ? SERVER_MODE_ECHO : SERVER_MODE_RELAY);
+        server.Run();
     } else {
         std::cerr << "Error: Invalid input." << std::endl;
     }
+    Metrics::StopExporter();
+    TRACE_DUMP();
     return 0;
-}
\ No newline at end of file
+}
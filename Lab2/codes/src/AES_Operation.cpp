@@ -0,0 +1,619 @@
+// AesOp
+#include "AES_Operation.h"
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AES_HAVE_AESNI 1
+#endif
+
+static inline uint64_t Load64(const uint8_t* p) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static inline void Store64(uint8_t* p, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static inline void Increment32(uint8_t* counter) {
+    for (int i = 15; i >= 12; i--) {
+        if (++counter[i] != 0) {
+            break;
+        }
+    }
+}
+
+// ---- 常数时间的软件实现 ----
+
+// 8x8 位矩阵转置：第 j 个字节的第 i 位与第 i 个字节的第 j 位互换
+static inline uint64_t Transpose8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+// Boyar-Peralta 的 S 盒电路（113 个异或 / 与门）：q[k] 的每一位是一个字节的第 k 位，
+// 一次计算 64 个字节的 S 盒，没有查表，也就没有依赖数据的访存
+static void SboxPlanes(uint64_t* q) {
+    uint64_t x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4];
+    uint64_t x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+    // 顶部线性变换
+    uint64_t y14 = x3 ^ x5;
+    uint64_t y13 = x0 ^ x6;
+    uint64_t y9 = x0 ^ x3;
+    uint64_t y8 = x0 ^ x5;
+    uint64_t t0 = x1 ^ x2;
+    uint64_t y1 = t0 ^ x7;
+    uint64_t y4 = y1 ^ x3;
+    uint64_t y12 = y13 ^ y14;
+    uint64_t y2 = y1 ^ x0;
+    uint64_t y5 = y1 ^ x6;
+    uint64_t y3 = y5 ^ y8;
+    uint64_t t1 = x4 ^ y12;
+    uint64_t y15 = t1 ^ x5;
+    uint64_t y20 = t1 ^ x1;
+    uint64_t y6 = y15 ^ x7;
+    uint64_t y10 = y15 ^ t0;
+    uint64_t y11 = y20 ^ y9;
+    uint64_t y7 = x7 ^ y11;
+    uint64_t y17 = y10 ^ y11;
+    uint64_t y19 = y10 ^ y8;
+    uint64_t y16 = t0 ^ y11;
+    uint64_t y21 = y13 ^ y16;
+    uint64_t y18 = x0 ^ y16;
+
+    // 非线性部分：GF(2^4) 上的求逆
+    uint64_t t2 = y12 & y15;
+    uint64_t t3 = y3 & y6;
+    uint64_t t4 = t3 ^ t2;
+    uint64_t t5 = y4 & x7;
+    uint64_t t6 = t5 ^ t2;
+    uint64_t t7 = y13 & y16;
+    uint64_t t8 = y5 & y1;
+    uint64_t t9 = t8 ^ t7;
+    uint64_t t10 = y2 & y7;
+    uint64_t t11 = t10 ^ t7;
+    uint64_t t12 = y9 & y11;
+    uint64_t t13 = y14 & y17;
+    uint64_t t14 = t13 ^ t12;
+    uint64_t t15 = y8 & y10;
+    uint64_t t16 = t15 ^ t12;
+    uint64_t t17 = t4 ^ t14;
+    uint64_t t18 = t6 ^ t16;
+    uint64_t t19 = t9 ^ t14;
+    uint64_t t20 = t11 ^ t16;
+    uint64_t t21 = t17 ^ y20;
+    uint64_t t22 = t18 ^ y19;
+    uint64_t t23 = t19 ^ y21;
+    uint64_t t24 = t20 ^ y18;
+    uint64_t t25 = t21 ^ t22;
+    uint64_t t26 = t21 & t23;
+    uint64_t t27 = t24 ^ t26;
+    uint64_t t28 = t25 & t27;
+    uint64_t t29 = t28 ^ t22;
+    uint64_t t30 = t23 ^ t24;
+    uint64_t t31 = t22 ^ t26;
+    uint64_t t32 = t31 & t30;
+    uint64_t t33 = t32 ^ t24;
+    uint64_t t34 = t23 ^ t33;
+    uint64_t t35 = t27 ^ t33;
+    uint64_t t36 = t24 & t35;
+    uint64_t t37 = t36 ^ t34;
+    uint64_t t38 = t27 ^ t36;
+    uint64_t t39 = t29 & t38;
+    uint64_t t40 = t25 ^ t39;
+    uint64_t t41 = t40 ^ t37;
+    uint64_t t42 = t29 ^ t33;
+    uint64_t t43 = t29 ^ t40;
+    uint64_t t44 = t33 ^ t37;
+    uint64_t t45 = t42 ^ t41;
+    uint64_t z0 = t44 & y15;
+    uint64_t z1 = t37 & y6;
+    uint64_t z2 = t33 & x7;
+    uint64_t z3 = t43 & y16;
+    uint64_t z4 = t40 & y1;
+    uint64_t z5 = t29 & y7;
+    uint64_t z6 = t42 & y11;
+    uint64_t z7 = t45 & y17;
+    uint64_t z8 = t41 & y10;
+    uint64_t z9 = t44 & y12;
+    uint64_t z10 = t37 & y3;
+    uint64_t z11 = t33 & y4;
+    uint64_t z12 = t43 & y13;
+    uint64_t z13 = t40 & y5;
+    uint64_t z14 = t29 & y2;
+    uint64_t z15 = t42 & y9;
+    uint64_t z16 = t45 & y14;
+    uint64_t z17 = t41 & y8;
+
+    // 底部线性变换（含仿射常数 0x63）
+    uint64_t t46 = z15 ^ z16;
+    uint64_t t47 = z10 ^ z11;
+    uint64_t t48 = z5 ^ z13;
+    uint64_t t49 = z9 ^ z10;
+    uint64_t t50 = z2 ^ z12;
+    uint64_t t51 = z2 ^ z5;
+    uint64_t t52 = z7 ^ z8;
+    uint64_t t53 = z0 ^ z3;
+    uint64_t t54 = z6 ^ z7;
+    uint64_t t55 = z16 ^ z17;
+    uint64_t t56 = z12 ^ t48;
+    uint64_t t57 = t50 ^ t53;
+    uint64_t t58 = z4 ^ t46;
+    uint64_t t59 = z3 ^ t54;
+    uint64_t t60 = t46 ^ t57;
+    uint64_t t61 = z14 ^ t57;
+    uint64_t t62 = t52 ^ t58;
+    uint64_t t63 = t49 ^ t58;
+    uint64_t t64 = z4 ^ t59;
+    uint64_t t65 = t61 ^ t62;
+    uint64_t t66 = z1 ^ t63;
+    uint64_t s0 = t59 ^ t63;
+    uint64_t s6 = t56 ^ ~t62;
+    uint64_t s7 = t48 ^ ~t60;
+    uint64_t t67 = t64 ^ t65;
+    uint64_t s3 = t53 ^ t66;
+    uint64_t s4 = t51 ^ t66;
+    uint64_t s5 = t47 ^ t65;
+    uint64_t s1 = t64 ^ ~s3;
+    uint64_t s2 = t55 ^ ~t67;
+
+    q[7] = s0; q[6] = s1; q[5] = s2; q[4] = s3;
+    q[3] = s4; q[2] = s5; q[1] = s6; q[0] = s7;
+}
+
+// 对 64 字节（4 个分组）做 SubBytes：转置成 8 个位平面，过 S 盒电路，再转置回来
+static void SubBytes64(uint8_t* bytes) {
+    uint64_t planes[8] = {0};
+    for (int g = 0; g < 8; g++) {
+        uint64_t x = 0;
+        for (int j = 7; j >= 0; j--) {
+            x = (x << 8) | bytes[g * 8 + j];
+        }
+        x = Transpose8(x);
+        for (int k = 0; k < 8; k++) {
+            planes[k] |= ((x >> (8 * k)) & 0xFF) << (8 * g);
+        }
+    }
+    SboxPlanes(planes);
+    for (int g = 0; g < 8; g++) {
+        uint64_t x = 0;
+        for (int k = 0; k < 8; k++) {
+            x |= ((planes[k] >> (8 * g)) & 0xFF) << (8 * k);
+        }
+        x = Transpose8(x);
+        for (int j = 0; j < 8; j++) {
+            bytes[g * 8 + j] = (uint8_t)(x >> (8 * j));
+        }
+    }
+}
+
+// 状态按列存放：第 r 行第 c 列为 block[r + 4c]
+static void ShiftRows(uint8_t* block) {
+    uint8_t t[AES_BLOCK_SIZE];
+    memcpy(t, block, AES_BLOCK_SIZE);
+    for (int r = 1; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            block[r + 4 * c] = t[r + 4 * ((c + r) & 3)];
+        }
+    }
+}
+
+static inline uint32_t Rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+// 一列的四个字节装进一个 32 位字（第 0 行在最低字节），xtime 对四个字节同时进行
+static void MixColumns(uint8_t* block) {
+    for (int c = 0; c < 4; c++) {
+        uint8_t* column = block + 4 * c;
+        uint32_t x = (uint32_t)column[0] | ((uint32_t)column[1] << 8) | ((uint32_t)column[2] << 16) | ((uint32_t)column[3] << 24);
+        uint32_t next = Rotr32(x, 8);
+        uint32_t y = x ^ next;
+        uint32_t doubled = ((y & 0x7F7F7F7Fu) << 1) ^ (((y >> 7) & 0x01010101u) * 0x1B);
+        x = doubled ^ next ^ Rotr32(x, 16) ^ Rotr32(x, 24);
+        for (int r = 0; r < 4; r++) {
+            column[r] = (uint8_t)(x >> (8 * r));
+        }
+    }
+}
+
+void AesOp::EncryptBlocksGeneric(const uint8_t* in, uint8_t* out, size_t blocks) const {
+    while (blocks > 0) {
+        size_t count = blocks < 4 ? blocks : 4;
+        uint8_t state[4 * AES_BLOCK_SIZE] = {0};
+        memcpy(state, in, count * AES_BLOCK_SIZE);
+        for (int i = 0; i < 4 * AES_BLOCK_SIZE; i++) {
+            state[i] ^= roundKeys[i % AES_BLOCK_SIZE];
+        }
+        for (int round = 1; round <= rounds; round++) {
+            SubBytes64(state);
+            for (int b = 0; b < 4; b++) {
+                ShiftRows(state + b * AES_BLOCK_SIZE);
+                if (round != rounds) {
+                    MixColumns(state + b * AES_BLOCK_SIZE);
+                }
+            }
+            const uint8_t* roundKey = roundKeys + round * AES_BLOCK_SIZE;
+            for (int i = 0; i < 4 * AES_BLOCK_SIZE; i++) {
+                state[i] ^= roundKey[i % AES_BLOCK_SIZE];
+            }
+        }
+        memcpy(out, state, count * AES_BLOCK_SIZE);
+        in += count * AES_BLOCK_SIZE;
+        out += count * AES_BLOCK_SIZE;
+        blocks -= count;
+    }
+}
+
+void AesOp::CtrGeneric(uint8_t* counter, const uint8_t* in, uint8_t* out, size_t length) const {
+    uint8_t keyStream[4 * AES_BLOCK_SIZE];
+    while (length > 0) {
+        size_t blocks = (length + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+        if (blocks > 4) {
+            blocks = 4;
+        }
+        for (size_t i = 0; i < blocks; i++) {
+            memcpy(keyStream + i * AES_BLOCK_SIZE, counter, AES_BLOCK_SIZE);
+            Increment32(counter);
+        }
+        EncryptBlocksGeneric(keyStream, keyStream, blocks);
+        size_t take = length < blocks * AES_BLOCK_SIZE ? length : blocks * AES_BLOCK_SIZE;
+        for (size_t i = 0; i < take; i++) {
+            out[i] = in[i] ^ keyStream[i];
+        }
+        in += take;
+        out += take;
+        length -= take;
+    }
+}
+
+// GF(2^128) 上的逐位乘法，分支与访存只依赖循环变量
+void AesOp::GhashGeneric(uint8_t* state, const uint8_t* data, size_t length) const {
+    uint64_t xh = Load64(state), xl = Load64(state + 8);
+    while (length > 0) {
+        uint8_t block[AES_BLOCK_SIZE] = {0};
+        size_t take = length < AES_BLOCK_SIZE ? length : AES_BLOCK_SIZE;
+        memcpy(block, data, take);
+        xh ^= Load64(block);
+        xl ^= Load64(block + 8);
+
+        uint64_t zh = 0, zl = 0;
+        uint64_t vh = hashKey[0], vl = hashKey[1];
+        for (int i = 0; i < 128; i++) {
+            uint64_t bit = (i < 64 ? xh >> (63 - i) : xl >> (127 - i)) & 1;
+            uint64_t mask = 0 - bit;
+            zh ^= vh & mask;
+            zl ^= vl & mask;
+            uint64_t carry = 0 - (vl & 1);
+            vl = (vl >> 1) | (vh << 63);
+            vh = (vh >> 1) ^ (0xE100000000000000ull & carry);
+        }
+        xh = zh;
+        xl = zl;
+        data += take;
+        length -= take;
+    }
+    Store64(state, xh);
+    Store64(state + 8, xl);
+}
+
+// ---- AES-NI 与 PCLMULQDQ ----
+
+#ifdef AES_HAVE_AESNI
+// 两个字节反序的 128 位数做无进位乘法，累加到 256 位的部分积（lo、mid、hi）中，约减留到最后一次完成
+__attribute__((target("pclmul,sse4.1")))
+static inline void ClmulAccumulate(__m128i a, __m128i b, __m128i& lo, __m128i& mid, __m128i& hi) {
+    lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+    hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x10));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x01));
+}
+
+// 合并部分积，整体左移一位（GHASH 的位序是反的），再按 x^128 + x^7 + x^2 + x + 1 约减
+__attribute__((target("pclmul,sse4.1")))
+static inline __m128i ClmulReduce(__m128i lo, __m128i mid, __m128i hi) {
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    __m128i loCarry = _mm_srli_epi32(lo, 31);
+    __m128i hiCarry = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i crossCarry = _mm_srli_si128(loCarry, 12);
+    hiCarry = _mm_slli_si128(hiCarry, 4);
+    loCarry = _mm_slli_si128(loCarry, 4);
+    lo = _mm_or_si128(lo, loCarry);
+    hi = _mm_or_si128(hi, hiCarry);
+    hi = _mm_or_si128(hi, crossCarry);
+
+    __m128i a = _mm_slli_epi32(lo, 31);
+    __m128i b = _mm_slli_epi32(lo, 30);
+    __m128i c = _mm_slli_epi32(lo, 25);
+    a = _mm_xor_si128(a, b);
+    a = _mm_xor_si128(a, c);
+    b = _mm_srli_si128(a, 4);
+    a = _mm_slli_si128(a, 12);
+    lo = _mm_xor_si128(lo, a);
+    __m128i d = _mm_srli_epi32(lo, 1);
+    __m128i e = _mm_srli_epi32(lo, 2);
+    __m128i f = _mm_srli_epi32(lo, 7);
+    d = _mm_xor_si128(d, e);
+    d = _mm_xor_si128(d, f);
+    d = _mm_xor_si128(d, b);
+    lo = _mm_xor_si128(lo, d);
+    return _mm_xor_si128(hi, lo);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+void AesOp::PrecomputePclmul() {
+    const __m128i BSWAP = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    uint8_t h[AES_BLOCK_SIZE];
+    Store64(h, hashKey[0]);
+    Store64(h + 8, hashKey[1]);
+    __m128i power = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)h), BSWAP);
+    __m128i first = power;
+    _mm_store_si128((__m128i*)hashKeyPowers[0], power);
+    for (int i = 1; i < 4; i++) {
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        ClmulAccumulate(power, first, lo, mid, hi);
+        power = ClmulReduce(lo, mid, hi);
+        _mm_store_si128((__m128i*)hashKeyPowers[i], power);
+    }
+}
+
+// 每 4 个分组：X' = (X ^ C1)·H^4 ^ C2·H^3 ^ C3·H^2 ^ C4·H，四个乘积累加后只约减一次
+__attribute__((target("pclmul,sse4.1")))
+void AesOp::GhashPclmul(uint8_t* state, const uint8_t* data, size_t length) const {
+    const __m128i BSWAP = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)state), BSWAP);
+    __m128i h1 = _mm_load_si128((const __m128i*)hashKeyPowers[0]);
+    __m128i h2 = _mm_load_si128((const __m128i*)hashKeyPowers[1]);
+    __m128i h3 = _mm_load_si128((const __m128i*)hashKeyPowers[2]);
+    __m128i h4 = _mm_load_si128((const __m128i*)hashKeyPowers[3]);
+
+    while (length >= 4 * AES_BLOCK_SIZE) {
+        __m128i c0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), BSWAP);
+        __m128i c1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), BSWAP);
+        __m128i c2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), BSWAP);
+        __m128i c3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), BSWAP);
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        ClmulAccumulate(_mm_xor_si128(x, c0), h4, lo, mid, hi);
+        ClmulAccumulate(c1, h3, lo, mid, hi);
+        ClmulAccumulate(c2, h2, lo, mid, hi);
+        ClmulAccumulate(c3, h1, lo, mid, hi);
+        x = ClmulReduce(lo, mid, hi);
+        data += 4 * AES_BLOCK_SIZE;
+        length -= 4 * AES_BLOCK_SIZE;
+    }
+    while (length > 0) {
+        uint8_t block[AES_BLOCK_SIZE] = {0};
+        size_t take = length < AES_BLOCK_SIZE ? length : AES_BLOCK_SIZE;
+        memcpy(block, data, take);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)block), BSWAP);
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        ClmulAccumulate(_mm_xor_si128(x, c), h1, lo, mid, hi);
+        x = ClmulReduce(lo, mid, hi);
+        data += take;
+        length -= take;
+    }
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi8(x, BSWAP));
+}
+
+// 8 个计数器分组同时在流水线中：每一轮的 aesenc 依次发给 8 个分组，掩盖单条指令的延迟
+__attribute__((target("aes,sse4.1")))
+void AesOp::CtrAesNi(uint8_t* counter, const uint8_t* in, uint8_t* out, size_t length) const {
+    // 按最大轮数装入（轮密钥数组总是这么大），编译器能看出每一项都已初始化
+    __m128i keys[AES_MAX_ROUNDS + 1];
+    for (int i = 0; i <= AES_MAX_ROUNDS; i++) {
+        keys[i] = _mm_load_si128((const __m128i*)(roundKeys + i * AES_BLOCK_SIZE));
+    }
+    __m128i base = _mm_loadu_si128((const __m128i*)counter);
+    uint32_t next = ((uint32_t)counter[12] << 24) | ((uint32_t)counter[13] << 16) | ((uint32_t)counter[14] << 8) | counter[15];
+
+    while (length >= 8 * AES_BLOCK_SIZE) {
+        __m128i b[8];
+        for (int i = 0; i < 8; i++) {
+            b[i] = _mm_xor_si128(_mm_insert_epi32(base, (int)__builtin_bswap32(next + i), 3), keys[0]);
+        }
+        for (int r = 1; r < rounds; r++) {
+            for (int i = 0; i < 8; i++) {
+                b[i] = _mm_aesenc_si128(b[i], keys[r]);
+            }
+        }
+        for (int i = 0; i < 8; i++) {
+            b[i] = _mm_aesenclast_si128(b[i], keys[rounds]);
+            __m128i data = _mm_loadu_si128((const __m128i*)(in + i * AES_BLOCK_SIZE));
+            _mm_storeu_si128((__m128i*)(out + i * AES_BLOCK_SIZE), _mm_xor_si128(data, b[i]));
+        }
+        next += 8;
+        in += 8 * AES_BLOCK_SIZE;
+        out += 8 * AES_BLOCK_SIZE;
+        length -= 8 * AES_BLOCK_SIZE;
+    }
+    while (length > 0) {
+        __m128i b = _mm_xor_si128(_mm_insert_epi32(base, (int)__builtin_bswap32(next), 3), keys[0]);
+        for (int r = 1; r < rounds; r++) {
+            b = _mm_aesenc_si128(b, keys[r]);
+        }
+        b = _mm_aesenclast_si128(b, keys[rounds]);
+        next++;
+        size_t take = length < AES_BLOCK_SIZE ? length : AES_BLOCK_SIZE;
+        uint8_t keyStream[AES_BLOCK_SIZE];
+        _mm_storeu_si128((__m128i*)keyStream, b);
+        for (size_t i = 0; i < take; i++) {
+            out[i] = in[i] ^ keyStream[i];
+        }
+        in += take;
+        out += take;
+        length -= take;
+    }
+    counter[12] = (uint8_t)(next >> 24);
+    counter[13] = (uint8_t)(next >> 16);
+    counter[14] = (uint8_t)(next >> 8);
+    counter[15] = (uint8_t)next;
+}
+
+bool AesOp::HasAesNi() {
+    static const bool supported = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+                                  __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+#else
+void AesOp::PrecomputePclmul() {
+}
+
+void AesOp::GhashPclmul(uint8_t* state, const uint8_t* data, size_t length) const {
+    GhashGeneric(state, data, length);
+}
+
+void AesOp::CtrAesNi(uint8_t* counter, const uint8_t* in, uint8_t* out, size_t length) const {
+    CtrGeneric(counter, in, out, length);
+}
+
+bool AesOp::HasAesNi() {
+    return false;
+}
+#endif
+
+// ---- 公共接口 ----
+
+AesOp::AesOp() {
+    memset(roundKeys, 0, sizeof(roundKeys));
+    memset(hashKeyPowers, 0, sizeof(hashKeyPowers));
+    hashKey[0] = hashKey[1] = 0;
+    rounds = 10;
+}
+
+// FIPS-197 的密钥扩展；SubWord 同样走位切片 S 盒
+void AesOp::SetKey(const uint8_t* key, int length) {
+    static const uint8_t RCON[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
+    int words = length / 4;
+    rounds = words + 6;
+    memcpy(roundKeys, key, length);
+    for (int i = words; i < 4 * (rounds + 1); i++) {
+        uint8_t temp[4];
+        memcpy(temp, roundKeys + (i - 1) * 4, 4);
+        if (i % words == 0 || (words > 6 && i % words == 4)) {
+            if (i % words == 0) {
+                uint8_t first = temp[0];
+                temp[0] = temp[1];
+                temp[1] = temp[2];
+                temp[2] = temp[3];
+                temp[3] = first;
+            }
+            uint8_t bytes[4 * AES_BLOCK_SIZE] = {0};
+            memcpy(bytes, temp, 4);
+            SubBytes64(bytes);
+            memcpy(temp, bytes, 4);
+            if (i % words == 0) {
+                temp[0] ^= RCON[i / words - 1];
+            }
+        }
+        for (int j = 0; j < 4; j++) {
+            roundKeys[i * 4 + j] = roundKeys[(i - words) * 4 + j] ^ temp[j];
+        }
+    }
+
+    // GHASH 密钥 H = E_K(0^128)
+    uint8_t zero[AES_BLOCK_SIZE] = {0};
+    uint8_t h[AES_BLOCK_SIZE];
+    EncryptBlock(zero, h);
+    hashKey[0] = Load64(h);
+    hashKey[1] = Load64(h + 8);
+    if (HasAesNi()) {
+        PrecomputePclmul();
+    }
+}
+
+void AesOp::EncryptBlock(const uint8_t* in, uint8_t* out) const {
+    uint8_t counter[AES_BLOCK_SIZE];
+    memcpy(counter, in, AES_BLOCK_SIZE);
+    // 计数器模式加密全零分组即得到 E_K(in)
+    uint8_t zero[AES_BLOCK_SIZE] = {0};
+    Ctr(counter, zero, out, AES_BLOCK_SIZE);
+}
+
+void AesOp::Ctr(uint8_t* counter, const uint8_t* in, uint8_t* out, size_t length) const {
+    if (HasAesNi()) {
+        CtrAesNi(counter, in, out, length);
+    } else {
+        CtrGeneric(counter, in, out, length);
+    }
+}
+
+void AesOp::Ghash(uint8_t* state, const uint8_t* data, size_t length) const {
+    if (HasAesNi()) {
+        GhashPclmul(state, data, length);
+    } else {
+        GhashGeneric(state, data, length);
+    }
+}
+
+void AesOp::CtrCrypt(const uint8_t* nonce, const char* in, char* out, size_t length) const {
+    uint8_t counter[AES_BLOCK_SIZE] = {0};
+    memcpy(counter, nonce, AES_GCM_NONCE_SIZE);
+    Ctr(counter, (const uint8_t*)in, (uint8_t*)out, length);
+}
+
+// 吸收长度分组，再与 E_K(J0) 异或得到标签，J0 = nonce || 00000001
+void AesOp::GcmTag(uint8_t* state, const uint8_t* nonce, size_t aadLength, size_t length, uint8_t* tag) const {
+    uint8_t lengths[AES_BLOCK_SIZE];
+    Store64(lengths, (uint64_t)aadLength * 8);
+    Store64(lengths + 8, (uint64_t)length * 8);
+    Ghash(state, lengths, AES_BLOCK_SIZE);
+    uint8_t counter[AES_BLOCK_SIZE] = {0};
+    memcpy(counter, nonce, AES_GCM_NONCE_SIZE);
+    counter[15] = 1;
+    Ctr(counter, state, tag, AES_BLOCK_SIZE);
+}
+
+void AesOp::GcmSeal(const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                    const char* in, char* out, size_t length, uint8_t* tag) const {
+    uint8_t state[AES_BLOCK_SIZE] = {0};
+    Ghash(state, aad, aadLength);
+    uint8_t counter[AES_BLOCK_SIZE] = {0};
+    memcpy(counter, nonce, AES_GCM_NONCE_SIZE);
+    counter[15] = 2;
+    for (size_t done = 0; done < length; done += AES_GCM_CHUNK_SIZE) {
+        size_t chunk = length - done < AES_GCM_CHUNK_SIZE ? length - done : AES_GCM_CHUNK_SIZE;
+        Ctr(counter, (const uint8_t*)in + done, (uint8_t*)out + done, chunk);
+        Ghash(state, (const uint8_t*)out + done, chunk);
+    }
+    GcmTag(state, nonce, aadLength, length, tag);
+}
+
+bool AesOp::GcmOpen(const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                    const char* in, char* out, size_t length, const uint8_t* tag) const {
+    uint8_t state[AES_BLOCK_SIZE] = {0};
+    Ghash(state, aad, aadLength);
+    uint8_t counter[AES_BLOCK_SIZE] = {0};
+    memcpy(counter, nonce, AES_GCM_NONCE_SIZE);
+    counter[15] = 2;
+    // 每块先吸收密文再解密，原地解密时也不会读到已被覆盖的数据
+    for (size_t done = 0; done < length; done += AES_GCM_CHUNK_SIZE) {
+        size_t chunk = length - done < AES_GCM_CHUNK_SIZE ? length - done : AES_GCM_CHUNK_SIZE;
+        Ghash(state, (const uint8_t*)in + done, chunk);
+        Ctr(counter, (const uint8_t*)in + done, (uint8_t*)out + done, chunk);
+    }
+    uint8_t expected[AES_GCM_TAG_SIZE];
+    GcmTag(state, nonce, aadLength, length, expected);
+    // 常数时间比较
+    uint8_t diff = 0;
+    for (int i = 0; i < AES_GCM_TAG_SIZE; i++) {
+        diff |= expected[i] ^ tag[i];
+    }
+    return diff == 0;
+}
@@ -0,0 +1,82 @@
+// TokenBucket / HandshakeAdmission
+#include "Admission.h"
+#include "Metrics.h"
+#include <cstdlib>
+
+TokenBucket::TokenBucket(double rate, uint64_t now) {
+    this->rate = rate;
+    tokens = rate;
+    last = now;
+}
+
+void TokenBucket::Refill(uint64_t now) {
+    if (now > last) {
+        tokens += rate * (double)(now - last) / 1e9;
+        if (tokens > rate) {
+            tokens = rate;
+        }
+        last = now;
+    }
+}
+
+bool TokenBucket::Take(uint64_t now) {
+    if (rate <= 0) {
+        return true;
+    }
+    Refill(now);
+    if (tokens < 1) {
+        return false;
+    }
+    tokens -= 1;
+    return true;
+}
+
+bool TokenBucket::Full(uint64_t now) const {
+    return rate <= 0 || tokens + rate * (double)(now - last) / 1e9 >= rate;
+}
+
+uint64_t TokenBucket::NanosUntilToken(uint64_t now) const {
+    if (rate <= 0) {
+        return 0;
+    }
+    double available = tokens + rate * (double)(now > last ? now - last : 0) / 1e9;
+    return available >= 1 ? 0 : (uint64_t)((1 - available) / rate * 1e9) + 1;
+}
+
+static double RateFromEnv(const char* name, int fallback) {
+    const char* value = getenv(name);
+    return value != nullptr ? atoi(value) : fallback;
+}
+
+HandshakeAdmission::HandshakeAdmission() {
+    sourceRate = RateFromEnv(ADMISSION_SOURCE_RATE_ENV, ADMISSION_DEFAULT_SOURCE_RATE);
+    global = TokenBucket(RateFromEnv(ADMISSION_RATE_ENV, ADMISSION_DEFAULT_RATE), Metrics::NowNanos());
+}
+
+void HandshakeAdmission::Prune(uint64_t now) {
+    for (auto it = sources.begin(); it != sources.end();) {
+        if (it->second.Full(now)) {
+            it = sources.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool HandshakeAdmission::AdmitSource(uint32_t address, uint64_t now) {
+    if (sourceRate <= 0) {
+        return true;
+    }
+    auto it = sources.find(address);
+    if (it == sources.end()) {
+        if (sources.size() >= ADMISSION_MAX_SOURCES) {
+            Prune(now);
+        }
+        // 同时活跃的来源太多时新来源只受全局限制
+        if (sources.size() >= ADMISSION_MAX_SOURCES) {
+            return true;
+        }
+        it = sources.emplace(address, TokenBucket(sourceRate, now)).first;
+    }
+    return it->second.Take(now);
+}
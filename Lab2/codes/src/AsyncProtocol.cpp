@@ -0,0 +1,44 @@
+// AsyncProtocol
+#include "AsyncProtocol.h"
+#include <cerrno>
+
+static HandshakeStatus ReceiveFailure(ssize_t len) {
+    return len < 0 && errno == ETIMEDOUT ? HANDSHAKE_TIMEOUT : HANDSHAKE_RECV_FAILED;
+}
+
+Task<HandshakeStatus> AcceptHandshake(AsyncSocket& socket, RSA& rsa, SessionCrypto& crypto, int timeoutMs,
+                                      uint64_t offered) {
+    HandshakeHello hello = {rsa.GetPublicKey(), rsa.GetModulus(), offered};
+    if (co_await socket.WriteAll(&hello, sizeof(hello), timeoutMs) < 0) {
+        co_return HANDSHAKE_SEND_FAILED;
+    }
+    HandshakeKey keyMessage;
+    ssize_t len = co_await socket.ReadExactly(&keyMessage, sizeof(keyMessage), timeoutMs);
+    if (len <= 0) {
+        co_return ReceiveFailure(len);
+    }
+    uint64_t features = SelectFeatures(keyMessage.features, offered);
+    uint8_t sessionKey[SESSION_KEY_MAX_LENGTH];
+    DecryptSessionKey(rsa, keyMessage, SessionKeyLength(features), sessionKey);
+    SetupSessionCrypto(crypto, sessionKey, features, true);
+    co_return HANDSHAKE_DONE;
+}
+
+Task<HandshakeStatus> ConnectHandshake(AsyncSocket& socket, SessionCrypto& crypto, uint64_t features, int timeoutMs) {
+    HandshakeHello hello;
+    ssize_t len = co_await socket.ReadExactly(&hello, sizeof(hello), timeoutMs);
+    if (len <= 0) {
+        co_return ReceiveFailure(len);
+    }
+    HandshakeKey keyMessage;
+    keyMessage.features = SelectFeatures(hello.features, features);
+    int keyLength = SessionKeyLength(keyMessage.features);
+    uint8_t sessionKey[SESSION_KEY_MAX_LENGTH];
+    GenerateSessionKey(sessionKey, keyLength);
+    EncryptSessionKey(sessionKey, keyLength, hello, keyMessage);
+    SetupSessionCrypto(crypto, sessionKey, keyMessage.features, false);
+    if (co_await socket.WriteAll(&keyMessage, sizeof(keyMessage), timeoutMs) < 0) {
+        co_return HANDSHAKE_SEND_FAILED;
+    }
+    co_return HANDSHAKE_DONE;
+}
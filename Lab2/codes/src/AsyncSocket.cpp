@@ -0,0 +1,239 @@
+// AsyncSocket
+#include "AsyncSocket.h"
+#include "Trace.h"
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+AsyncSocket::AsyncSocket(EventLoop& loop, int fd) {
+    this->loop = &loop;
+    this->fd = fd;
+    destroyed = nullptr;
+    // 边沿触发：只在状态变化时通知一次，没有协程等待时的就绪事件直接忽略，
+    // 协程总是先尝试系统调用，遇到 EAGAIN 才挂起，因此不会错过边沿
+    registered = loop.Add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, [this](uint32_t events) { OnEvents(events); });
+}
+
+AsyncSocket::~AsyncSocket() {
+    if (registered) {
+        loop->Remove(fd);
+    }
+    if (destroyed != nullptr) {
+        *destroyed = true;
+    }
+}
+
+uint64_t AsyncSocket::Deadline(int timeoutMs) const {
+    if (timeoutMs < 0) {
+        return 0;
+    }
+    return TimerWheel::NowTicks() + TIMER_TICKS(timeoutMs);
+}
+
+// 清空等待槽后恢复协程；协程可能在恢复期间重新挂起到同一个槽
+void AsyncSocket::Resume(std::coroutine_handle<>& slot) {
+    std::coroutine_handle<> handle = slot;
+    slot = nullptr;
+    handle.resume();
+}
+
+void AsyncSocket::OnEvents(uint32_t events) {
+    bool gone = false;
+    destroyed = &gone;
+    if (reader && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        Resume(reader);
+        if (gone) {
+            return;
+        }
+    }
+    if (writer && (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+        Resume(writer);
+        if (gone) {
+            return;
+        }
+    }
+    destroyed = nullptr;
+}
+
+AsyncSocket::ReadyAwaiter AsyncSocket::Readable(int timeoutMs) {
+    return ReadyAwaiter(this, false, Deadline(timeoutMs));
+}
+
+AsyncSocket::ReadyAwaiter AsyncSocket::Writable(int timeoutMs) {
+    return ReadyAwaiter(this, true, Deadline(timeoutMs));
+}
+
+bool AsyncSocket::ReadyAwaiter::await_ready() const noexcept {
+    return !socket->registered;
+}
+
+void AsyncSocket::ReadyAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    (write ? socket->writer : socket->reader) = handle;
+    if (deadline != 0) {
+        TimerWheel& timers = socket->loop->Timers();
+        timers.Schedule(&timer, deadline > timers.Now() ? deadline - timers.Now() : 1);
+    }
+}
+
+bool AsyncSocket::ReadyAwaiter::await_resume() {
+    if (TimerWheel::Pending(&timer)) {
+        socket->loop->Timers().Cancel(&timer);
+    }
+    if (timedOut) {
+        errno = ETIMEDOUT;
+        return false;
+    }
+    if (!socket->registered) {
+        errno = ECANCELED;
+        return false;
+    }
+    return true;
+}
+
+void AsyncSocket::ReadyAwaiter::OnTimeout(void* context) {
+    ReadyAwaiter* awaiter = static_cast<ReadyAwaiter*>(context);
+    awaiter->timedOut = true;
+    AsyncSocket* socket = awaiter->socket;
+    socket->Resume(awaiter->write ? socket->writer : socket->reader);
+}
+
+void AsyncSocket::Detach() {
+    if (registered) {
+        loop->Remove(fd);
+        registered = false;
+    }
+}
+
+void AsyncSocket::Cancel() {
+    Detach();
+    bool gone = false;
+    bool* outer = destroyed;
+    destroyed = &gone;
+    if (reader) {
+        Resume(reader);
+        if (gone) {
+            if (outer != nullptr) {
+                *outer = true;
+            }
+            return;
+        }
+    }
+    if (writer) {
+        Resume(writer);
+        if (gone) {
+            if (outer != nullptr) {
+                *outer = true;
+            }
+            return;
+        }
+    }
+    destroyed = outer;
+}
+
+Task<ssize_t> AsyncSocket::ReadExactly(void* buffer, size_t length, int timeoutMs) {
+    uint64_t deadline = Deadline(timeoutMs);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t len = TRACE_CALL("recv", recv(fd, static_cast<char*>(buffer) + done, length - done, 0));
+        if (len > 0) {
+            done += len;
+            continue;
+        }
+        if (len == 0) {
+            co_return 0;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return -1;
+        }
+        if (!co_await ReadyAwaiter(this, false, deadline)) {
+            co_return -1;
+        }
+    }
+    co_return (ssize_t)length;
+}
+
+Task<ssize_t> AsyncSocket::WriteAll(const void* buffer, size_t length, int timeoutMs) {
+    uint64_t deadline = Deadline(timeoutMs);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t len = TRACE_CALL("send", send(fd, static_cast<const char*>(buffer) + done, length - done, MSG_NOSIGNAL));
+        if (len >= 0) {
+            done += len;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return -1;
+        }
+        if (!co_await ReadyAwaiter(this, true, deadline)) {
+            co_return -1;
+        }
+    }
+    co_return (ssize_t)length;
+}
+
+Task<int> AsyncSocket::Accept(int timeoutMs) {
+    uint64_t deadline = Deadline(timeoutMs);
+    while (true) {
+        int client = TRACE_CALL("accept", accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+        if (client >= 0) {
+            co_return client;
+        }
+        if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return -1;
+        }
+        if (!co_await ReadyAwaiter(this, false, deadline)) {
+            co_return -1;
+        }
+    }
+}
+
+Task<bool> AsyncSocket::Connect(const sockaddr_in& address, int timeoutMs) {
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) == 0) {
+        co_return true;
+    }
+    if (errno != EINPROGRESS) {
+        co_return false;
+    }
+    if (!co_await Writable(timeoutMs)) {
+        co_return false;
+    }
+    int error = 0;
+    socklen_t errorLength = sizeof(error);
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+    if (error != 0) {
+        errno = error;
+        co_return false;
+    }
+    co_return true;
+}
+
+Task<bool> ReadFrame(AsyncSocket& socket, FrameReader& reader, char*& payload, uint32_t& length, uint8_t& flags) {
+    while (!reader.Next(payload, length, flags)) {
+        ssize_t len = reader.Fill(socket.Fd());
+        if (len > 0) {
+            continue;
+        }
+        if (len == 0) {
+            co_return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return false;
+        }
+        if (!co_await socket.Readable()) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
@@ -0,0 +1,78 @@
+// BufferPool
+#include "BufferPool.h"
+#include "Metrics.h"
+#include <cstdlib>
+#include <new>
+
+Slab* BufferPool::Allocate(uint32_t capacity) {
+    size_t size = ((size_t)capacity + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN;
+    char* data = static_cast<char*>(std::aligned_alloc(SLAB_ALIGN, size));
+    if (data == nullptr) {
+        throw std::bad_alloc();
+    }
+    Slab* slab = new Slab;
+    slab->data = data;
+    slab->capacity = (uint32_t)size;
+    slab->used = 0;
+    slab->refs = 0;
+    slab->next = nullptr;
+    return slab;
+}
+
+void BufferPool::Free(Slab* slab) {
+    std::free(slab->data);
+    delete slab;
+}
+
+BufferPool::BufferPool(uint32_t slabSize, int maxFree) {
+    this->slabSize = slabSize;
+    this->maxFree = maxFree;
+    freeCount = 0;
+    freeList = nullptr;
+    borrowedBytes = 0;
+}
+
+BufferPool& BufferPool::ThreadLocal() {
+    static thread_local BufferPool pool(SLAB_SIZE, POOL_SHARED_MAX_FREE_SLABS);
+    return pool;
+}
+
+BufferPool::~BufferPool() {
+    while (freeList) {
+        Slab* next = freeList->next;
+        Free(freeList);
+        freeList = next;
+    }
+}
+
+Slab* BufferPool::Acquire(uint32_t minCapacity) {
+    Slab* slab;
+    if (minCapacity <= slabSize && freeList) {
+        slab = freeList;
+        freeList = slab->next;
+        freeCount--;
+    } else {
+        slab = Allocate(minCapacity > slabSize ? minCapacity : slabSize);
+    }
+    slab->used = 0;
+    slab->refs = 1;
+    slab->next = nullptr;
+    borrowedBytes += slab->capacity;
+    Metrics::Add(METRIC_BUFFER_BYTES, slab->capacity);
+    return slab;
+}
+
+void BufferPool::Release(Slab* slab) {
+    if (--slab->refs > 0) {
+        return;
+    }
+    borrowedBytes -= slab->capacity;
+    Metrics::Add(METRIC_BUFFER_BYTES, -(uint64_t)slab->capacity);
+    if (slab->capacity == slabSize && freeCount < maxFree) {
+        slab->next = freeList;
+        freeList = slab;
+        freeCount++;
+    } else {
+        Free(slab);
+    }
+}
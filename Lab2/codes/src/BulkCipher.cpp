@@ -0,0 +1,182 @@
+// BulkCipher
+#include "BulkCipher.h"
+#include "SHA256.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+
+// 把 [0, length) 按块分给线程池，短输入时在调用线程上按块顺序处理
+static void ForEachChunk(size_t length, const std::function<void(uint32_t, size_t, size_t)>& process) {
+    uint32_t chunks = (uint32_t)((length + BULK_CHUNK_SIZE - 1) / BULK_CHUNK_SIZE);
+    auto run = [&](uint32_t chunk) {
+        size_t offset = (size_t)chunk * BULK_CHUNK_SIZE;
+        process(chunk, offset, length - offset < BULK_CHUNK_SIZE ? length - offset : BULK_CHUNK_SIZE);
+    };
+    if (length < BULK_PARALLEL_THRESHOLD) {
+        for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+            run(chunk);
+        }
+        return;
+    }
+    WorkStealingPool::Instance().ParallelFor(chunks, run);
+}
+
+static inline uint64_t LoadBigEndian64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+static inline void StoreBigEndian64(uint64_t value, uint8_t* out) {
+    for (int i = 7; i >= 0; i--) {
+        out[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+// 按块号顺序把密文送入 MAC。同一时刻只有拿到 busy 的线程在计算，其余线程不等待它：
+// 加密时标记本块就绪后尝试接手，拿不到就离开，持有者释放后会重新检查有没有新就绪的块
+class OrderedMac {
+private:
+    Sha256& mac;
+    const char* data;
+    size_t length;
+    uint32_t chunks;
+    std::unique_ptr<std::atomic<bool>[]> ready;
+    std::atomic<uint32_t> next;             // 下一个要计算的块
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+
+    inline void Absorb(uint32_t chunk) {
+        size_t offset = (size_t)chunk * BULK_CHUNK_SIZE;
+        mac.Update(data + offset, length - offset < BULK_CHUNK_SIZE ? length - offset : BULK_CHUNK_SIZE);
+    }
+
+public:
+    OrderedMac(Sha256& mac, const char* data, size_t length) : mac(mac), data(data), length(length) {
+        chunks = (uint32_t)((length + BULK_CHUNK_SIZE - 1) / BULK_CHUNK_SIZE);
+        ready.reset(new std::atomic<bool>[chunks]);
+        for (uint32_t i = 0; i < chunks; i++) {
+            ready[i] = false;
+        }
+        next = 0;
+    }
+
+    // 加密：chunk 的密文已写好，计算从 next 开始连续就绪的块
+    void Complete(uint32_t chunk) {
+        ready[chunk] = true;
+        while (!busy.test_and_set()) {
+            uint32_t current = next;
+            while (current < chunks && ready[current]) {
+                Absorb(current++);
+            }
+            next = current;
+            busy.clear();
+            // 释放前刚就绪的块，其完成者可能因为 busy 已经离开
+            if (current >= chunks || !ready[current]) {
+                return;
+            }
+        }
+    }
+
+    // 解密：返回时 [0, chunk] 都已计算，可以覆盖 chunk 的密文
+    void Through(uint32_t chunk) {
+        while (next <= chunk) {
+            if (busy.test_and_set()) {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t current = next;
+            while (current <= chunk) {
+                Absorb(current++);
+                next = current;
+            }
+            busy.clear();
+        }
+    }
+};
+
+void BulkCipher::EcbEncrypt(DesOp& des, const char* in, char* out, size_t length, Sha256* mac) {
+    TRACE_SCOPE("BulkCipher::Ecb");
+    std::unique_ptr<OrderedMac> ordered(mac ? new OrderedMac(*mac, out, length) : nullptr);
+    ForEachChunk(length, [&](uint32_t chunk, size_t offset, size_t size) {
+        for (size_t i = offset; i < offset + size; i += BULK_BLOCK_SIZE) {
+            des.EncryptBlock((const uint8_t*)in + i, (uint8_t*)out + i);
+        }
+        if (ordered) {
+            ordered->Complete(chunk);
+        }
+    });
+}
+
+void BulkCipher::EcbDecrypt(DesOp& des, const char* in, char* out, size_t length, Sha256* mac) {
+    TRACE_SCOPE("BulkCipher::Ecb");
+    std::unique_ptr<OrderedMac> ordered(mac ? new OrderedMac(*mac, in, length) : nullptr);
+    ForEachChunk(length, [&](uint32_t chunk, size_t offset, size_t size) {
+        if (ordered) {
+            ordered->Through(chunk);
+        }
+        for (size_t i = offset; i < offset + size; i += BULK_BLOCK_SIZE) {
+            des.DecryptBlock((const uint8_t*)in + i, (uint8_t*)out + i);
+        }
+    });
+}
+
+void BulkCipher::CtrCrypt(DesOp& des, const uint8_t* iv, const char* in, char* out, size_t length) {
+    TRACE_SCOPE("BulkCipher::Ctr");
+    uint64_t base = LoadBigEndian64(iv);
+    // 块大小是分组大小的倍数，只有最后一块可能以不完整的分组结束
+    ForEachChunk(length, [&](uint32_t, size_t offset, size_t size) {
+        uint8_t counter[BULK_BLOCK_SIZE], keyStream[BULK_BLOCK_SIZE];
+        for (size_t i = offset; i < offset + size; i += BULK_BLOCK_SIZE) {
+            StoreBigEndian64(base + i / BULK_BLOCK_SIZE, counter);
+            des.EncryptBlock(counter, keyStream);
+            size_t n = offset + size - i < BULK_BLOCK_SIZE ? offset + size - i : BULK_BLOCK_SIZE;
+            for (size_t j = 0; j < n; j++) {
+                out[i + j] = (char)(in[i + j] ^ keyStream[j]);
+            }
+        }
+    });
+}
+
+void BulkCipher::CbcEncrypt(DesOp& des, const uint8_t* iv, const char* in, char* out, size_t length) {
+    TRACE_SCOPE("BulkCipher::CbcEncrypt");
+    uint8_t chain[BULK_BLOCK_SIZE];
+    memcpy(chain, iv, BULK_BLOCK_SIZE);
+    for (size_t i = 0; i < length; i += BULK_BLOCK_SIZE) {
+        for (int j = 0; j < BULK_BLOCK_SIZE; j++) {
+            chain[j] ^= (uint8_t)in[i + j];
+        }
+        des.EncryptBlock(chain, chain);
+        memcpy(out + i, chain, BULK_BLOCK_SIZE);
+    }
+}
+
+void BulkCipher::CbcDecrypt(DesOp& des, const uint8_t* iv, const char* in, char* out, size_t length) {
+    TRACE_SCOPE("BulkCipher::CbcDecrypt");
+    // 原地解密时，后一块需要的前一块最后一个密文分组可能已被另一个线程覆盖，开始前先把每块的链接值保存下来
+    size_t chunks = (length + BULK_CHUNK_SIZE - 1) / BULK_CHUNK_SIZE;
+    std::vector<uint8_t> chains(chunks * BULK_BLOCK_SIZE);
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        const uint8_t* previous = chunk == 0 ? iv : (const uint8_t*)in + chunk * BULK_CHUNK_SIZE - BULK_BLOCK_SIZE;
+        memcpy(&chains[chunk * BULK_BLOCK_SIZE], previous, BULK_BLOCK_SIZE);
+    }
+    ForEachChunk(length, [&](uint32_t chunk, size_t offset, size_t size) {
+        uint8_t chain[BULK_BLOCK_SIZE], cipherBlock[BULK_BLOCK_SIZE], plainBlock[BULK_BLOCK_SIZE];
+        memcpy(chain, &chains[(size_t)chunk * BULK_BLOCK_SIZE], BULK_BLOCK_SIZE);
+        for (size_t i = offset; i < offset + size; i += BULK_BLOCK_SIZE) {
+            memcpy(cipherBlock, in + i, BULK_BLOCK_SIZE);
+            des.DecryptBlock(cipherBlock, plainBlock);
+            for (int j = 0; j < BULK_BLOCK_SIZE; j++) {
+                out[i + j] = (char)(plainBlock[j] ^ chain[j]);
+            }
+            memcpy(chain, cipherBlock, BULK_BLOCK_SIZE);
+        }
+    });
+}
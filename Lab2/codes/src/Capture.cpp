@@ -0,0 +1,104 @@
+// Capture
+#include "Capture.h"
+#include "Journal.h"
+#include "Metrics.h"
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+CaptureWriter::CaptureWriter() {
+    file = nullptr;
+    last = 0;
+}
+
+CaptureWriter::~CaptureWriter() {
+    Close();
+}
+
+bool CaptureWriter::Open(const std::string& path, const uint8_t* sessionKey, uint64_t features, bool isServer) {
+    // 捕获文件含会话密钥：只允许属主读写，不覆盖已有文件，也不跟随符号链接
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        std::cerr << "Error: Failed to create capture file " << path << "." << std::endl;
+        return false;
+    }
+    file = fdopen(fd, "wb");
+    if (file == nullptr) {
+        close(fd);
+        std::cerr << "Error: Failed to create capture file " << path << "." << std::endl;
+        return false;
+    }
+    setvbuf(file, nullptr, _IOFBF, CAPTURE_BUFFER_SIZE);
+    CaptureHeader header{};
+    header.magic = CAPTURE_MAGIC;
+    header.startTime = JournalNow();
+    header.features = features;
+    memcpy(header.sessionKey, sessionKey, SessionKeyLength(features));
+    header.isServer = isServer ? 1 : 0;
+    fwrite(&header, sizeof(header), 1, file);
+    last = Metrics::NowNanos();
+    return true;
+}
+
+void CaptureWriter::Append(const char* data, uint32_t length) {
+    if (file == nullptr) {
+        return;
+    }
+    uint64_t now = Metrics::NowNanos();
+    uint64_t interval = (now - last) / 1000;
+    last = now;
+    CaptureRecord record = {interval > UINT32_MAX ? UINT32_MAX : (uint32_t)interval, length};
+    fwrite(&record, sizeof(record), 1, file);
+    fwrite(data, 1, length, file);
+}
+
+void CaptureWriter::Close() {
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+CaptureReader::CaptureReader() {
+    header = {};
+    bytes = 0;
+}
+
+bool CaptureReader::Open(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        std::cerr << "Error: Failed to open capture file " << path << "." << std::endl;
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    buffer.resize(size > 0 ? (size_t)size : 0);
+    bool ok = size >= (long)sizeof(CaptureHeader) && fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    fclose(file);
+    if (ok) {
+        memcpy(&header, buffer.data(), sizeof(header));
+    }
+    if (!ok || header.magic != CAPTURE_MAGIC) {
+        std::cerr << "Error: " << path << " is not a capture file." << std::endl;
+        return false;
+    }
+
+    // 会话被中断时最后一条记录可能不完整，只保留完整的记录
+    chunks.clear();
+    bytes = 0;
+    size_t offset = sizeof(CaptureHeader);
+    while (offset + sizeof(CaptureRecord) <= buffer.size()) {
+        CaptureRecord record;
+        memcpy(&record, buffer.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.length > buffer.size() - offset) {
+            break;
+        }
+        chunks.push_back({record.interval, record.length, buffer.data() + offset});
+        bytes += record.length;
+        offset += record.length;
+    }
+    return true;
+}
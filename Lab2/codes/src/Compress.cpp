@@ -0,0 +1,174 @@
+// Compressor
+#include "Compress.h"
+#include <cstring>
+
+static inline uint32_t Read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t HashSequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+// 长度字段超过 15 时按 LZ4 规则追加若干字节（每字节 255，最后一个字节小于 255）
+static inline uint8_t* WriteLength(uint8_t* out, int length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+static inline bool ReadLength(const uint8_t*& in, const uint8_t* end, int& length) {
+    uint8_t byte;
+    do {
+        if (in >= end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool Compressor::LooksCompressible(const char* data, int length) {
+    if (length < COMPRESS_MIN_LENGTH) {
+        return false;
+    }
+    // 等间隔采样；均匀分布时碰撞概率约为 1/256，文本通常在 1/16 以上
+    uint32_t counts[256] = {0};
+    int samples = length < COMPRESS_SAMPLE_SIZE ? length : COMPRESS_SAMPLE_SIZE;
+    int stride = length / samples;
+    for (int i = 0; i < samples; i++) {
+        counts[(uint8_t)data[i * stride]]++;
+    }
+    uint64_t collisions = 0;
+    for (int i = 0; i < 256; i++) {
+        collisions += (uint64_t)counts[i] * counts[i];
+    }
+    // 碰撞概率高于 1/128 视为可压缩
+    return collisions * 128 > (uint64_t)samples * samples;
+}
+
+int Compressor::Compress(const char* source, int length, char* dest, int capacity) {
+    const uint8_t* src = (const uint8_t*)source;
+    uint8_t* out = (uint8_t*)dest;
+    uint8_t* outEnd = out + capacity;
+    int table[1 << COMPRESS_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+
+    int anchor = 0;
+    int position = 0;
+    int matchLimit = length - COMPRESS_LAST_LITERALS;
+    int searchLimit = length - COMPRESS_MF_LIMIT;
+    while (position < searchLimit) {
+        uint32_t sequence = Read32(src + position);
+        uint32_t hash = HashSequence(sequence);
+        int candidate = table[hash];
+        table[hash] = position;
+        if (candidate < 0 || position - candidate > COMPRESS_MAX_OFFSET || Read32(src + candidate) != sequence) {
+            // 连续找不到匹配时逐渐加大步长，不可压缩数据上退化为线性扫描
+            position += 1 + ((position - anchor) >> 6);
+            continue;
+        }
+        while (position > anchor && candidate > 0 && src[position - 1] == src[candidate - 1]) {
+            position--;
+            candidate--;
+        }
+        int matchLength = COMPRESS_MIN_MATCH;
+        while (position + matchLength < matchLimit && src[position + matchLength] == src[candidate + matchLength]) {
+            matchLength++;
+        }
+
+        int literalLength = position - anchor;
+        if (outEnd - out < 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1) {
+            return -1;
+        }
+        uint8_t* token = out++;
+        *token = (uint8_t)((literalLength < 15 ? literalLength : 15) << 4);
+        if (literalLength >= 15) {
+            out = WriteLength(out, literalLength - 15);
+        }
+        memcpy(out, src + anchor, literalLength);
+        out += literalLength;
+        int offset = position - candidate;
+        *out++ = (uint8_t)offset;
+        *out++ = (uint8_t)(offset >> 8);
+        int matchCode = matchLength - COMPRESS_MIN_MATCH;
+        *token |= (uint8_t)(matchCode < 15 ? matchCode : 15);
+        if (matchCode >= 15) {
+            out = WriteLength(out, matchCode - 15);
+        }
+
+        position += matchLength;
+        anchor = position;
+    }
+
+    // 最后一个序列只有字面量
+    int literalLength = length - anchor;
+    if (outEnd - out < 1 + literalLength / 255 + 1 + literalLength) {
+        return -1;
+    }
+    *out++ = (uint8_t)((literalLength < 15 ? literalLength : 15) << 4);
+    if (literalLength >= 15) {
+        out = WriteLength(out, literalLength - 15);
+    }
+    memcpy(out, src + anchor, literalLength);
+    out += literalLength;
+    return (int)(out - (uint8_t*)dest);
+}
+
+int Compressor::Decompress(const char* source, int length, char* dest, int capacity) {
+    const uint8_t* in = (const uint8_t*)source;
+    const uint8_t* inEnd = in + length;
+    uint8_t* out = (uint8_t*)dest;
+    uint8_t* outStart = out;
+    uint8_t* outEnd = out + capacity;
+    while (in < inEnd) {
+        uint8_t token = *in++;
+        int literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLength(in, inEnd, literalLength)) {
+            return -1;
+        }
+        if (literalLength > inEnd - in || literalLength > outEnd - out) {
+            return -1;
+        }
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        if (in == inEnd) {
+            break;
+        }
+
+        if (inEnd - in < 2) {
+            return -1;
+        }
+        int offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out - outStart) {
+            return -1;
+        }
+        int matchLength = token & 15;
+        if (matchLength == 15 && !ReadLength(in, inEnd, matchLength)) {
+            return -1;
+        }
+        matchLength += COMPRESS_MIN_MATCH;
+        if (matchLength > outEnd - out) {
+            return -1;
+        }
+        const uint8_t* match = out - offset;
+        if (offset >= matchLength) {
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        } else {
+            // 重叠复制（如游程），必须逐字节进行
+            for (int i = 0; i < matchLength; i++) {
+                *out++ = *match++;
+            }
+        }
+    }
+    return (int)(out - outStart);
+}
@@ -0,0 +1,164 @@
+// CryptoBatch
+#include "CryptoBatch.h"
+#include "DES_Operation.h"
+#include "DesTables.h"
+#include "Protocol.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+static inline uint64_t LoadBlock(const char* block) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | (uint8_t)block[i];
+    }
+    return value;
+}
+
+static inline void StoreBlock(uint64_t value, char* block) {
+    for (int i = 7; i >= 0; i--) {
+        block[i] = (char)value;
+        value >>= 8;
+    }
+}
+
+CryptoBatch::CryptoBatch() {
+    pendingBlocks = 0;
+    firstQueued = 0;
+    const char* value = getenv(CRYPTO_BATCH_DEADLINE_ENV);
+    deadline = (uint64_t)(value != nullptr ? atoi(value) : CRYPTO_BATCH_DEFAULT_DEADLINE_US) * 1000;
+    DesTables::Instance();
+}
+
+void CryptoBatch::EncryptLanes(const uint64_t* const* laneSchedules, char* const* blocks) {
+    const DesTables& tables = DesTables::Instance();
+    uint32_t left[CRYPTO_BATCH_LANES], right[CRYPTO_BATCH_LANES];
+    for (int lane = 0; lane < CRYPTO_BATCH_LANES; lane++) {
+        uint64_t permuted = tables.InitialPermutation(LoadBlock(blocks[lane]));
+        left[lane] = (uint32_t)(permuted >> 32);
+        right[lane] = (uint32_t)permuted;
+    }
+    tables.Rounds(left, right, laneSchedules);
+    for (int lane = 0; lane < CRYPTO_BATCH_LANES; lane++) {
+        uint64_t output = ((uint64_t)right[lane] << 32) | left[lane];
+        StoreBlock(tables.FinalPermutation(output), blocks[lane]);
+    }
+}
+
+// 同一会话连续登记的帧共用一组子密钥；积累的分组过多或最早的分组等得太久时先把已有的加密掉
+void CryptoBatch::Queue(const Job& job) {
+    uint64_t now = Metrics::NowNanos();
+    if (jobs.empty()) {
+        firstQueued = now;
+    } else if (pendingBlocks + job.blocks > CRYPTO_BATCH_MAX_BLOCKS || now - firstQueued >= deadline) {
+        Flush();
+        firstQueued = now;
+    }
+    jobs.push_back(job);
+    Job& queued = jobs.back();
+    if (jobs.size() > 1 && jobs[jobs.size() - 2].des == job.des) {
+        queued.schedule = jobs[jobs.size() - 2].schedule;
+    } else {
+        queued.schedule = (uint32_t)schedules.size();
+        schedules.resize(schedules.size() + 16);
+        DesTables::Schedule(*job.des, schedules.data() + queued.schedule);
+    }
+    pendingBlocks += job.blocks;
+}
+
+void CryptoBatch::Add(const DesOp& des, char* data, int length) {
+    Job job;
+    job.des = &des;
+    job.data = data;
+    job.blocks = (uint32_t)length / 8;
+    job.mac = nullptr;
+    job.tag = nullptr;
+    Queue(job);
+}
+
+void CryptoBatch::Add(const DesOp& des, char* data, int length, const Hmac& mac, const Sha256& context, char* tag) {
+    Job job;
+    job.des = &des;
+    job.data = data;
+    job.blocks = (uint32_t)length / 8;
+    job.mac = &mac;
+    job.tag = tag;
+    job.context = context;
+    Queue(job);
+}
+
+// 按登记顺序把各帧的分组依次填入通道，凑满 CRYPTO_BATCH_LANES 个就执行一次；
+// 最后不满的一组用一个临时分组补齐，补位的结果丢弃
+void CryptoBatch::Flush() {
+    if (jobs.empty()) {
+        return;
+    }
+    TRACE_SCOPE("CryptoBatch::Flush");
+    const uint64_t* laneSchedules[CRYPTO_BATCH_LANES];
+    char* blocks[CRYPTO_BATCH_LANES];
+    int lanes = 0;
+    for (const Job& job : jobs) {
+        const uint64_t* schedule = schedules.data() + job.schedule;
+        for (uint32_t i = 0; i < job.blocks; i++) {
+            laneSchedules[lanes] = schedule;
+            blocks[lanes] = job.data + 8 * i;
+            if (++lanes == CRYPTO_BATCH_LANES) {
+                EncryptLanes(laneSchedules, blocks);
+                lanes = 0;
+            }
+        }
+    }
+    if (lanes > 0) {
+        char filler[CRYPTO_BATCH_LANES][8] = {};
+        for (int lane = lanes; lane < CRYPTO_BATCH_LANES; lane++) {
+            laneSchedules[lane] = laneSchedules[0];
+            blocks[lane] = filler[lane];
+        }
+        EncryptLanes(laneSchedules, blocks);
+    }
+
+    for (Job& job : jobs) {
+        if (job.mac != nullptr) {
+            job.context.Update(job.data, (size_t)job.blocks * 8);
+            uint8_t tag[SHA256_DIGEST_SIZE];
+            job.mac->Finish(job.context, tag);
+            memcpy(job.tag, tag, FRAME_TAG_LENGTH);
+        }
+    }
+    Metrics::Add(METRIC_CRYPTO_BATCHES);
+    Metrics::Add(METRIC_CRYPTO_BATCH_BLOCKS, pendingBlocks);
+    jobs.clear();
+    schedules.clear();
+    pendingBlocks = 0;
+}
+
+bool CryptoBatch::SelfTest() {
+    std::mt19937_64 random(std::random_device{}());
+    DesOp des[3];
+    for (DesOp& op : des) {
+        char key[8];
+        StoreBlock(random(), key);
+        op.SetKey(key);
+    }
+    // 三个会话交替登记长短不一的帧，覆盖共用子密钥与补位
+    CryptoBatch batch;
+    char data[21][8 * 3];
+    char expected[21][8 * 3];
+    for (int i = 0; i < 21; i++) {
+        int length = 8 * (1 + i % 3);
+        for (int j = 0; j < length; j += 8) {
+            StoreBlock(random(), data[i] + j);
+            des[i / 2 % 3].EncryptBlock((const uint8_t*)data[i] + j, (uint8_t*)expected[i] + j);
+        }
+        batch.Add(des[i / 2 % 3], data[i], length);
+    }
+    batch.Flush();
+    for (int i = 0; i < 21; i++) {
+        if (memcmp(data[i], expected[i], 8 * (1 + i % 3)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,154 @@
+// CryptoTaskQueue / CryptoWorkers
+#include "CryptoWorkers.h"
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+CryptoTaskQueue::CryptoTaskQueue(size_t capacity) : cells(new Cell[capacity]) {
+    mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+        cells[i].task = nullptr;
+    }
+    tail.store(0, std::memory_order_relaxed);
+    head.store(0, std::memory_order_relaxed);
+}
+
+// 槽的序号等于写入位置时可写，等于位置 + 1 时可读；读走后序号推进一圈，留给下一圈的写入者
+bool CryptoTaskQueue::TryPush(CryptoTask* task) {
+    uint64_t position = tail.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        int64_t diff = (int64_t)(cell->sequence.load(std::memory_order_acquire) - position);
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+    cell->task = task;
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+CryptoTask* CryptoTaskQueue::TryPop() {
+    uint64_t position = head.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        int64_t diff = (int64_t)(cell->sequence.load(std::memory_order_acquire) - (position + 1));
+        if (diff == 0) {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return nullptr;
+        } else {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+    CryptoTask* task = cell->task;
+    cell->sequence.store(position + mask + 1, std::memory_order_release);
+    return task;
+}
+
+CryptoWorkers::CryptoWorkers(int count)
+    : jobs(CRYPTO_WORKERS_CAPACITY), completions(CRYPTO_WORKERS_CAPACITY), pending(0) {
+    if (count <= 0) {
+        const char* value = getenv(CRYPTO_WORKERS_ENV);
+        count = value != nullptr ? atoi(value) : CRYPTO_WORKERS_DEFAULT;
+        if (count < 1) {
+            count = 1;
+        }
+    }
+    stopping = false;
+    signaled = false;
+    inFlight = 0;
+    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd < 0) {
+        std::cerr << "Error: Failed to create crypto worker eventfd." << std::endl;
+    }
+    // 工作线程屏蔽所有信号（继承创建时的信号掩码），SIGINT / SIGTERM 只由事件循环线程经 signalfd 处理
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &previous);
+    for (int i = 0; i < count; i++) {
+        threads.emplace_back([this]() { WorkerLoop(); });
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+}
+
+CryptoWorkers::~CryptoWorkers() {
+    stopping = true;
+    pending.release((std::ptrdiff_t)threads.size());
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    while (CryptoTask* task = jobs.TryPop()) {
+        delete task;
+    }
+    while (CryptoTask* task = completions.TryPop()) {
+        delete task;
+    }
+    if (eventFd >= 0) {
+        close(eventFd);
+    }
+}
+
+// 完成队列从空变为非空时才写 eventfd：I/O 线程先清除 signaled 再取完成队列，之后完成的任务会重新写入
+void CryptoWorkers::WorkerLoop() {
+    while (true) {
+        pending.acquire();
+        if (stopping) {
+            return;
+        }
+        CryptoTask* task;
+        while ((task = jobs.TryPop()) == nullptr) {
+            std::this_thread::yield();
+        }
+        task->work();
+        // 在途任务数不超过完成队列的容量，不会一直满
+        while (!completions.TryPush(task)) {
+            std::this_thread::yield();
+        }
+        if (!signaled.exchange(true)) {
+            uint64_t one = 1;
+            ssize_t ret = write(eventFd, &one, sizeof(one));
+            (void)ret;
+        }
+    }
+}
+
+bool CryptoWorkers::Submit(std::function<void()> work, std::function<void()> complete) {
+    if (inFlight >= CRYPTO_WORKERS_CAPACITY) {
+        return false;
+    }
+    CryptoTask* task = new CryptoTask{std::move(work), std::move(complete)};
+    if (!jobs.TryPush(task)) {
+        delete task;
+        return false;
+    }
+    inFlight++;
+    pending.release();
+    return true;
+}
+
+void CryptoWorkers::Complete() {
+    uint64_t count;
+    ssize_t ret = read(eventFd, &count, sizeof(count));
+    (void)ret;
+    signaled = false;
+    while (CryptoTask* task = completions.TryPop()) {
+        inFlight--;
+        task->complete();
+        delete task;
+    }
+}
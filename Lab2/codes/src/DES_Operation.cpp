@@ -1,4 +1,8 @@
 #include "DES_Operation.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "SHA256.h"
+#include "BulkCipher.h"
 #include <random>
 #include <cstdint>
 
@@ -247,6 +251,7 @@ void DesOp::F(uint8_t* R, uint8_t* subKey, uint8_t* result) {
 }
 
 void DesOp::DES(uint8_t* plainText_byte, uint8_t* cipherText_byte, bool isEncrypt) {
+    TRACE_SCOPE("DesOp::DES");
     uint8_t plainText[64], cipherText[64];
     ByteToBit(plainText_byte, plainText, 8);
     ByteToBit(cipherText_byte, cipherText, 8);
@@ -284,9 +289,15 @@ void DesOp::DES(uint8_t* plainText_byte, uint8_t* cipherText_byte, bool isEncryp
 }
 
 void DesOp::Encrypt(char* plainText, int plainTextLength, char*& cipherText, int& cipherTextLength) {
+    cipherText = new char[CipherLength(plainTextLength)];
+    cipherTextLength = EncryptTo(plainText, plainTextLength, cipherText);
+}
+
+int DesOp::EncryptTo(const char* plainText, int plainTextLength, char* cipherText, Sha256* mac) {
+    TRACE_SCOPE("DesOp::Encrypt");
+    MetricTimer timer(METRIC_ENCRYPT_NS);
     int padding = 8 - plainTextLength % 8;
-    cipherTextLength = plainTextLength + padding;
-    cipherText = new char[cipherTextLength];
+    int cipherTextLength = plainTextLength + padding;
     for (int i = 0; i < plainTextLength; i++) {
         cipherText[i] = plainText[i];
     }
@@ -294,6 +305,12 @@ void DesOp::Encrypt(char* plainText, int plainTextLength, char*& cipherText, int
         cipherText[i] = padding;
     }
 
+    // 大缓冲区交给线程池并行加密，MAC 按块顺序随加密一起计算
+    if (cipherTextLength >= BULK_PARALLEL_THRESHOLD) {
+        BulkCipher::EcbEncrypt(*this, cipherText, cipherText, cipherTextLength, mac);
+        return cipherTextLength;
+    }
+
     uint8_t plainTextBlock[8], cipherTextBlock[8];
     for (int i = 0; i < cipherTextLength; i += 8) {
         for (int j = 0; j < 8; j++) {
@@ -303,10 +320,15 @@ void DesOp::Encrypt(char* plainText, int plainTextLength, char*& cipherText, int
         for (int j = 0; j < 8; j++) {
             cipherText[i + j] = cipherTextBlock[j];
         }
+        if (mac) {
+            mac->Update(cipherTextBlock, 8);
+        }
     }
+    return cipherTextLength;
 }
 
 void DesOp::Decrypt(char* cipherText, int cipherTextLength, char*& plainText, int& plainTextLength) {
+    TRACE_SCOPE("DesOp::Decrypt");
     uint8_t plainTextBlock[8], cipherTextBlock[8];
     for (int i = 0; i < cipherTextLength; i += 8) {
         for (int j = 0; j < 8; j++) {
@@ -325,4 +347,70 @@ void DesOp::Decrypt(char* cipherText, int cipherTextLength, char*& plainText, in
         plainText[i] = cipherText[i];
     }
     plainText[plainTextLength] = '\0';
+}
+
+int DesOp::DecryptInPlace(char* cipherText, int cipherTextLength, Sha256* mac) {
+    return DecryptTo(cipherText, cipherTextLength, cipherText, cipherTextLength, mac);
+}
+
+int DesOp::DecryptTo(const char* cipherText, int cipherTextLength, char* plainText, int capacity, Sha256* mac) {
+    if (cipherTextLength <= 0 || cipherTextLength % 8 != 0) {
+        return -1;
+    }
+    TRACE_SCOPE("DesOp::Decrypt");
+    MetricTimer timer(METRIC_DECRYPT_NS);
+    uint8_t plainTextBlock[8], cipherTextBlock[8];
+    int start = 0;
+    // 大缓冲区：并行解密除最后一个分组外的部分，各块解密前按顺序计入 MAC
+    if (cipherTextLength >= BULK_PARALLEL_THRESHOLD) {
+        start = cipherTextLength - 8;
+        if (start > capacity) {
+            return -1;
+        }
+        BulkCipher::EcbDecrypt(*this, cipherText, plainText, start, mac);
+    }
+    for (int i = start; i < cipherTextLength; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            cipherTextBlock[j] = cipherText[i + j];
+        }
+        if (mac) {
+            mac->Update(cipherTextBlock, 8);
+        }
+        DES(cipherTextBlock, plainTextBlock, false);
+        if (i + 8 == cipherTextLength) {
+            break;
+        }
+        if (i + 8 > capacity) {
+            return -1;
+        }
+        for (int j = 0; j < 8; j++) {
+            plainText[i + j] = plainTextBlock[j];
+        }
+    }
+
+    // 最后一个分组只写出填充之前的部分，输出缓冲区无需为填充预留空间
+    int padding = plainTextBlock[7];
+    if (padding < 1 || padding > 8) {
+        return -1;
+    }
+    int plainTextLength = cipherTextLength - padding;
+    if (plainTextLength > capacity) {
+        return -1;
+    }
+    for (int j = 0; j < 8 - padding; j++) {
+        plainText[cipherTextLength - 8 + j] = plainTextBlock[j];
+    }
+    return plainTextLength;
+}
+
+void DesOp::EncryptBlock(const uint8_t* in, uint8_t* out) {
+    uint8_t block[8];
+    Copy(block, (uint8_t*)in, 8);
+    DES(block, out, true);
+}
+
+void DesOp::DecryptBlock(const uint8_t* in, uint8_t* out) {
+    uint8_t block[8];
+    Copy(block, (uint8_t*)in, 8);
+    DES(block, out, false);
 }
\ No newline at end of file
@@ -0,0 +1,464 @@
+// Datagram
+#include "Datagram.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <random>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define DATAGRAM_WORDS (DATAGRAM_REPLAY_WINDOW / 64)
+#define DATAGRAM_ACKS_PER_DATAGRAM (DATAGRAM_MAX_MESSAGE / 8)
+
+static inline void Store64(char* p, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (char)(value >> (56 - i * 8));
+    }
+}
+
+static inline uint64_t Load64(const char* p) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | (uint8_t)p[i];
+    }
+    return value;
+}
+
+// ---- ReplayWindow ----
+
+ReplayWindow::ReplayWindow() {
+    memset(bitmap, 0, sizeof(bitmap));
+    top = 0;
+}
+
+bool ReplayWindow::Check(uint64_t sequence) const {
+    if (sequence >= top) {
+        return true;
+    }
+    // 最旧的一字可能正被复用，只保证 DATAGRAM_REPLAY_WINDOW - 64 位的窗口
+    if (top - 1 - sequence >= DATAGRAM_REPLAY_WINDOW - 64) {
+        return false;
+    }
+    return ((bitmap[(sequence >> 6) % DATAGRAM_WORDS] >> (sequence & 63)) & 1) == 0;
+}
+
+bool ReplayWindow::Seen(uint64_t sequence) const {
+    if (sequence >= top || top - 1 - sequence >= DATAGRAM_REPLAY_WINDOW - 64) {
+        return false;
+    }
+    return ((bitmap[(sequence >> 6) % DATAGRAM_WORDS] >> (sequence & 63)) & 1) != 0;
+}
+
+void ReplayWindow::Update(uint64_t sequence) {
+    if (sequence >= top) {
+        // 窗口前移：新进入窗口的字整字清零
+        uint64_t first = top == 0 ? 0 : ((top - 1) >> 6) + 1;
+        uint64_t last = sequence >> 6;
+        if (top == 0 || last - first + 1 >= DATAGRAM_WORDS) {
+            memset(bitmap, 0, sizeof(bitmap));
+        } else {
+            for (uint64_t word = first; word <= last; word++) {
+                bitmap[word % DATAGRAM_WORDS] = 0;
+            }
+        }
+        top = sequence + 1;
+    }
+    bitmap[(sequence >> 6) % DATAGRAM_WORDS] |= 1ull << (sequence & 63);
+}
+
+void ReplayWindow::Save(HandoffWriter& out) const {
+    out.Put(bitmap, sizeof(bitmap));
+    out.PutU64(top);
+}
+
+bool ReplayWindow::Restore(HandoffReader& in) {
+    in.Get(bitmap, sizeof(bitmap));
+    top = in.GetU64();
+    return in.Ok();
+}
+
+// ---- DatagramSocket ----
+
+DatagramSocket::DatagramSocket() : in(std::make_unique<Batch>()), out(std::make_unique<Batch>()) {
+    fd = -1;
+    in->count = 0;
+    out->count = 0;
+    lossThreshold = 0;
+    lossState = 0;
+    receiveLoss = true;
+}
+
+DatagramSocket::~DatagramSocket() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool DatagramSocket::Open(int port) {
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Error: Failed to create datagram socket." << std::endl;
+        return false;
+    }
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = INADDR_ANY;
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        std::cerr << "Error: Failed to bind datagram socket." << std::endl;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return Adopt(fd);
+}
+
+bool DatagramSocket::Adopt(int fd) {
+    this->fd = fd;
+    // 大量会话的突发数据报需要比默认值更大的收发缓冲区
+    int size = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    const char* loss = getenv(DATAGRAM_LOSS_ENV);
+    if (loss != nullptr && atof(loss) > 0) {
+        double percent = std::min(atof(loss), 100.0);
+        lossThreshold = (uint32_t)(percent / 100.0 * UINT32_MAX);
+        lossState = std::random_device()() | 1;
+        std::cerr << "Simulating " << percent << "% datagram loss in each direction." << std::endl;
+    }
+
+    for (int i = 0; i < DATAGRAM_BATCH; i++) {
+        for (Batch* batch : {in.get(), out.get()}) {
+            batch->vectors[i].iov_base = batch->buffers[i];
+            batch->vectors[i].iov_len = DATAGRAM_MAX_SIZE;
+            memset(&batch->messages[i], 0, sizeof(mmsghdr));
+            batch->messages[i].msg_hdr.msg_name = &batch->addresses[i];
+            batch->messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            batch->messages[i].msg_hdr.msg_iov = &batch->vectors[i];
+            batch->messages[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+    return true;
+}
+
+// xorshift64：只用于丢包模拟
+bool DatagramSocket::Lose() {
+    if (lossThreshold == 0) {
+        return false;
+    }
+    lossState ^= lossState << 13;
+    lossState ^= lossState >> 7;
+    lossState ^= lossState << 17;
+    return (uint32_t)lossState < lossThreshold;
+}
+
+void DatagramSocket::SendLossOnly() {
+    receiveLoss = false;
+    if (lossThreshold != 0) {
+        std::cerr << "Datagram loss is simulated on sent datagrams only." << std::endl;
+    }
+}
+
+int DatagramSocket::Receive() {
+    for (int i = 0; i < DATAGRAM_BATCH; i++) {
+        in->messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+    int count = TRACE_CALL("recvmmsg", recvmmsg(fd, in->messages, DATAGRAM_BATCH, 0, nullptr));
+    if (count <= 0) {
+        return 0;
+    }
+    uint64_t bytes = 0;
+    for (int i = 0; i < count; i++) {
+        bytes += in->messages[i].msg_len;
+        if ((in->messages[i].msg_hdr.msg_flags & MSG_TRUNC) || (receiveLoss && Lose())) {
+            in->messages[i].msg_len = 0;
+        }
+    }
+    Metrics::Add(METRIC_DATAGRAMS_IN, count);
+    Metrics::Add(METRIC_BYTES_IN, bytes);
+    in->count = count;
+    return count;
+}
+
+char* DatagramSocket::Reserve(const sockaddr_in& to) {
+    if (out->count == DATAGRAM_BATCH) {
+        Flush();
+    }
+    out->addresses[out->count] = to;
+    return out->buffers[out->count];
+}
+
+void DatagramSocket::Commit(int length) {
+    if (Lose()) {
+        return;
+    }
+    out->vectors[out->count].iov_len = length;
+    out->count++;
+}
+
+int DatagramSocket::Flush() {
+    int sent = 0;
+    uint64_t bytes = 0;
+    while (sent < out->count) {
+        int n = TRACE_CALL("sendmmsg", sendmmsg(fd, out->messages + sent, out->count - sent, 0));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                break;
+            }
+            // 单个数据报的错误（例如目的地址不可达）不影响批中其余的
+            sent++;
+            continue;
+        }
+        for (int i = sent; i < sent + n; i++) {
+            bytes += out->vectors[i].iov_len;
+        }
+        sent += n;
+    }
+    Metrics::Add(METRIC_DATAGRAMS_OUT, sent);
+    Metrics::Add(METRIC_BYTES_OUT, bytes);
+    out->count = 0;
+    return sent;
+}
+
+// ---- DatagramChannel ----
+
+DatagramChannel::DatagramChannel(SessionCrypto& crypto) : crypto(crypto) {
+    memset(&peer, 0, sizeof(peer));
+    hasPeer = false;
+    sendSequence = 0;
+    outstanding = 0;
+    smoothedRtt = 0;
+    rttVariance = 0;
+    rto = (uint64_t)DATAGRAM_INITIAL_RTO_MS * 1000000;
+    retransmits = 0;
+    abandoned = 0;
+    rejected = 0;
+    TimerWheel::Init(&timer, nullptr, nullptr);
+}
+
+void DatagramChannel::SetPeer(const sockaddr_in& address) {
+    peer = address;
+    hasPeer = true;
+}
+
+void DatagramChannel::Save(HandoffWriter& out) const {
+    out.Put(&peer, sizeof(peer));
+    out.PutU8(hasPeer);
+    out.PutU64(sendSequence);
+    window.Save(out);
+    out.PutU64(unacked.size());
+    for (const DatagramPending& pending : unacked) {
+        out.PutU64(pending.sequence);
+        out.PutU64(pending.sentAt);
+        out.PutU32((uint32_t)pending.retries);
+        out.PutU8(pending.done);
+        out.PutBytes(pending.bytes.data(), pending.bytes.size());
+    }
+    out.PutU64(outstanding);
+    out.PutBytes(acks.data(), acks.size() * sizeof(uint64_t));
+    out.PutU64(smoothedRtt);
+    out.PutU64(rttVariance);
+    out.PutU64(rto);
+    out.PutU64(retransmits);
+    out.PutU64(abandoned);
+    out.PutU64(rejected);
+}
+
+bool DatagramChannel::Restore(HandoffReader& in) {
+    in.Get(&peer, sizeof(peer));
+    hasPeer = in.GetU8() != 0;
+    sendSequence = in.GetU64();
+    window.Restore(in);
+    uint64_t count = in.GetU64();
+    for (uint64_t i = 0; i < count && in.Ok(); i++) {
+        DatagramPending pending;
+        pending.sequence = in.GetU64();
+        pending.sentAt = in.GetU64();
+        pending.retries = (int)in.GetU32();
+        pending.done = in.GetU8() != 0;
+        size_t length;
+        const char* bytes = in.GetBytes(length);
+        pending.bytes.assign(bytes, bytes + length);
+        unacked.push_back(std::move(pending));
+    }
+    outstanding = in.GetU64();
+    size_t length;
+    const char* bytes = in.GetBytes(length);
+    acks.resize(length / sizeof(uint64_t));
+    memcpy(acks.data(), bytes, acks.size() * sizeof(uint64_t));
+    smoothedRtt = in.GetU64();
+    rttVariance = in.GetU64();
+    rto = in.GetU64();
+    retransmits = in.GetU64();
+    abandoned = in.GetU64();
+    rejected = in.GetU64();
+    return in.Ok();
+}
+
+bool DatagramChannel::PeekId(const char* datagram, int length, uint64_t& id) {
+    if (length < DATAGRAM_HEADER_SIZE) {
+        return false;
+    }
+    id = Load64(datagram);
+    return true;
+}
+
+char* DatagramChannel::Seal(DatagramSocket& socket, uint8_t flags, const char* text, int length, int& datagramLength) {
+    char* datagram = socket.Reserve(peer);
+    Store64(datagram, crypto.datagramId);
+    Store64(datagram + 8, sendSequence);
+    datagram[16] = (char)flags;
+    datagramLength = DATAGRAM_HEADER_SIZE +
+                     SealDatagram(crypto, sendSequence, datagram, DATAGRAM_HEADER_SIZE, text, length, datagram + DATAGRAM_HEADER_SIZE);
+    sendSequence++;
+    return datagram;
+}
+
+int DatagramChannel::Send(DatagramSocket& socket, const char* text, int length, bool reliable, uint64_t now) {
+    if (length > DATAGRAM_MAX_MESSAGE || !hasPeer || (reliable && outstanding >= DATAGRAM_MAX_UNACKED)) {
+        return -1;
+    }
+    int datagramLength;
+    uint64_t sequence = sendSequence;
+    char* datagram = Seal(socket, reliable ? DATAGRAM_FLAG_RELIABLE : 0, text, length, datagramLength);
+    // 先保存副本再提交：模拟丢包时缓冲区可能被下一个数据报复用
+    if (reliable) {
+        unacked.push_back({sequence, now, 0, false, std::vector<char>(datagram, datagram + datagramLength)});
+        outstanding++;
+    }
+    socket.Commit(datagramLength);
+    return datagramLength;
+}
+
+DatagramResult DatagramChannel::Receive(char* datagram, int length, const sockaddr_in& from, uint64_t now,
+                                        char*& text, int& textLength, bool& reliable) {
+    if (length < DATAGRAM_HEADER_SIZE) {
+        return DATAGRAM_DROPPED;
+    }
+    uint64_t sequence = Load64(datagram + 8);
+    uint8_t flags = (uint8_t)datagram[16];
+    if (!window.Check(sequence)) {
+        // 位图中有记录的重复：多半是对方没收到确认而重发，再确认一次。未经认证，但伪造的确认只会被对方忽略。
+        // 落在窗口之外的可能从未到达过，确认了就成了无声的丢失，因此不确认，由对方的重试上限报告
+        if ((flags & DATAGRAM_FLAG_RELIABLE) && window.Seen(sequence) && acks.size() < DATAGRAM_MAX_UNACKED) {
+            acks.push_back(sequence);
+        }
+        rejected++;
+        Metrics::Add(METRIC_DATAGRAM_REJECTED);
+        return DATAGRAM_DROPPED;
+    }
+    int plainTextLength = OpenDatagram(crypto, sequence, datagram, DATAGRAM_HEADER_SIZE,
+                                       datagram + DATAGRAM_HEADER_SIZE, length - DATAGRAM_HEADER_SIZE);
+    if (plainTextLength < 0) {
+        rejected++;
+        Metrics::Add(METRIC_DATAGRAM_REJECTED);
+        return DATAGRAM_DROPPED;
+    }
+    window.Update(sequence);
+    // 回复发往最近一个通过认证的数据报的来源，客户端的 NAT 映射变化后仍能送达
+    SetPeer(from);
+
+    if (flags & DATAGRAM_FLAG_ACK) {
+        OnAck(datagram + DATAGRAM_HEADER_SIZE, plainTextLength, now);
+        return DATAGRAM_HANDLED;
+    }
+    reliable = (flags & DATAGRAM_FLAG_RELIABLE) != 0;
+    if (reliable && acks.size() < DATAGRAM_MAX_UNACKED) {
+        acks.push_back(sequence);
+    }
+    text = datagram + DATAGRAM_HEADER_SIZE;
+    textLength = plainTextLength;
+    return DATAGRAM_MESSAGE;
+}
+
+void DatagramChannel::SendAcks(DatagramSocket& socket) {
+    if (!hasPeer) {
+        acks.clear();
+        return;
+    }
+    char body[DATAGRAM_ACKS_PER_DATAGRAM * 8];
+    for (size_t begin = 0; begin < acks.size(); begin += DATAGRAM_ACKS_PER_DATAGRAM) {
+        size_t count = std::min(acks.size() - begin, (size_t)DATAGRAM_ACKS_PER_DATAGRAM);
+        for (size_t i = 0; i < count; i++) {
+            Store64(body + i * 8, acks[begin + i]);
+        }
+        int datagramLength;
+        Seal(socket, DATAGRAM_FLAG_ACK, body, (int)count * 8, datagramLength);
+        socket.Commit(datagramLength);
+    }
+    acks.clear();
+}
+
+// 只用首次发送就被确认的数据报估计往返时间（Karn 算法），RTO 按 RFC 6298 计算
+void DatagramChannel::OnAck(const char* body, int length, uint64_t now) {
+    for (int offset = 0; offset + 8 <= length; offset += 8) {
+        uint64_t sequence = Load64(body + offset);
+        auto it = std::lower_bound(unacked.begin(), unacked.end(), sequence,
+                                   [](const DatagramPending& pending, uint64_t value) { return pending.sequence < value; });
+        if (it == unacked.end() || it->sequence != sequence || it->done) {
+            continue;
+        }
+        it->done = true;
+        outstanding--;
+        if (it->retries == 0) {
+            uint64_t sample = now - it->sentAt;
+            if (smoothedRtt == 0) {
+                smoothedRtt = sample;
+                rttVariance = sample / 2;
+            } else {
+                uint64_t deviation = smoothedRtt > sample ? smoothedRtt - sample : sample - smoothedRtt;
+                rttVariance = (3 * rttVariance + deviation) / 4;
+                smoothedRtt = (7 * smoothedRtt + sample) / 8;
+            }
+            rto = std::clamp(smoothedRtt + 4 * rttVariance, (uint64_t)DATAGRAM_MIN_RTO_MS * 1000000,
+                             (uint64_t)DATAGRAM_MAX_RTO_MS * 1000000);
+        }
+    }
+    while (!unacked.empty() && unacked.front().done) {
+        unacked.pop_front();
+    }
+}
+
+uint64_t DatagramChannel::Retransmit(DatagramSocket& socket, uint64_t now) {
+    uint64_t next = 0;
+    for (DatagramPending& pending : unacked) {
+        if (pending.done) {
+            continue;
+        }
+        // 每次重发后超时加倍
+        uint64_t timeout = std::min(rto << pending.retries, (uint64_t)DATAGRAM_MAX_RTO_MS * 1000000);
+        uint64_t deadline = pending.sentAt + timeout;
+        if (deadline <= now) {
+            if (pending.retries >= DATAGRAM_MAX_RETRIES) {
+                pending.done = true;
+                outstanding--;
+                abandoned++;
+                continue;
+            }
+            char* datagram = socket.Reserve(peer);
+            memcpy(datagram, pending.bytes.data(), pending.bytes.size());
+            socket.Commit((int)pending.bytes.size());
+            pending.retries++;
+            pending.sentAt = now;
+            retransmits++;
+            Metrics::Add(METRIC_DATAGRAM_RETRANSMITS);
+            deadline = now + std::min(rto << pending.retries, (uint64_t)DATAGRAM_MAX_RTO_MS * 1000000);
+        }
+        if (next == 0 || deadline < next) {
+            next = deadline;
+        }
+    }
+    while (!unacked.empty() && unacked.front().done) {
+        unacked.pop_front();
+    }
+    return next == 0 ? 0 : next - now;
+}
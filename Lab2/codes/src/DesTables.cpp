@@ -0,0 +1,64 @@
+// DesTables
+#include "DesTables.h"
+#include "DES_Operation.h"
+
+uint64_t DesTables::Permute(uint64_t in, int inBits, const uint8_t* table, int outBits) {
+    uint64_t out = 0;
+    for (int i = 0; i < outBits; i++) {
+        out = (out << 1) | ((in >> (inBits - table[i])) & 1);
+    }
+    return out;
+}
+
+// 置换是逐位的线性映射，每个字节的每个取值单独置换一次，使用时查表相或即可
+DesTables::DesTables() {
+    for (int box = 0; box < 8; box++) {
+        for (int input = 0; input < 64; input++) {
+            int row = ((input >> 4) & 0x02) | (input & 0x01);
+            int column = (input >> 1) & 0x0F;
+            uint64_t value = (uint64_t)DesOp::S[box][row][column] << (28 - 4 * box);
+            sp[box][input] = (uint32_t)Permute(value, 32, DesOp::P, 32);
+        }
+    }
+    for (int i = 0; i < 8; i++) {
+        for (int value = 0; value < 256; value++) {
+            ip[i][value] = Permute((uint64_t)value << (56 - 8 * i), 64, DesOp::IP, 64);
+            fp[i][value] = Permute((uint64_t)value << (56 - 8 * i), 64, DesOp::IP_INV, 64);
+        }
+    }
+}
+
+const DesTables& DesTables::Instance() {
+    static const DesTables tables;
+    return tables;
+}
+
+static inline uint64_t PackSubKey(uint64_t subKey) {
+    uint64_t packed = 0;
+    for (int i = 0; i < 8; i++) {
+        packed |= ((subKey >> (42 - 6 * i)) & 0x3F) << (8 * i);
+    }
+    return packed;
+}
+
+void DesTables::Schedule(uint64_t key, uint64_t* schedule) {
+    uint32_t c = (uint32_t)Permute(key, 64, DesOp::PC1[0], 28);
+    uint32_t d = (uint32_t)Permute(key, 64, DesOp::PC1[1], 28);
+    for (int round = 0; round < 16; round++) {
+        for (int i = 0; i < DesOp::LS[round]; i++) {
+            c = ((c << 1) | (c >> 27)) & 0x0FFFFFFF;
+            d = ((d << 1) | (d >> 27)) & 0x0FFFFFFF;
+        }
+        schedule[round] = PackSubKey(Permute(((uint64_t)c << 28) | d, 56, DesOp::PC2, 48));
+    }
+}
+
+void DesTables::Schedule(const DesOp& des, uint64_t* schedule) {
+    for (int round = 0; round < 16; round++) {
+        uint64_t subKey = 0;
+        for (int i = 0; i < 6; i++) {
+            subKey = (subKey << 8) | des.subKeys[round][i];
+        }
+        schedule[round] = PackSubKey(subKey);
+    }
+}
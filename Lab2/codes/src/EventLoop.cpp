@@ -0,0 +1,145 @@
+// EventLoop
+#include "EventLoop.h"
+#include <iostream>
+#include <cerrno>
+#include <chrono>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static uint64_t NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+EventLoop::EventLoop() {
+    stopped = false;
+    lastActivity = 0;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        std::cerr << "Error: Failed to create event loop." << std::endl;
+        return;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+}
+
+EventLoop::~EventLoop() {
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+}
+
+bool EventLoop::Add(int fd, uint32_t events, Handler handler) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        return false;
+    }
+    handlers[fd] = std::make_unique<Handler>(std::move(handler));
+    return true;
+}
+
+bool EventLoop::Modify(int fd, uint32_t events) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::Remove(int fd) {
+    auto it = handlers.find(fd);
+    if (it == handlers.end()) {
+        return;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    // 回调可能正在执行（例如在自身回调里注销自己），推迟到本轮分发结束再析构
+    retired.push_back(std::move(it->second));
+    handlers.erase(it);
+}
+
+void EventLoop::DrainWakeup() {
+    uint64_t value;
+    while (read(wakeFd, &value, sizeof(value)) > 0) {
+    }
+}
+
+void EventLoop::SetPoller(Poller poll, Poller park, uint64_t spinNanos) {
+    retiredPoller = std::move(poller);
+    if (poll) {
+        poller = std::make_unique<PollerState>(PollerState{std::move(poll), std::move(park), spinNanos});
+        lastActivity = NowNanos();
+    }
+}
+
+// 先轮询一次；仍在忙轮询窗口内，或登记休眠时发现了新数据，则本轮 epoll_wait 不阻塞
+int EventLoop::PollTimeout(int timeout) {
+    uint64_t now = NowNanos();
+    if (poller->poll()) {
+        lastActivity = now;
+    }
+    if (poller && !stopped && (now - lastActivity < poller->spinNanos || !poller->park())) {
+        return 0;
+    }
+    return timeout;
+}
+
+void EventLoop::Run() {
+    epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    while (!stopped) {
+        int timeout = timers.NextTimeoutMs();
+        if (poller) {
+            timeout = PollTimeout(timeout);
+            if (stopped) {
+                break;
+            }
+        }
+        int n = epoll_wait(epollFd, events, EVENT_LOOP_MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error: epoll_wait() failed." << std::endl;
+            break;
+        }
+        // 被门铃或其他事件唤醒后重新开始忙轮询窗口
+        if (n > 0 && poller) {
+            lastActivity = NowNanos();
+        }
+        // 定时器回调里注销的 fd 可能还在本批事件中，由下面的查找跳过
+        timers.Advance(TimerWheel::NowTicks());
+        for (int i = 0; i < n && !stopped; i++) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                DrainWakeup();
+                continue;
+            }
+            // 同一批事件中前面的回调可能已经注销了这个 fd
+            auto it = handlers.find(fd);
+            if (it != handlers.end()) {
+                Handler& handler = *it->second;
+                handler(events[i].events);
+            }
+        }
+        if (roundEnd) {
+            roundEnd();
+        }
+        retired.clear();
+        retiredPoller.reset();
+    }
+}
+
+void EventLoop::Stop() {
+    stopped = true;
+    uint64_t one = 1;
+    // write() 是异步信号安全的；eventfd 计数溢出之前总能写入
+    ssize_t ret = write(wakeFd, &one, sizeof(one));
+    (void)ret;
+}
@@ -0,0 +1,234 @@
+// FileTransfer
+#include "FileTransfer.h"
+#include "Frame.h"
+#include "Metrics.h"
+#include <iostream>
+#include <cstdlib>
+#include <iomanip>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+static void PrintRate(const char* action, const std::string& name, uint64_t bytes, uint64_t startTime) {
+    double seconds = (Metrics::NowNanos() - startTime) / 1e9;
+    std::cout << action << " " << name << ": " << bytes << " bytes in " << std::fixed << std::setprecision(2)
+              << seconds << " s (" << (seconds > 0 ? bytes / seconds / 1e6 : 0) << " MB/s)." << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+FileSender::FileSender() {
+    fd = -1;
+    map = nullptr;
+    size = 0;
+    offset = 0;
+    readahead = 0;
+    startTime = 0;
+}
+
+FileSender::~FileSender() {
+    Close();
+}
+
+void FileSender::Close() {
+    if (map != nullptr) {
+        munmap(map, size);
+        map = nullptr;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool FileSender::Start(const char* path, SendQueue& queue, SessionCrypto& crypto) {
+    if (Active()) {
+        std::cerr << "Error: A file transfer is already in progress." << std::endl;
+        return false;
+    }
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        std::cerr << "Error: Failed to open file " << path << "." << std::endl;
+        Close();
+        return false;
+    }
+    size = st.st_size;
+    offset = 0;
+    readahead = 0;
+    if (size > 0) {
+        map = (char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            map = nullptr;
+            std::cerr << "Error: Failed to map file " << path << "." << std::endl;
+            Close();
+            return false;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+    }
+
+    const char* slash = strrchr(path, '/');
+    name = slash ? slash + 1 : path;
+    if (name.size() > FILE_MAX_NAME) {
+        name.resize(FILE_MAX_NAME);
+    }
+    char offer[8 + FILE_MAX_NAME];
+    for (int i = 0; i < 8; i++) {
+        offer[i] = (char)(size >> (56 - i * 8));
+    }
+    memcpy(offer + 8, name.data(), name.size());
+    QueueMessage(queue, crypto, offer, 8 + (int)name.size(), FRAME_FLAG_FILE_OFFER);
+    startTime = Metrics::NowNanos();
+    std::cout << "Sending file " << name << " (" << size << " bytes)..." << std::endl;
+    return true;
+}
+
+bool FileSender::Pump(SendQueue& queue, SessionCrypto& crypto, int socketFd) {
+    int queued = 0;
+    while (offset < size && !queue.IsPaused()) {
+        // 提前通知内核预读下一个窗口，磁盘读取与当前窗口的加密并行
+        if (offset + FILE_CHUNK_SIZE > readahead && readahead < size) {
+            uint64_t length = size - readahead < FILE_READAHEAD ? size - readahead : FILE_READAHEAD;
+            madvise(map + readahead, length, MADV_WILLNEED);
+            readahead += length;
+        }
+        int chunk = size - offset < FILE_CHUNK_SIZE ? (int)(size - offset) : FILE_CHUNK_SIZE;
+        queued += QueueMessage(queue, crypto, map + offset, chunk, FRAME_FLAG_FILE_DATA);
+        offset += chunk;
+        // 边加密边发送：已加密的数据先交给内核，网卡传输与后续分组的加密重叠
+        if (queued >= FILE_FLUSH_BATCH) {
+            if (queue.Flush(socketFd) < 0) {
+                return false;
+            }
+            queued = 0;
+        }
+    }
+    return true;
+}
+
+void FileSender::Finish() {
+    if (!Active()) {
+        return;
+    }
+    if (Done()) {
+        PrintRate("Sent file", name, size, startTime);
+    } else {
+        std::cout << "File transfer of " << name << " cancelled after " << offset << " bytes." << std::endl;
+    }
+    Close();
+}
+
+FileReceiver::FileReceiver() {
+    fd = -1;
+    map = nullptr;
+    size = 0;
+    offset = 0;
+    startTime = 0;
+}
+
+FileReceiver::~FileReceiver() {
+    Abort();
+}
+
+void FileReceiver::Close() {
+    if (map != nullptr) {
+        munmap(map, size);
+        map = nullptr;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool FileReceiver::Begin(const char* offer, int length) {
+    Abort();
+    if (length <= 8 || length > 8 + FILE_MAX_NAME) {
+        return false;
+    }
+    uint64_t fileSize = 0;
+    for (int i = 0; i < 8; i++) {
+        fileSize = (fileSize << 8) | (uint8_t)offer[i];
+    }
+    // 只取文件名部分，不允许写到当前目录之外
+    std::string name(offer + 8, length - 8);
+    if (name.find('/') != std::string::npos || name.find('\0') != std::string::npos || name == "." || name == "..") {
+        return false;
+    }
+
+    // 文件长度由对方声明，预分配前先检查配置的上限与磁盘剩余空间
+    const char* limit = getenv(FILE_MAX_SIZE_ENV);
+    uint64_t maxSize = (limit != nullptr ? strtoull(limit, nullptr, 10) : FILE_DEFAULT_MAX_MB) * 1024 * 1024;
+    if (fileSize > maxSize) {
+        std::cerr << "Error: Offered file " << name << " (" << fileSize << " bytes) exceeds the "
+                  << maxSize << "-byte limit." << std::endl;
+        return false;
+    }
+    struct statvfs disk;
+    if (statvfs(".", &disk) == 0 && fileSize > (uint64_t)disk.f_bavail * disk.f_frsize) {
+        std::cerr << "Error: Not enough disk space for offered file " << name << " (" << fileSize << " bytes)." << std::endl;
+        return false;
+    }
+
+    // 不覆盖已有文件，也不跟随符号链接
+    path = FILE_RECEIVED_PREFIX + name;
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Failed to create file " << path << "." << std::endl;
+        return false;
+    }
+    size = fileSize;
+    offset = 0;
+    if (size > 0) {
+        // 一次性分配全部空间，避免边写边扩展文件带来的碎片与元数据更新
+        // 空间不足时在这里失败，而不是之后写映射区时收到 SIGBUS
+        if (posix_fallocate(fd, 0, size) == 0) {
+            map = (char*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        } else {
+            map = (char*)MAP_FAILED;
+        }
+        if (map == MAP_FAILED) {
+            map = nullptr;
+            std::cerr << "Error: Failed to allocate file " << path << "." << std::endl;
+            Abort();
+            return false;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+    }
+    startTime = Metrics::NowNanos();
+    std::cout << "Receiving file " << name << " (" << size << " bytes) into " << path << "..." << std::endl;
+    return true;
+}
+
+bool FileReceiver::Write(SessionCrypto& crypto, char* payload, uint32_t length, uint8_t flags) {
+    if (!Active()) {
+        return false;
+    }
+    uint64_t remaining = size - offset;
+    int capacity = remaining < (uint64_t)FRAME_MAX_PAYLOAD ? (int)remaining : (int)FRAME_MAX_PAYLOAD;
+    int plainTextLength = OpenMessageTo(crypto, payload, length, flags, map + offset, capacity);
+    if (plainTextLength < 0) {
+        return false;
+    }
+    offset += plainTextLength;
+    return true;
+}
+
+void FileReceiver::Finish() {
+    if (!Active()) {
+        return;
+    }
+    PrintRate("Received file", path, size, startTime);
+    Close();
+}
+
+void FileReceiver::Abort() {
+    if (!Active()) {
+        return;
+    }
+    Close();
+    unlink(path.c_str());
+    std::cout << "Incomplete file " << path << " discarded." << std::endl;
+}
@@ -0,0 +1,177 @@
+// FrameReader
+#include "Frame.h"
+#include "Metrics.h"
+#include "SharedMemory.h"
+#include "Trace.h"
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+
+FrameReader::FrameReader(BufferPool& pool) {
+    this->pool = &pool;
+    slab = nullptr;
+    begin = 0;
+    end = 0;
+    shared = nullptr;
+}
+
+FrameReader::~FrameReader() {
+    Release();
+}
+
+void FrameReader::Release() {
+    if (slab) {
+        pool->Release(slab);
+        slab = nullptr;
+    }
+    begin = 0;
+    end = 0;
+}
+
+bool FrameReader::Oversized() const {
+    if (slab == nullptr || end - begin < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    uint8_t flags;
+    return DecodeFrameHeader(slab->data + begin, flags) > FRAME_MAX_LENGTH;
+}
+
+// 为新数据腾出空间，返回写入位置；available 为可写入的字节数。
+// 帧头声明的长度超过上限时返回 nullptr，不按对方给出的长度分配缓冲区
+char* FrameReader::Prepare(uint32_t& available) {
+    if (Oversized()) {
+        available = 0;
+        return nullptr;
+    }
+    if (slab == nullptr) {
+        slab = pool->Acquire(pool->GetSlabSize());
+    }
+    // 已消费的数据前移，给新数据腾出空间
+    if (begin > 0) {
+        memmove(slab->data, slab->data + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+    // 若缓冲区中的半帧比整个缓冲区还大，按头部声明的长度换一块更大的
+    size_t need = FRAME_HEADER_SIZE;
+    if (end >= FRAME_HEADER_SIZE) {
+        uint8_t flags;
+        need += DecodeFrameHeader(slab->data, flags);
+    }
+    if (need > slab->capacity || end == slab->capacity) {
+        Slab* larger = pool->Acquire(need > slab->capacity ? (uint32_t)need : slab->capacity * 2);
+        memcpy(larger->data, slab->data, end);
+        pool->Release(slab);
+        slab = larger;
+    }
+    available = slab->capacity - end;
+    return slab->data + end;
+}
+
+ssize_t FrameReader::Fill(int fd) {
+    if (shared != nullptr && shared->Receiving()) {
+        return FillShared(fd);
+    }
+    uint32_t available;
+    char* dest = Prepare(available);
+    if (dest == nullptr) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    ssize_t len = TRACE_CALL("recv", recv(fd, dest, available, 0));
+    if (len > 0) {
+        end += (uint32_t)len;
+        Metrics::Add(METRIC_BYTES_IN, len);
+    } else if (end == 0) {
+        Release();
+    }
+    return len;
+}
+
+// 环中有数据时只做一次内存拷贝，不进入内核；环空时读掉门铃。对方关闭写方向（共享内存中的标志）后
+// 返回 0；TCP 连接断开而对方没有关闭写方向时视为连接被重置
+ssize_t FrameReader::FillShared(int fd) {
+    bool closed = shared->PeerClosed();
+    const char* source;
+    size_t readable = shared->ReadableRegion(source);
+    if (readable > 0) {
+        size_t copied = Feed(source, readable);
+        if (copied == 0) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        shared->Consume(copied);
+        shared->Wake(fd);
+        Metrics::Add(METRIC_BYTES_IN, copied);
+        return (ssize_t)copied;
+    }
+    if (end == 0) {
+        Release();
+    }
+    if (closed) {
+        shared->SetEndSeen();
+        shared->DrainDoorbells(fd);
+        return 0;
+    }
+    if (shared->DrainDoorbells(fd)) {
+        errno = EAGAIN;
+    }
+    return -1;
+}
+
+size_t FrameReader::Feed(const char* data, size_t length) {
+    uint32_t available;
+    char* dest = Prepare(available);
+    if (dest == nullptr) {
+        return 0;
+    }
+    size_t copied = length < available ? length : available;
+    memcpy(dest, data, copied);
+    end += (uint32_t)copied;
+    return copied;
+}
+
+void FrameReader::Save(HandoffWriter& out) const {
+    out.PutBytes(slab != nullptr ? slab->data + begin : nullptr, end - begin);
+}
+
+bool FrameReader::Restore(HandoffReader& in) {
+    size_t length;
+    const char* data = in.GetBytes(length);
+    while (length > 0) {
+        size_t copied = Feed(data, length);
+        if (copied == 0) {
+            return false;
+        }
+        data += copied;
+        length -= copied;
+    }
+    return in.Ok();
+}
+
+bool FrameReader::Next(char*& payload, uint32_t& length, uint8_t& flags) {
+    while (true) {
+        if (end - begin < FRAME_HEADER_SIZE) {
+            if (begin == end) {
+                Release();
+            }
+            return false;
+        }
+        length = DecodeFrameHeader(slab->data + begin, flags);
+        if (end - begin < FRAME_HEADER_SIZE + length) {
+            return false;
+        }
+        payload = slab->data + begin + FRAME_HEADER_SIZE;
+        begin += FRAME_HEADER_SIZE + length;
+        if (!(flags & FRAME_FLAG_SHARED_MEMORY)) {
+            break;
+        }
+        // 没有协商共享内存的读者（回放抓包）把切换帧当作保活帧跳过
+        if (shared != nullptr && shared->IsOpen()) {
+            shared->StartReceiving();
+            begin = end;
+        }
+    }
+    Metrics::Add(METRIC_FRAMES_IN);
+    return true;
+}
@@ -0,0 +1,273 @@
+// HandoffWriter / HandoffReader
+#include "Handoff.h"
+#include "Trace.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// 交接的第一条消息：之后的消息按顺序携带数据分块与描述符，两者都发完为止
+struct HandoffHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t dataLength;
+    uint64_t fdCount;
+};
+
+void HandoffWriter::Put(const void* source, size_t length) {
+    const char* bytes = static_cast<const char*>(source);
+    data.insert(data.end(), bytes, bytes + length);
+}
+
+void HandoffWriter::PutBytes(const void* source, size_t length) {
+    PutU64(length);
+    Put(source, length);
+}
+
+void HandoffWriter::PutFd(int fd) {
+    PutU32((uint32_t)fds.size());
+    fds.push_back(fd);
+}
+
+// 数据已经发完而描述符还有剩余时，消息载荷只是一个占位字节（SOCK_SEQPACKET 不传空消息的附属数据）
+bool HandoffWriter::Send(int sock) const {
+    HandoffHeader header{HANDOFF_MAGIC, HANDOFF_VERSION, data.size(), fds.size()};
+    if (TRACE_CALL("send", send(sock, &header, sizeof(header), MSG_NOSIGNAL)) != (ssize_t)sizeof(header)) {
+        return false;
+    }
+    size_t sentData = 0, sentFds = 0;
+    while (sentData < data.size() || sentFds < fds.size()) {
+        char pad = 0;
+        size_t length = data.size() - sentData < HANDOFF_CHUNK ? data.size() - sentData : HANDOFF_CHUNK;
+        size_t count = fds.size() - sentFds < HANDOFF_FDS_PER_MESSAGE ? fds.size() - sentFds : HANDOFF_FDS_PER_MESSAGE;
+        iovec iov;
+        iov.iov_base = length > 0 ? const_cast<char*>(data.data() + sentData) : &pad;
+        iov.iov_len = length > 0 ? length : 1;
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOFF_FDS_PER_MESSAGE)];
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (count > 0) {
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+            cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_SOCKET;
+            cm->cmsg_type = SCM_RIGHTS;
+            cm->cmsg_len = CMSG_LEN(sizeof(int) * count);
+            memcpy(CMSG_DATA(cm), fds.data() + sentFds, sizeof(int) * count);
+        }
+        ssize_t len = TRACE_CALL("sendmsg", sendmsg(sock, &msg, MSG_NOSIGNAL));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len != (ssize_t)iov.iov_len) {
+            return false;
+        }
+        sentData += length;
+        sentFds += count;
+    }
+    return true;
+}
+
+HandoffReader::HandoffReader() {
+    position = 0;
+    failed = false;
+}
+
+HandoffReader::~HandoffReader() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool HandoffReader::Receive(int sock) {
+    HandoffHeader header;
+    if (TRACE_CALL("recv", recv(sock, &header, sizeof(header), 0)) != (ssize_t)sizeof(header)) {
+        return false;
+    }
+    if (header.magic != HANDOFF_MAGIC || header.version != HANDOFF_VERSION) {
+        std::cerr << "Error: Hot restart state has version " << header.version << ", expected "
+                  << HANDOFF_VERSION << "." << std::endl;
+        return false;
+    }
+    data.resize(header.dataLength);
+    size_t received = 0;
+    while (received < header.dataLength || fds.size() < header.fdCount) {
+        char pad;
+        iovec iov;
+        iov.iov_base = received < header.dataLength ? data.data() + received : &pad;
+        iov.iov_len = received < header.dataLength ? header.dataLength - received : 1;
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOFF_FDS_PER_MESSAGE)];
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t len = TRACE_CALL("recvmsg", recvmsg(sock, &msg, MSG_CMSG_CLOEXEC));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            return false;
+        }
+        // 先收下附带的描述符，出错时也由析构函数关闭
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+                size_t count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                size_t first = fds.size();
+                fds.resize(first + count);
+                memcpy(fds.data() + first, CMSG_DATA(cm), sizeof(int) * count);
+            }
+        }
+        if (msg.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) {
+            return false;
+        }
+        if (received < header.dataLength) {
+            received += len;
+        }
+    }
+    return fds.size() == header.fdCount;
+}
+
+bool HandoffReader::Get(void* dest, size_t length) {
+    const char* source = Take(length);
+    if (source == nullptr) {
+        memset(dest, 0, length);
+        return false;
+    }
+    memcpy(dest, source, length);
+    return true;
+}
+
+uint8_t HandoffReader::GetU8() {
+    uint8_t value;
+    Get(&value, sizeof(value));
+    return value;
+}
+
+uint32_t HandoffReader::GetU32() {
+    uint32_t value;
+    Get(&value, sizeof(value));
+    return value;
+}
+
+uint64_t HandoffReader::GetU64() {
+    uint64_t value;
+    Get(&value, sizeof(value));
+    return value;
+}
+
+const char* HandoffReader::Take(size_t length) {
+    if (failed || data.size() - position < length) {
+        failed = true;
+        return nullptr;
+    }
+    const char* source = data.data() + position;
+    position += length;
+    return source;
+}
+
+const char* HandoffReader::GetBytes(size_t& length) {
+    length = GetU64();
+    const char* source = Take(length);
+    if (source == nullptr) {
+        length = 0;
+    }
+    return source;
+}
+
+int HandoffReader::TakeFd() {
+    uint32_t index = GetU32();
+    if (failed || index >= fds.size() || fds[index] < 0) {
+        failed = true;
+        return -1;
+    }
+    int fd = fds[index];
+    fds[index] = -1;
+    return fd;
+}
+
+static void SetTimeouts(int sock) {
+    timeval timeout{HANDOFF_TIMEOUT_MS / 1000, (HANDOFF_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static bool FillAddress(const char* path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Hot restart socket path " << path << " is too long." << std::endl;
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    return true;
+}
+
+int HandoffListen(const char* path) {
+    sockaddr_un address;
+    if (!FillAddress(path, address)) {
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        std::cerr << "Error: Failed to create hot restart socket." << std::endl;
+        return -1;
+    }
+    // 旧进程交接后不再删除路径，残留的文件由下一次监听替换
+    unlink(path);
+    if (bind(sock, (sockaddr*)&address, sizeof(address)) < 0 || chmod(path, 0600) < 0 || listen(sock, 1) < 0) {
+        std::cerr << "Error: Failed to listen for hot restart on " << path << "." << std::endl;
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int HandoffAccept(int listenSocket) {
+    int sock = accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sock < 0) {
+        return -1;
+    }
+    ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0 || credentials.uid != geteuid()) {
+        std::cerr << "Error: Rejected hot restart request from another user." << std::endl;
+        close(sock);
+        return -1;
+    }
+    SetTimeouts(sock);
+    return sock;
+}
+
+int HandoffConnect(const char* path) {
+    sockaddr_un address;
+    if (!FillAddress(path, address)) {
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    if (connect(sock, (sockaddr*)&address, sizeof(address)) < 0) {
+        close(sock);
+        return -1;
+    }
+    SetTimeouts(sock);
+    return sock;
+}
+
+bool HandoffSignal(int sock) {
+    uint32_t magic = HANDOFF_MAGIC;
+    return TRACE_CALL("send", send(sock, &magic, sizeof(magic), MSG_NOSIGNAL)) == (ssize_t)sizeof(magic);
+}
+
+bool HandoffWait(int sock) {
+    uint32_t magic = 0;
+    return TRACE_CALL("recv", recv(sock, &magic, sizeof(magic), 0)) == (ssize_t)sizeof(magic) && magic == HANDOFF_MAGIC;
+}
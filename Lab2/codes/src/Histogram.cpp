@@ -0,0 +1,95 @@
+// Histogram
+#include "Histogram.h"
+#include <cstring>
+
+Histogram::Histogram() {
+    Reset();
+}
+
+void Histogram::Reset() {
+    memset(counts, 0, sizeof(counts));
+    total = 0;
+    sum = 0;
+    min = UINT64_MAX;
+    max = 0;
+}
+
+// 小于 SUB_COUNT 的值精确计数；更大的值按最高位所在区间分组，每组取最高的 SUB_BITS 位
+int Histogram::IndexOf(uint64_t value) {
+    if (value < HISTOGRAM_SUB_COUNT) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (HISTOGRAM_SUB_BITS - 1);
+    return HISTOGRAM_SUB_COUNT + (shift - 1) * HISTOGRAM_HALF_COUNT + (int)((value >> shift) - HISTOGRAM_HALF_COUNT);
+}
+
+uint64_t Histogram::ValueAt(int index) {
+    if (index < HISTOGRAM_SUB_COUNT) {
+        return (uint64_t)index;
+    }
+    int shift = (index - HISTOGRAM_SUB_COUNT) / HISTOGRAM_HALF_COUNT + 1;
+    uint64_t sub = (uint64_t)((index - HISTOGRAM_SUB_COUNT) % HISTOGRAM_HALF_COUNT + HISTOGRAM_HALF_COUNT);
+    return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::Record(uint64_t value) {
+    counts[IndexOf(value)]++;
+    total++;
+    sum += value;
+    if (value < min) {
+        min = value;
+    }
+    if (value > max) {
+        max = value;
+    }
+}
+
+void Histogram::Merge(const Histogram& other) {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    if (other.total && other.min < min) {
+        min = other.min;
+    }
+    if (other.max > max) {
+        max = other.max;
+    }
+}
+
+void Histogram::AddBucket(int index, uint64_t count) {
+    if (count == 0) {
+        return;
+    }
+    counts[index] += count;
+    total += count;
+    uint64_t lower = index == 0 ? 0 : ValueAt(index - 1) + 1;
+    uint64_t upper = ValueAt(index);
+    if (lower < min) {
+        min = lower;
+    }
+    if (upper > max) {
+        max = upper;
+    }
+}
+
+uint64_t Histogram::Percentile(double quantile) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(quantile * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t value = ValueAt(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
@@ -0,0 +1,145 @@
+// InputReader
+#include "InputReader.h"
+#include <iostream>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+InputReader::InputReader() {
+    inputFd = -1;
+    notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    spaceFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    finished = false;
+    failed = false;
+    consumerParked = false;
+    producerParked = false;
+}
+
+InputReader::~InputReader() {
+    Stop();
+    for (int fd : {notifyFd, spaceFd, stopFd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool InputReader::Start(int fd) {
+    if (notifyFd < 0 || spaceFd < 0 || stopFd < 0) {
+        std::cerr << "Error: Failed to create input notification." << std::endl;
+        return false;
+    }
+    inputFd = fd;
+    thread = std::thread([this] { Run(); });
+    return true;
+}
+
+void InputReader::Stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(stopFd, &one, sizeof(one)) < 0) {
+        std::cerr << "Error: Failed to stop input thread." << std::endl;
+    }
+    thread.join();
+}
+
+// 等待 fd 可读或收到退出通知，返回 false 表示应退出
+bool InputReader::WaitFor(int fd) {
+    pollfd fds[2] = {{fd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+    while (poll(fds, 2, -1) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return (fds[1].revents & POLLIN) == 0;
+}
+
+// 与 Park 配对：先发布数据再检查消费者是否休眠（两端之间用全屏障保证不会同时错过对方）
+void InputReader::WakeConsumer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerParked.load(std::memory_order_relaxed) && consumerParked.exchange(false)) {
+        uint64_t one = 1;
+        if (write(notifyFd, &one, sizeof(one)) < 0) {
+            failed.store(true, std::memory_order_release);
+        }
+    }
+}
+
+void InputReader::Run() {
+    while (true) {
+        char* data;
+        size_t space = ring.WritableRegion(data);
+        if (space == 0) {
+            // 环满：登记等待，再确认一次后睡到消费者腾出空间
+            producerParked.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ring.WritableRegion(data) == 0 && !WaitFor(spaceFd)) {
+                break;
+            }
+            producerParked.store(false, std::memory_order_relaxed);
+            uint64_t value;
+            while (read(spaceFd, &value, sizeof(value)) > 0) {
+            }
+            continue;
+        }
+        if (!WaitFor(inputFd)) {
+            break;
+        }
+        ssize_t len = read(inputFd, data, space < INPUT_READ_SIZE ? space : INPUT_READ_SIZE);
+        if (len < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            failed.store(true, std::memory_order_release);
+            break;
+        }
+        if (len == 0) {
+            break;
+        }
+        ring.Produce(len);
+        WakeConsumer();
+    }
+    finished.store(true, std::memory_order_release);
+    WakeConsumer();
+}
+
+void InputReader::Consume(size_t length) {
+    ring.Consume(length);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producerParked.load(std::memory_order_relaxed) && producerParked.exchange(false)) {
+        uint64_t one = 1;
+        if (write(spaceFd, &one, sizeof(one)) < 0) {
+            std::cerr << "Error: Failed to wake input thread." << std::endl;
+        }
+    }
+}
+
+void InputReader::ClearNotify() {
+    uint64_t value;
+    while (read(notifyFd, &value, sizeof(value)) > 0) {
+    }
+}
+
+bool InputReader::Park() {
+    consumerParked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const char* data;
+    if (ring.ReadableRegion(data) == 0 && !finished.load(std::memory_order_acquire)) {
+        return true;
+    }
+    // 登记之后生产者又写入了数据：撤销登记（生产者若已抢先撤销，会多一次无害的唤醒）
+    consumerParked.exchange(false);
+    return false;
+}
+
+bool InputReader::AtEnd() {
+    if (!finished.load(std::memory_order_acquire)) {
+        return false;
+    }
+    const char* data;
+    return ring.ReadableRegion(data) == 0;
+}
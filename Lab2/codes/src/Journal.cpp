@@ -0,0 +1,549 @@
+// Journal
+#include "Journal.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+uint64_t JournalNow() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline uint64_t AlignRecord(uint64_t length) {
+    return (length + JOURNAL_ALIGN - 1) & ~(uint64_t)(JOURNAL_ALIGN - 1);
+}
+
+// 按 8 字节处理的乘法散列，只用来识别崩溃时写了一半的记录，不提供抗篡改能力（帧本身已有 MAC）
+static uint32_t RecordChecksum(const char* data, uint32_t length, uint64_t sequence, uint64_t timestamp) {
+    uint64_t hash = (sequence * 0x9E3779B97F4A7C15ull) ^ timestamp ^ length;
+    uint32_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t value;
+        memcpy(&value, data + i, sizeof(value));
+        hash = (hash ^ value) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, length - i);
+    hash = (hash ^ tail) * 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 32;
+    return (uint32_t)hash;
+}
+
+// offset 处是否为序号等于 expected 的完整记录；length 以 acquire 读取，与写入端的 release 配对
+static const JournalRecordHeader* ValidRecord(const char* base, uint64_t limit, uint64_t offset, uint64_t expected) {
+    if (offset + sizeof(JournalRecordHeader) > limit) {
+        return nullptr;
+    }
+    const JournalRecordHeader* header = reinterpret_cast<const JournalRecordHeader*>(base + offset);
+    uint32_t length = __atomic_load_n(&header->length, __ATOMIC_ACQUIRE);
+    if (length == 0 || offset + AlignRecord(sizeof(JournalRecordHeader) + length) > limit || header->sequence != expected) {
+        return nullptr;
+    }
+    const char* data = base + offset + sizeof(JournalRecordHeader);
+    if (RecordChecksum(data, length, header->sequence, header->timestamp) != header->checksum) {
+        return nullptr;
+    }
+    return header;
+}
+
+static inline JournalIndexEntry* IndexEntryAt(char* base, uint64_t size, uint64_t index) {
+    return reinterpret_cast<JournalIndexEntry*>(base + size - (index + 1) * sizeof(JournalIndexEntry));
+}
+
+// 从段尾向前数有效索引项（序号以 acquire 读取，写入端最后写序号）
+static uint64_t CountIndexEntries(const char* base, uint64_t size) {
+    uint64_t count = 0;
+    while ((count + 1) * sizeof(JournalIndexEntry) + sizeof(JournalSegmentHeader) <= size) {
+        const JournalIndexEntry* entry = IndexEntryAt(const_cast<char*>(base), size, count);
+        if (__atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) == 0 || entry->offset >= size) {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+// 列出目录中的段文件，返回 (段号, 路径)
+static std::vector<std::pair<uint64_t, std::string>> ListSegments(const std::string& dir) {
+    std::vector<std::pair<uint64_t, std::string>> result;
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr) {
+        return result;
+    }
+    while (dirent* entry = readdir(handle)) {
+        unsigned long long number;
+        char suffix[8];
+        if (sscanf(entry->d_name, "journal-%llu.%7s", &number, suffix) == 2 && strcmp(suffix, "seg") == 0) {
+            result.emplace_back(number, dir + "/" + entry->d_name);
+        }
+    }
+    closedir(handle);
+    return result;
+}
+
+static bool ReadSegmentHeader(const std::string& path, JournalSegmentHeader& header) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && header.magic == JOURNAL_MAGIC;
+    close(fd);
+    return ok;
+}
+
+Journal::Journal() {
+    nextSegmentNumber = 1;
+    active = nullptr;
+    spare = nullptr;
+    nextSequence = 1;
+    unsyncedBytes = 0;
+    appendedSequence = 0;
+    durableSequence = 0;
+    syncRequested = false;
+    stopping = false;
+}
+
+Journal::~Journal() {
+    Close();
+}
+
+JournalSegment* Journal::CreateSegment() {
+    uint64_t number;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        number = nextSegmentNumber++;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "/journal-%016llu.seg", (unsigned long long)number);
+    auto* segment = new JournalSegment();
+    segment->path = dir + name;
+    segment->fd = open(segment->path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    segment->base = (char*)MAP_FAILED;
+    segment->size = JOURNAL_SEGMENT_SIZE;
+    // 一次性分配整个段，之后写入映射区不会因为扩展文件而触发元数据更新
+    if (segment->fd >= 0 && posix_fallocate(segment->fd, 0, segment->size) == 0) {
+        segment->base = (char*)mmap(nullptr, segment->size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    }
+    if (segment->base == MAP_FAILED) {
+        std::cerr << "Error: Failed to create journal segment " << segment->path << "." << std::endl;
+        if (segment->fd >= 0) {
+            close(segment->fd);
+            unlink(segment->path.c_str());
+        }
+        delete segment;
+        return nullptr;
+    }
+    auto* header = reinterpret_cast<JournalSegmentHeader*>(segment->base);
+    header->magic = JOURNAL_MAGIC;
+    header->firstSequence = 0;
+    header->segmentSize = segment->size;
+    segment->writeOffset = sizeof(JournalSegmentHeader);
+    segment->indexCount = 0;
+    segment->lastIndexedOffset = 0;
+    return segment;
+}
+
+void Journal::CloseSegment(JournalSegment* segment) {
+    munmap(segment->base, segment->size);
+    close(segment->fd);
+    delete segment;
+}
+
+// 扫描最后一个段，找到最后一条完整记录之后的位置继续写入
+bool Journal::Recover(const std::string& path) {
+    auto* segment = new JournalSegment();
+    segment->path = path;
+    segment->fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    struct stat st;
+    if (segment->fd < 0 || fstat(segment->fd, &st) < 0 || (uint64_t)st.st_size <= sizeof(JournalSegmentHeader)) {
+        std::cerr << "Error: Failed to open journal segment " << path << "." << std::endl;
+        if (segment->fd >= 0) {
+            close(segment->fd);
+        }
+        delete segment;
+        return false;
+    }
+    segment->size = st.st_size;
+    segment->base = (char*)mmap(nullptr, segment->size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    if (segment->base == MAP_FAILED) {
+        std::cerr << "Error: Failed to map journal segment " << path << "." << std::endl;
+        close(segment->fd);
+        delete segment;
+        return false;
+    }
+
+    auto* header = reinterpret_cast<JournalSegmentHeader*>(segment->base);
+    uint64_t indexCount = CountIndexEntries(segment->base, segment->size);
+    uint64_t limit = segment->size - indexCount * sizeof(JournalIndexEntry);
+    uint64_t offset = sizeof(JournalSegmentHeader);
+    uint64_t sequence = header->firstSequence;
+    while (const JournalRecordHeader* record = ValidRecord(segment->base, limit, offset, sequence)) {
+        offset += AlignRecord(sizeof(JournalRecordHeader) + record->length);
+        sequence++;
+    }
+    // 丢弃指向未完成记录的索引项，并在写入位置放一个结束标记，读取端不会把残留数据当成记录
+    segment->indexCount = 0;
+    segment->lastIndexedOffset = 0;
+    for (uint64_t i = 0; i < indexCount; i++) {
+        JournalIndexEntry* entry = IndexEntryAt(segment->base, segment->size, i);
+        if (entry->offset < offset) {
+            segment->indexCount = i + 1;
+            segment->lastIndexedOffset = entry->offset;
+        } else {
+            memset(entry, 0, sizeof(*entry));
+        }
+    }
+    if (offset + sizeof(uint32_t) <= segment->size - segment->indexCount * sizeof(JournalIndexEntry)) {
+        memset(segment->base + offset, 0, sizeof(uint32_t));
+    }
+    segment->writeOffset = offset;
+    active = segment;
+    nextSequence = sequence;
+    return true;
+}
+
+bool Journal::Open(const char* path) {
+    if (active != nullptr) {
+        return true;
+    }
+    dir = path;
+    if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+        std::cerr << "Error: Failed to create journal directory " << path << "." << std::endl;
+        return false;
+    }
+
+    // 找到起始序号最大的段；起始序号为 0 的是上次未用上的预备段，直接删除
+    std::string lastPath;
+    uint64_t lastSequence = 0;
+    for (auto& segment : ListSegments(dir)) {
+        nextSegmentNumber = std::max(nextSegmentNumber, segment.first + 1);
+        JournalSegmentHeader header;
+        if (!ReadSegmentHeader(segment.second, header)) {
+            continue;
+        }
+        if (header.firstSequence == 0) {
+            unlink(segment.second.c_str());
+        } else if (header.firstSequence > lastSequence) {
+            lastSequence = header.firstSequence;
+            lastPath = segment.second;
+        }
+    }
+    if (!lastPath.empty()) {
+        if (!Recover(lastPath)) {
+            return false;
+        }
+    } else {
+        active = CreateSegment();
+        if (active == nullptr) {
+            return false;
+        }
+        reinterpret_cast<JournalSegmentHeader*>(active->base)->firstSequence = 1;
+        nextSequence = 1;
+    }
+    appendedSequence = nextSequence - 1;
+    durableSequence = nextSequence - 1;
+    stopping = false;
+    flusher = std::thread(&Journal::FlusherLoop, this);
+    return true;
+}
+
+// 段写满：换上预备段（没有时同步创建），旧段交给后台线程做最后一次同步后关闭
+bool Journal::Rollover() {
+    JournalSegment* next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        next = spare;
+        spare = nullptr;
+    }
+    if (next == nullptr) {
+        next = CreateSegment();
+        if (next == nullptr) {
+            return false;
+        }
+    }
+    reinterpret_cast<JournalSegmentHeader*>(next->base)->firstSequence = nextSequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sealed.push_back(active);
+        active = next;
+    }
+    syncRequested = true;
+    wakeup.notify_one();
+    return true;
+}
+
+uint64_t Journal::Append(const char* prefix, uint32_t prefixLength, const char* data, uint32_t length) {
+    uint32_t total = prefixLength + length;
+    uint64_t recordSize = AlignRecord(sizeof(JournalRecordHeader) + total);
+    if (active == nullptr || total == 0 ||
+        recordSize + sizeof(JournalSegmentHeader) + sizeof(JournalIndexEntry) > JOURNAL_SEGMENT_SIZE) {
+        return 0;
+    }
+
+    JournalSegment* segment = active;
+    bool indexed = segment->indexCount == 0 || segment->writeOffset - segment->lastIndexedOffset >= JOURNAL_INDEX_INTERVAL;
+    uint64_t indexStart = segment->size - (segment->indexCount + (indexed ? 1 : 0)) * sizeof(JournalIndexEntry);
+    if (segment->writeOffset + recordSize > indexStart) {
+        if (!Rollover()) {
+            return 0;
+        }
+        segment = active;
+        indexed = true;
+    }
+
+    uint64_t offset = segment->writeOffset;
+    auto* header = reinterpret_cast<JournalRecordHeader*>(segment->base + offset);
+    char* dst = segment->base + offset + sizeof(JournalRecordHeader);
+    if (prefixLength > 0) {
+        memcpy(dst, prefix, prefixLength);
+    }
+    memcpy(dst + prefixLength, data, length);
+    uint64_t sequence = nextSequence++;
+    uint64_t timestamp = JournalNow();
+    header->sequence = sequence;
+    header->timestamp = timestamp;
+    header->checksum = RecordChecksum(dst, total, sequence, timestamp);
+    // 长度最后写入：并发的读取端看到非 0 长度时记录内容已经完整
+    __atomic_store_n(&header->length, total, __ATOMIC_RELEASE);
+    segment->writeOffset += recordSize;
+
+    if (indexed) {
+        JournalIndexEntry* entry = IndexEntryAt(segment->base, segment->size, segment->indexCount);
+        entry->timestamp = timestamp;
+        entry->offset = offset;
+        __atomic_store_n(&entry->sequence, sequence, __ATOMIC_RELEASE);
+        segment->indexCount++;
+        segment->lastIndexedOffset = offset;
+    }
+
+    appendedSequence.store(sequence, std::memory_order_release);
+    unsyncedBytes += recordSize;
+    if (unsyncedBytes >= JOURNAL_SYNC_BYTES) {
+        unsyncedBytes = 0;
+        syncRequested = true;
+        wakeup.notify_one();
+    }
+    return sequence;
+}
+
+// 组提交：每隔 JOURNAL_SYNC_INTERVAL_MS（或积压超过 JOURNAL_SYNC_BYTES 时）对期间写入的所有记录做一次 fdatasync
+void Journal::FlusherLoop() {
+    while (true) {
+        std::vector<JournalSegment*> closing;
+        int fd;
+        uint64_t sequence;
+        bool needSpare;
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait_for(lock, std::chrono::milliseconds(JOURNAL_SYNC_INTERVAL_MS),
+                            [this] { return stopping || syncRequested.load(); });
+            syncRequested = false;
+            closing.swap(sealed);
+            fd = active->fd;
+            // 在锁内读取：之后换段写入的记录序号一定更大，不会被误认为已落盘
+            sequence = appendedSequence.load(std::memory_order_acquire);
+            needSpare = spare == nullptr;
+            stop = stopping;
+        }
+        for (JournalSegment* segment : closing) {
+            fdatasync(segment->fd);
+            CloseSegment(segment);
+        }
+        if (sequence > durableSequence.load(std::memory_order_relaxed)) {
+            fdatasync(fd);
+            durableSequence.store(sequence, std::memory_order_release);
+        }
+        if (stop) {
+            break;
+        }
+        if (needSpare) {
+            JournalSegment* segment = CreateSegment();
+            std::lock_guard<std::mutex> lock(mutex);
+            spare = segment;
+        }
+    }
+}
+
+void Journal::Close() {
+    if (active == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    flusher.join();
+    for (JournalSegment* segment : sealed) {
+        fdatasync(segment->fd);
+        CloseSegment(segment);
+    }
+    sealed.clear();
+    fdatasync(active->fd);
+    durableSequence = appendedSequence.load();
+    CloseSegment(active);
+    active = nullptr;
+    if (spare != nullptr) {
+        unlink(spare->path.c_str());
+        CloseSegment(spare);
+        spare = nullptr;
+    }
+}
+
+JournalReader::JournalReader() {
+    current = 0;
+    fd = -1;
+    base = nullptr;
+    size = 0;
+    offset = 0;
+    expected = 0;
+}
+
+JournalReader::~JournalReader() {
+    Unmap();
+}
+
+void JournalReader::Unmap() {
+    if (base != nullptr) {
+        munmap(const_cast<char*>(base), size);
+        base = nullptr;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool JournalReader::Open(const char* path) {
+    // 按起始序号排序（段号只反映创建顺序，预备段可能比当前段更早创建）
+    std::vector<std::pair<uint64_t, std::string>> segments;
+    for (auto& segment : ListSegments(path)) {
+        JournalSegmentHeader header;
+        if (ReadSegmentHeader(segment.second, header) && header.firstSequence != 0) {
+            segments.emplace_back(header.firstSequence, segment.second);
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    paths.clear();
+    for (auto& segment : segments) {
+        paths.push_back(segment.second);
+    }
+    return !paths.empty() && MapSegment(0);
+}
+
+bool JournalReader::MapSegment(size_t index) {
+    Unmap();
+    fd = open(paths[index].c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || (uint64_t)st.st_size <= sizeof(JournalSegmentHeader)) {
+        Unmap();
+        return false;
+    }
+    size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        Unmap();
+        return false;
+    }
+    base = (const char*)map;
+    madvise(map, size, MADV_SEQUENTIAL);
+    current = index;
+    offset = sizeof(JournalSegmentHeader);
+    expected = reinterpret_cast<const JournalSegmentHeader*>(base)->firstSequence;
+    return true;
+}
+
+// 段的第一条记录总有索引项，只读段头与段尾即可得到起始序号与时间
+bool JournalReader::ReadSegmentStart(size_t index, uint64_t& sequence, uint64_t& timestamp) {
+    int segmentFd = open(paths[index].c_str(), O_RDONLY | O_CLOEXEC);
+    if (segmentFd < 0) {
+        return false;
+    }
+    JournalSegmentHeader header;
+    JournalIndexEntry entry;
+    struct stat st;
+    bool ok = fstat(segmentFd, &st) == 0 && pread(segmentFd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+              pread(segmentFd, &entry, sizeof(entry), st.st_size - sizeof(entry)) == (ssize_t)sizeof(entry);
+    close(segmentFd);
+    sequence = header.firstSequence;
+    timestamp = entry.sequence != 0 ? entry.timestamp : UINT64_MAX;
+    return ok;
+}
+
+// 先按段起点选段，再在段尾索引上二分，最后从索引项顺序扫描到第一条满足条件的记录
+bool JournalReader::Seek(uint64_t key, bool byTime) {
+    size_t target = 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+        uint64_t sequence, timestamp;
+        if (ReadSegmentStart(i, sequence, timestamp) && (byTime ? timestamp < key : sequence <= key)) {
+            target = i;
+        }
+    }
+    if (paths.empty() || !MapSegment(target)) {
+        return false;
+    }
+    uint64_t low = 0, high = CountIndexEntries(base, size);
+    while (low < high) {
+        uint64_t middle = (low + high) / 2;
+        const JournalIndexEntry* entry = IndexEntryAt(const_cast<char*>(base), size, middle);
+        if (byTime ? entry->timestamp < key : entry->sequence <= key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low > 0) {
+        const JournalIndexEntry* entry = IndexEntryAt(const_cast<char*>(base), size, low - 1);
+        offset = entry->offset;
+        expected = entry->sequence;
+    }
+    JournalRecord record;
+    while (true) {
+        size_t segment = current;
+        uint64_t savedOffset = offset, savedExpected = expected;
+        if (!Next(record)) {
+            return false;
+        }
+        if (byTime ? record.timestamp >= key : record.sequence >= key) {
+            // 退回到这条记录之前，下次 Next 返回它
+            if (segment != current && !MapSegment(segment)) {
+                return false;
+            }
+            offset = savedOffset;
+            expected = savedExpected;
+            return true;
+        }
+    }
+}
+
+bool JournalReader::Next(JournalRecord& record) {
+    while (base != nullptr) {
+        const JournalRecordHeader* header = ValidRecord(base, size, offset, expected);
+        if (header != nullptr) {
+            record.sequence = header->sequence;
+            record.timestamp = header->timestamp;
+            record.length = header->length;
+            record.data = base + offset + sizeof(JournalRecordHeader);
+            offset += AlignRecord(sizeof(JournalRecordHeader) + header->length);
+            expected++;
+            return true;
+        }
+        // 当前段读完：后面还有段时才切换，否则停在原处，之后可以继续读取新追加的记录
+        if (current + 1 >= paths.size() || !MapSegment(current + 1)) {
+            return false;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,134 @@
+// DesKeySearch
+#include "KeySearch.h"
+#include "DES_Operation.h"
+#include <random>
+
+// 第 t 个有效密钥位在 64 位密钥中的位置（按 DES 的编号，0 为首字节最高位）
+static inline int EffectiveBitPosition(int t) {
+    return (7 - t / 7) * 8 + (6 - t % 7);
+}
+
+uint64_t DesKeySearch::BytesToKey(const uint8_t* bytes) {
+    uint64_t key = 0;
+    for (int i = 0; i < 8; i++) {
+        key = (key << 8) | bytes[i];
+    }
+    return key;
+}
+
+void DesKeySearch::KeyToBytes(uint64_t key, uint8_t* bytes) {
+    for (int i = 7; i >= 0; i--) {
+        bytes[i] = (uint8_t)key;
+        key >>= 8;
+    }
+}
+
+uint64_t DesKeySearch::SpreadKeyBits(uint64_t offset) {
+    uint64_t bits = 0;
+    for (int t = 0; t < KEYSEARCH_EFFECTIVE_BITS && offset != 0; t++, offset >>= 1) {
+        if (offset & 1) {
+            bits |= 1ull << (63 - EffectiveBitPosition(t));
+        }
+    }
+    return bits;
+}
+
+DesKeySearch::DesKeySearch() : tables(DesTables::Instance()) {
+    for (int t = 0; t < KEYSEARCH_EFFECTIVE_BITS; t++) {
+        Schedule(SpreadKeyBits(1ull << t), bitSchedules[t]);
+    }
+    plainLeft = plainRight = 0;
+    target = 0;
+}
+
+void DesKeySearch::SetPair(const uint8_t* plainText, const uint8_t* cipherText) {
+    uint64_t permuted = tables.InitialPermutation(BytesToKey(plainText));
+    plainLeft = (uint32_t)(permuted >> 32);
+    plainRight = (uint32_t)permuted;
+    // 末置换是 IP 的逆，对密文做 IP 即得到末轮输出，搜索时省去每个候选密钥的末置换
+    target = tables.InitialPermutation(BytesToKey(cipherText));
+}
+
+void DesKeySearch::Encrypt(const uint64_t (*schedules)[16], uint64_t* out) const {
+    uint32_t left[KEYSEARCH_LANES], right[KEYSEARCH_LANES];
+    const uint64_t* laneSchedules[KEYSEARCH_LANES];
+    for (int lane = 0; lane < KEYSEARCH_LANES; lane++) {
+        left[lane] = plainLeft;
+        right[lane] = plainRight;
+        laneSchedules[lane] = schedules[lane];
+    }
+    tables.Rounds(left, right, laneSchedules);
+    for (int lane = 0; lane < KEYSEARCH_LANES; lane++) {
+        out[lane] = ((uint64_t)right[lane] << 32) | left[lane];
+    }
+}
+
+bool DesKeySearch::SelfTest() const {
+    std::mt19937_64 engine(0x5EED);
+    uint64_t schedules[KEYSEARCH_LANES][16];
+    uint64_t keys[KEYSEARCH_LANES], out[KEYSEARCH_LANES];
+    uint8_t plainText[8], keyBytes[8], expected[8];
+    KeyToBytes(engine(), plainText);
+
+    DesKeySearch probe;
+    probe.SetPair(plainText, plainText);
+    for (int lane = 0; lane < KEYSEARCH_LANES; lane++) {
+        keys[lane] = engine();
+        Schedule(keys[lane], schedules[lane]);
+    }
+    probe.Encrypt(schedules, out);
+    for (int lane = 0; lane < KEYSEARCH_LANES; lane++) {
+        DesOp des;
+        KeyToBytes(keys[lane], keyBytes);
+        des.SetKey((const char*)keyBytes);
+        des.EncryptBlock(plainText, expected);
+        if (tables.InitialPermutation(BytesToKey(expected)) != out[lane]) {
+            return false;
+        }
+    }
+    // 增量编排必须与从头编排一致
+    uint64_t incremental[16], direct[16];
+    Schedule(keys[0], incremental);
+    for (int t = 0; t < KEYSEARCH_EFFECTIVE_BITS; t += 5) {
+        for (int round = 0; round < 16; round++) {
+            incremental[round] ^= bitSchedules[t][round];
+        }
+        keys[0] ^= SpreadKeyBits(1ull << t);
+    }
+    Schedule(keys[0], direct);
+    for (int round = 0; round < 16; round++) {
+        if (incremental[round] != direct[round]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DesKeySearch::Search(uint64_t baseKey, uint64_t first, uint64_t count, std::vector<uint64_t>& found) const {
+    uint64_t schedules[KEYSEARCH_LANES][16];
+    uint64_t out[KEYSEARCH_LANES];
+    const uint64_t* previous = nullptr;
+
+    for (uint64_t index = first; index < first + count; index += KEYSEARCH_LANES) {
+        for (int lane = 0; lane < KEYSEARCH_LANES; lane++) {
+            uint64_t i = index + lane;
+            if (i == first) {
+                Schedule(baseKey ^ SpreadKeyBits(i ^ (i >> 1)), schedules[0]);
+            } else {
+                // 格雷码从 i-1 到 i 只翻转第 ctz(i) 位
+                const uint64_t* delta = bitSchedules[__builtin_ctzll(i)];
+                for (int round = 0; round < 16; round++) {
+                    schedules[lane][round] = previous[round] ^ delta[round];
+                }
+            }
+            previous = schedules[lane];
+        }
+        Encrypt(schedules, out);
+        for (int lane = 0; lane < KEYSEARCH_LANES; lane++) {
+            if (out[lane] == target) {
+                uint64_t i = index + lane;
+                found.push_back(baseKey ^ SpreadKeyBits(i ^ (i >> 1)));
+            }
+        }
+    }
+}
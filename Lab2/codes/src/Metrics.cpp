@@ -0,0 +1,233 @@
+// Metrics
+#include "Metrics.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+std::atomic<MetricShard*> Metrics::shards(nullptr);
+
+static const char* const COUNTER_NAMES[METRIC_COUNTER_COUNT] = {
+    "encchat_bytes_in_total",
+    "encchat_bytes_out_total",
+    "encchat_frames_in_total",
+    "encchat_frames_out_total",
+    "encchat_handshakes_total",
+    "encchat_active_sessions",
+    "encchat_backpressure_events_total",
+    "encchat_backpressure_ns_total",
+    "encchat_compressed_frames_total",
+    "encchat_compress_saved_bytes_total",
+    "encchat_handshake_timeouts_total",
+    "encchat_idle_evictions_total",
+    "encchat_keepalives_total",
+    "encchat_session_bytes",
+    "encchat_buffer_bytes",
+    "encchat_datagrams_in_total",
+    "encchat_datagrams_out_total",
+    "encchat_datagram_retransmits_total",
+    "encchat_datagram_rejected_total",
+    "encchat_shared_memory_wakeups_total",
+    "encchat_handoff_sessions_total",
+    "encchat_crypto_batches_total",
+    "encchat_crypto_batch_blocks_total",
+    "encchat_handshakes_admitted_total",
+    "encchat_handshakes_queued_total",
+    "encchat_handshakes_rejected_total"
+};
+
+static const char* const HISTOGRAM_NAMES[METRIC_HISTOGRAM_COUNT] = {
+    "encchat_encrypt_ns",
+    "encchat_decrypt_ns",
+    "encchat_handshake_ns",
+    "encchat_rsa_keygen_ns"
+};
+
+MetricShard* Metrics::Register() {
+    // 分片在线程退出后仍保留，保证累计值不会回退
+    auto* shard = new MetricShard();
+    MetricShard* head = shards.load(std::memory_order_relaxed);
+    do {
+        shard->next = head;
+    } while (!shards.compare_exchange_weak(head, shard, std::memory_order_release, std::memory_order_relaxed));
+    return shard;
+}
+
+void Metrics::Snapshot(MetricsSnapshot& snapshot) {
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        snapshot.counters[i] = 0;
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        snapshot.histograms[i].Reset();
+    }
+    for (MetricShard* shard = shards.load(std::memory_order_acquire); shard; shard = shard->next) {
+        for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+            snapshot.counters[i] += shard->counters[i].value.load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+            HistogramShard& source = shard->histograms[i];
+            Histogram& target = snapshot.histograms[i];
+            for (int j = 0; j < HISTOGRAM_BUCKETS; j++) {
+                target.AddBucket(j, source.counts[j].load(std::memory_order_relaxed));
+            }
+            target.AddSum(source.sum.load(std::memory_order_relaxed));
+        }
+    }
+}
+
+std::string Metrics::Format() {
+    auto* snapshot = new MetricsSnapshot();
+    Snapshot(*snapshot);
+
+    std::ostringstream out;
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        // 仪表量在各分片上可能为“负”（以补码存储），汇总后按有符号解释
+        if (i == METRIC_ACTIVE_SESSIONS || i == METRIC_SESSION_BYTES || i == METRIC_BUFFER_BYTES) {
+            out << COUNTER_NAMES[i] << " " << (int64_t)snapshot->counters[i] << "\n";
+        } else {
+            out << COUNTER_NAMES[i] << " " << snapshot->counters[i] << "\n";
+        }
+    }
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const Histogram& histogram = snapshot->histograms[i];
+        for (double quantile : quantiles) {
+            out << HISTOGRAM_NAMES[i] << "{quantile=\"" << quantile << "\"} " << histogram.Percentile(quantile) << "\n";
+        }
+        out << HISTOGRAM_NAMES[i] << "_sum " << histogram.Sum() << "\n";
+        out << HISTOGRAM_NAMES[i] << "_count " << histogram.Count() << "\n";
+    }
+    delete snapshot;
+    return out.str();
+}
+
+// 导出线程：Unix socket 上每个连接写一次快照后关闭；另按间隔把快照写入文件（先写临时文件再 rename）
+static std::thread exporterThread;
+static int exporterStopFd = -1;
+
+static void WriteDumpFile(const std::string& path) {
+    std::string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "w");
+    if (file == nullptr) {
+        return;
+    }
+    std::string text = Metrics::Format();
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+    rename(tmpPath.c_str(), path.c_str());
+}
+
+static void ExporterLoop(int listenFd, std::string dumpPath, int intervalMs) {
+    // 进程级信号（SIGINT 等）留给主线程处理
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+    uint64_t nextDump = Metrics::NowNanos() + (uint64_t)intervalMs * 1000000;
+    while (true) {
+        int timeout = -1;
+        if (!dumpPath.empty()) {
+            uint64_t now = Metrics::NowNanos();
+            timeout = now >= nextDump ? 0 : (int)((nextDump - now) / 1000000);
+        }
+        pollfd fds[2];
+        fds[0].fd = exporterStopFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = listenFd;
+        fds[1].events = POLLIN;
+        int ret = poll(fds, listenFd >= 0 ? 2 : 1, timeout);
+        if (ret < 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            break;
+        }
+        if (!dumpPath.empty() && Metrics::NowNanos() >= nextDump) {
+            WriteDumpFile(dumpPath);
+            nextDump += (uint64_t)intervalMs * 1000000;
+        }
+        if (listenFd >= 0 && (fds[1].revents & POLLIN)) {
+            int client = accept(listenFd, nullptr, nullptr);
+            if (client >= 0) {
+                std::string text = Metrics::Format();
+                ssize_t written = send(client, text.data(), text.size(), MSG_NOSIGNAL);
+                (void)written;
+                close(client);
+            }
+        }
+    }
+    if (!dumpPath.empty()) {
+        WriteDumpFile(dumpPath);
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+    }
+}
+
+// 只删除套接字文件：路径配置错误时不能误删普通文件。路径不存在或已删除时返回 true
+static bool RemoveSocketFile(const char* path) {
+    struct stat info;
+    if (lstat(path, &info) < 0) {
+        return errno == ENOENT;
+    }
+    return S_ISSOCK(info.st_mode) && unlink(path) == 0;
+}
+
+void Metrics::StartExporter() {
+    const char* socketPath = getenv(METRICS_SOCKET_ENV);
+    const char* dumpPath = getenv(METRICS_FILE_ENV);
+    const char* interval = getenv(METRICS_INTERVAL_ENV);
+    if ((socketPath == nullptr && dumpPath == nullptr) || exporterThread.joinable()) {
+        return;
+    }
+
+    int listenFd = -1;
+    if (socketPath != nullptr) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+        if (RemoveSocketFile(socketPath)) {
+            listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        }
+        if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+            std::cerr << "Error: Failed to open metrics socket " << socketPath << "." << std::endl;
+            if (listenFd >= 0) {
+                close(listenFd);
+            }
+            listenFd = -1;
+        }
+    }
+    exporterStopFd = eventfd(0, EFD_CLOEXEC);
+    int seconds = interval ? atoi(interval) : METRICS_DEFAULT_INTERVAL;
+    if (seconds <= 0) {
+        seconds = METRICS_DEFAULT_INTERVAL;
+    }
+    exporterThread = std::thread(ExporterLoop, listenFd, std::string(dumpPath ? dumpPath : ""), seconds * 1000);
+}
+
+void Metrics::StopExporter() {
+    if (!exporterThread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t written = write(exporterStopFd, &one, sizeof(one));
+    (void)written;
+    exporterThread.join();
+    close(exporterStopFd);
+    exporterStopFd = -1;
+    const char* socketPath = getenv(METRICS_SOCKET_ENV);
+    if (socketPath != nullptr) {
+        RemoveSocketFile(socketPath);
+    }
+}
@@ -0,0 +1,519 @@
+// Protocol
+#include "Protocol.h"
+#include "Compress.h"
+#include "Frame.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "BulkCipher.h"
+#include "ThreadPool.h"
+#include <iostream>
+#include <cstring>
+#include <random>
+#include <vector>
+
+bool GenerateServerKey(RSA& rsa) {
+    MetricTimer timer(METRIC_RSA_KEYGEN_NS);
+    for (int i = 0; i < RSA_KEYGEN_RETRY; i++) {
+        if (rsa.GenerateKey()) {
+            return true;
+        }
+        if (i < RSA_KEYGEN_RETRY - 1) {
+            std::cerr << "Warning: Failed to generate RSA key. Retrying..." << std::endl;
+        }
+    }
+    return false;
+}
+
+uint64_t SelectFeatures(uint64_t offered, uint64_t requested) {
+    uint64_t features = offered & requested & HANDSHAKE_FEATURES_SUPPORTED;
+    if ((features & HANDSHAKE_FEATURES_CIPHER) == HANDSHAKE_FEATURES_CIPHER) {
+        features &= ~(uint64_t)HANDSHAKE_FEATURE_AES256;
+    }
+    // 数据报的反重放窗口依赖认证过的序号
+    if (!(features & HANDSHAKE_FEATURE_AUTH)) {
+        features &= ~(uint64_t)HANDSHAKE_FEATURE_DATAGRAM;
+    }
+    return features;
+}
+
+int SessionKeyLength(uint64_t features) {
+    if (features & HANDSHAKE_FEATURE_AES128) {
+        return 16;
+    }
+    if (features & HANDSHAKE_FEATURE_AES256) {
+        return 32;
+    }
+    return 8;
+}
+
+void GenerateSessionKey(uint8_t* sessionKey, int keyLength) {
+    std::random_device rd;
+    for (int i = 0; i < keyLength; i += 4) {
+        uint32_t value = rd();
+        for (int j = 0; j < 4 && i + j < keyLength; j++) {
+            sessionKey[i + j] = (uint8_t)(value >> (j * 8));
+        }
+    }
+}
+
+void EncryptSessionKey(const uint8_t* sessionKey, int keyLength, const HandshakeHello& hello, HandshakeKey& out) {
+    TRACE_SCOPE("handshake.encrypt_key");
+    for (int i = 0; i < SESSION_KEY_MAX_LENGTH; i++) {
+        out.sessionKey_enc[i] = i < keyLength ? RSA::Encrypt((uint32_t)sessionKey[i], hello.e, hello.n) : 0;
+    }
+}
+
+void DecryptSessionKey(RSA& rsa, const HandshakeKey& in, int keyLength, uint8_t* sessionKey) {
+    TRACE_SCOPE("handshake.decrypt_key");
+    for (int i = 0; i < keyLength; i++) {
+        sessionKey[i] = (uint8_t)rsa.Decrypt(in.sessionKey_enc[i]);
+    }
+}
+
+// 由会话密钥派生的 64 位标识：SHA256(label || key) 的前 8 字节（大端）
+static uint64_t DeriveSessionId(const char* label, const uint8_t* sessionKey, int keyLength) {
+    size_t labelLength = strlen(label);
+    uint8_t material[64 + SESSION_KEY_MAX_LENGTH];
+    memcpy(material, label, labelLength);
+    memcpy(material + labelLength, sessionKey, keyLength);
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    Sha256::Hash(material, labelLength + keyLength, digest);
+    uint64_t id = 0;
+    for (int i = 0; i < 8; i++) {
+        id = (id << 8) | digest[i];
+    }
+    return id;
+}
+
+void SetupSessionCrypto(SessionCrypto& crypto, const uint8_t* sessionKey, uint64_t features, bool isServer) {
+    int keyLength = SessionKeyLength(features);
+    if (features & HANDSHAKE_FEATURES_CIPHER) {
+        crypto.aes = std::make_unique<AesOp>();
+        crypto.aes->SetKey(sessionKey, keyLength);
+    } else {
+        crypto.aes.reset();
+        crypto.des.SetKey((const char*)sessionKey);
+    }
+    crypto.authenticated = (features & HANDSHAKE_FEATURE_AUTH) != 0;
+    crypto.compressed = (features & HANDSHAKE_FEATURE_COMPRESS) != 0;
+    crypto.sendSequence = 0;
+    crypto.recvSequence = 0;
+    crypto.sendDirection = isServer ? 'S' : 'C';
+    crypto.recvDirection = isServer ? 'C' : 'S';
+    // GCM 自带认证，只有 DES 需要单独的 MAC 密钥
+    if (crypto.authenticated && !crypto.aes) {
+        uint8_t material[sizeof(MAC_KEY_LABEL) - 1 + SESSION_KEY_MAX_LENGTH];
+        memcpy(material, MAC_KEY_LABEL, sizeof(MAC_KEY_LABEL) - 1);
+        memcpy(material + sizeof(MAC_KEY_LABEL) - 1, sessionKey, keyLength);
+        uint8_t macKey[SHA256_DIGEST_SIZE];
+        Sha256::Hash(material, sizeof(MAC_KEY_LABEL) - 1 + keyLength, macKey);
+        crypto.mac.SetKey(macKey, sizeof(macKey));
+    }
+    crypto.datagramId = (features & HANDSHAKE_FEATURE_DATAGRAM) ? DeriveSessionId(DATAGRAM_ID_LABEL, sessionKey, keyLength) : 0;
+    crypto.sharedMemoryId = (features & HANDSHAKE_FEATURE_SHARED_MEMORY)
+        ? DeriveSessionId(SHARED_MEMORY_ID_LABEL, sessionKey, keyLength) : 0;
+}
+
+void SaveSessionCrypto(HandoffWriter& out, SessionCrypto& crypto) {
+    uint64_t features = 0;
+    uint8_t sessionKey[SESSION_KEY_MAX_LENGTH];
+    if (crypto.aes) {
+        features |= crypto.aes->KeyLength() == 32 ? HANDSHAKE_FEATURE_AES256 : HANDSHAKE_FEATURE_AES128;
+        crypto.aes->GetKey(sessionKey);
+    } else {
+        uint8_t* key = crypto.des.GetKey();
+        memcpy(sessionKey, key, 8);
+        delete[] key;
+    }
+    features |= crypto.authenticated ? HANDSHAKE_FEATURE_AUTH : 0;
+    features |= crypto.compressed ? HANDSHAKE_FEATURE_COMPRESS : 0;
+    features |= crypto.datagramId != 0 ? HANDSHAKE_FEATURE_DATAGRAM : 0;
+    features |= crypto.sharedMemoryId != 0 ? HANDSHAKE_FEATURE_SHARED_MEMORY : 0;
+    out.PutU64(features);
+    out.Put(sessionKey, SessionKeyLength(features));
+    out.PutU64(crypto.sendSequence);
+    out.PutU64(crypto.recvSequence);
+}
+
+bool RestoreSessionCrypto(HandoffReader& in, SessionCrypto& crypto, bool isServer) {
+    uint64_t features = in.GetU64();
+    const char* sessionKey = in.Take(SessionKeyLength(features));
+    if (sessionKey == nullptr) {
+        return false;
+    }
+    SetupSessionCrypto(crypto, reinterpret_cast<const uint8_t*>(sessionKey), features, isServer);
+    crypto.sendSequence = in.GetU64();
+    crypto.recvSequence = in.GetU64();
+    return in.Ok();
+}
+
+const char* SessionCipherName(const SessionCrypto& crypto) {
+    if (!crypto.aes) {
+        return crypto.authenticated ? "DES + HMAC-SHA256" : "DES";
+    }
+    if (crypto.aes->KeyLength() == 32) {
+        return crypto.authenticated ? "AES-256-GCM" : "AES-256-CTR";
+    }
+    return crypto.authenticated ? "AES-128-GCM" : "AES-128-CTR";
+}
+
+// AES 会话每一帧都占用一个序号（CTR 与 GCM 都不能重用 nonce），DES 会话只有认证时才需要
+static inline bool Sequenced(const SessionCrypto& crypto) {
+    return crypto.authenticated || crypto.aes;
+}
+
+// AES 帧的 nonce：方向字节 || 3 字节 0 || 序号（8 字节大端），两个方向的 nonce 不会重合
+static void FrameNonce(uint8_t* nonce, uint8_t direction, uint64_t sequence) {
+    nonce[0] = direction;
+    nonce[1] = nonce[2] = nonce[3] = 0;
+    for (int i = 0; i < 8; i++) {
+        nonce[4 + i] = (uint8_t)(sequence >> (56 - i * 8));
+    }
+}
+
+// MAC 输入：序号（8 字节大端）|| 方向 || 附加数据（帧头或数据报头）|| 密文
+static Sha256 BeginMac(const SessionCrypto& crypto, uint64_t sequence, uint8_t direction, const char* aad, int aadLength) {
+    uint8_t prefix[8 + 1];
+    for (int i = 0; i < 8; i++) {
+        prefix[i] = (uint8_t)(sequence >> (56 - i * 8));
+    }
+    prefix[8] = direction;
+    Sha256 context = crypto.mac.Begin();
+    context.Update(prefix, sizeof(prefix));
+    context.Update(aad, aadLength);
+    return context;
+}
+
+// 认证加密 text 到 out（密文之后接 FRAME_TAG_LENGTH 字节标签），返回载荷长度。
+// AES 为 GCM，nonce 由方向与序号组成；DES 为与加密融合的 HMAC-SHA256
+static int SealAuthenticated(SessionCrypto& crypto, uint64_t sequence, uint8_t direction,
+                             const char* aad, int aadLength, const char* text, int length, char* out) {
+    if (crypto.aes) {
+        TRACE_SCOPE("AesOp::Seal");
+        MetricTimer timer(METRIC_ENCRYPT_NS);
+        uint8_t nonce[AES_GCM_NONCE_SIZE];
+        FrameNonce(nonce, direction, sequence);
+        crypto.aes->GcmSeal(nonce, (const uint8_t*)aad, aadLength, text, out, length, (uint8_t*)out + length);
+        return length + FRAME_TAG_LENGTH;
+    }
+    Sha256 context = BeginMac(crypto, sequence, direction, aad, aadLength);
+    int cipherTextLength = crypto.des.EncryptTo(text, length, out, &context);
+    uint8_t tag[SHA256_DIGEST_SIZE];
+    crypto.mac.Finish(context, tag);
+    memcpy(out + cipherTextLength, tag, FRAME_TAG_LENGTH);
+    return cipherTextLength + FRAME_TAG_LENGTH;
+}
+
+// 校验并解密认证载荷到 dest（可与 payload 相同），返回明文长度，-1 表示格式非法或认证失败
+static int OpenAuthenticated(SessionCrypto& crypto, uint64_t sequence, uint8_t direction, const char* aad, int aadLength,
+                             const char* payload, int length, char* dest, int capacity) {
+    int cipherTextLength = length - FRAME_TAG_LENGTH;
+    if (crypto.aes) {
+        TRACE_SCOPE("AesOp::Open");
+        MetricTimer timer(METRIC_DECRYPT_NS);
+        if (cipherTextLength < 0 || cipherTextLength > capacity) {
+            return -1;
+        }
+        uint8_t nonce[AES_GCM_NONCE_SIZE];
+        FrameNonce(nonce, direction, sequence);
+        if (!crypto.aes->GcmOpen(nonce, (const uint8_t*)aad, aadLength, payload, dest, cipherTextLength,
+                                 (const uint8_t*)payload + cipherTextLength)) {
+            return -1;
+        }
+        return cipherTextLength;
+    }
+
+    // 校验与解密融合：每个密文分组先送入 MAC 再原地解密，只遍历数据一次
+    if (cipherTextLength <= 0 || cipherTextLength % 8 != 0) {
+        return -1;
+    }
+    Sha256 context = BeginMac(crypto, sequence, direction, aad, aadLength);
+    int plainTextLength = crypto.des.DecryptTo(payload, cipherTextLength, dest, capacity, &context);
+    uint8_t tag[SHA256_DIGEST_SIZE];
+    crypto.mac.Finish(context, tag);
+
+    // 常数时间比较
+    uint8_t diff = 0;
+    for (int i = 0; i < FRAME_TAG_LENGTH; i++) {
+        diff |= tag[i] ^ (uint8_t)payload[cipherTextLength + i];
+    }
+    // 先认证后判断填充，避免对未认证数据暴露填充是否合法
+    if (diff != 0 || plainTextLength < 0) {
+        return -1;
+    }
+    return plainTextLength;
+}
+
+// 压缩到 dest（前 COMPRESSED_HEADER_SIZE 字节为大端原始长度），返回压缩帧的载荷长度；
+// 看起来不可压缩或压缩后不更短时返回 0，仍按原文发送
+static int CompressMessage(const char* text, int length, char* dest, int capacity) {
+    if (!Compressor::LooksCompressible(text, length)) {
+        return 0;
+    }
+    TRACE_SCOPE("compress");
+    int compressedLength = Compressor::Compress(text, length, dest + COMPRESSED_HEADER_SIZE,
+                                                capacity - COMPRESSED_HEADER_SIZE);
+    if (compressedLength <= 0 || COMPRESSED_HEADER_SIZE + compressedLength >= length) {
+        return 0;
+    }
+    for (int i = 0; i < COMPRESSED_HEADER_SIZE; i++) {
+        dest[i] = (char)(length >> (24 - i * 8));
+    }
+    Metrics::Add(METRIC_COMPRESSED_FRAMES);
+    Metrics::Add(METRIC_COMPRESS_SAVED_BYTES, length - COMPRESSED_HEADER_SIZE - compressedLength);
+    return COMPRESSED_HEADER_SIZE + compressedLength;
+}
+
+// 加密已写好帧头的一帧；启用认证时 MAC 在加密的同一遍中计算（AES 为 GCM，帧头作为附加数据）。
+// 只读取会话密码状态，批量发送时不同的帧可以在不同线程上同时处理
+static void SealFrame(SessionCrypto& crypto, char* frame, const char* text, int length, uint64_t sequence) {
+    char* cipherText = frame + FRAME_HEADER_SIZE;
+    if (crypto.authenticated) {
+        SealAuthenticated(crypto, sequence, crypto.sendDirection, frame, FRAME_HEADER_SIZE, text, length, cipherText);
+    } else if (crypto.aes) {
+        TRACE_SCOPE("AesOp::Seal");
+        MetricTimer timer(METRIC_ENCRYPT_NS);
+        uint8_t nonce[AES_GCM_NONCE_SIZE];
+        FrameNonce(nonce, crypto.sendDirection, sequence);
+        crypto.aes->CtrCrypt(nonce, text, cipherText, length);
+    } else {
+        crypto.des.EncryptTo(text, length, cipherText);
+    }
+}
+
+// 只写好填充后的明文，DES 加密与 MAC 登记到 batch 中，由 batch.Flush() 完成
+static void DeferFrame(CryptoBatch& batch, SessionCrypto& crypto, char* frame, const char* text, int length, uint64_t sequence) {
+    char* cipherText = frame + FRAME_HEADER_SIZE;
+    int cipherTextLength = DesOp::CipherLength(length);
+    memcpy(cipherText, text, length);
+    memset(cipherText + length, cipherTextLength - length, cipherTextLength - length);
+    if (crypto.authenticated) {
+        batch.Add(crypto.des, cipherText, cipherTextLength, crypto.mac,
+                  BeginMac(crypto, sequence, crypto.sendDirection, frame, FRAME_HEADER_SIZE), cipherText + cipherTextLength);
+    } else {
+        batch.Add(crypto.des, cipherText, cipherTextLength);
+    }
+}
+
+// 为一帧预留发送队列空间并写好帧头，返回帧的总字节数
+static int ReserveFrame(SendQueue& queue, SessionCrypto& crypto, int length, uint8_t flags, char*& frame) {
+    int payloadLength = SealedLength(crypto, length);
+    frame = queue.Reserve(FRAME_HEADER_SIZE + payloadLength);
+    EncodeFrameHeader(frame, payloadLength, crypto.authenticated ? flags | FRAME_FLAG_AUTH : flags);
+    return FRAME_HEADER_SIZE + payloadLength;
+}
+
+int QueueMessage(SendQueue& queue, SessionCrypto& crypto, const char* text, int length, uint8_t flags,
+                 CryptoBatch* batch) {
+    // 压缩到线程本地缓冲区
+    if (crypto.compressed) {
+        static thread_local std::vector<char> scratch;
+        scratch.resize(COMPRESSED_HEADER_SIZE + Compressor::Bound(length));
+        int compressedLength = CompressMessage(text, length, scratch.data(), (int)scratch.size());
+        if (compressedLength > 0) {
+            text = scratch.data();
+            length = compressedLength;
+            flags |= FRAME_FLAG_COMPRESSED;
+        }
+    }
+
+    // 对方只接受不超过 FRAME_MAX_LENGTH 的帧，更长的消息不能发出
+    if (SealedLength(crypto, length) > (int)FRAME_MAX_LENGTH) {
+        return -1;
+    }
+    char* frame;
+    int frameLength = ReserveFrame(queue, crypto, length, flags, frame);
+    if (batch != nullptr && !crypto.aes && length < BULK_PARALLEL_THRESHOLD) {
+        DeferFrame(*batch, crypto, frame, text, length, crypto.sendSequence);
+    } else {
+        SealFrame(crypto, frame, text, length, crypto.sendSequence);
+    }
+    if (Sequenced(crypto)) {
+        crypto.sendSequence++;
+    }
+    queue.Commit(frameLength);
+    Metrics::Add(METRIC_FRAMES_OUT);
+    return frameLength;
+}
+
+// 批量发送中一帧的加密工作
+struct FrameJob {
+    const char* text;
+    int length;
+    char* frame;
+    int frameLength;
+    uint64_t sequence;
+};
+
+int QueueMessages(SendQueue& queue, SessionCrypto& crypto, const MessageSpan* messages, int count, uint8_t flags) {
+    if (count == 1) {
+        return QueueMessage(queue, crypto, messages[0].text, messages[0].length, flags);
+    }
+    TRACE_SCOPE("QueueMessages");
+    static thread_local std::vector<FrameJob> jobs;
+    static thread_local std::vector<char> compressed;
+    jobs.resize(count);
+
+    // 第一遍（串行）：压缩、按顺序预留帧并分配 MAC 序号。帧预留后立即提交，
+    // 加密在 Flush 之前完成即可，slab 中的位置不会变化
+    if (crypto.compressed) {
+        size_t bound = 0;
+        for (int i = 0; i < count; i++) {
+            bound += COMPRESSED_HEADER_SIZE + Compressor::Bound(messages[i].length);
+        }
+        if (compressed.size() < bound) {
+            compressed.resize(bound);
+        }
+    }
+    size_t compressedUsed = 0;
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        FrameJob& job = jobs[i];
+        job.text = messages[i].text;
+        job.length = messages[i].length;
+        uint8_t frameFlags = flags;
+        if (crypto.compressed) {
+            char* dest = compressed.data() + compressedUsed;
+            int compressedLength = CompressMessage(job.text, job.length, dest,
+                                                   COMPRESSED_HEADER_SIZE + Compressor::Bound(job.length));
+            if (compressedLength > 0) {
+                job.text = dest;
+                job.length = compressedLength;
+                frameFlags |= FRAME_FLAG_COMPRESSED;
+                compressedUsed += compressedLength;
+            }
+        }
+        job.frameLength = ReserveFrame(queue, crypto, job.length, frameFlags, job.frame);
+        job.sequence = Sequenced(crypto) ? crypto.sendSequence++ : 0;
+        queue.Commit(job.frameLength);
+        total += job.frameLength;
+    }
+
+    // 第二遍：各帧相互独立。合计够大时把相邻的帧按约 BULK_CHUNK_SIZE 字节分组交给线程池，
+    // 许多短消息也能一起并行加密；单个大帧在自己的组里仍走 EncryptTo 的分块路径
+    WorkStealingPool& pool = WorkStealingPool::Instance();
+    if (total < BULK_PARALLEL_THRESHOLD || pool.Concurrency() == 1) {
+        for (int i = 0; i < count; i++) {
+            SealFrame(crypto, jobs[i].frame, jobs[i].text, jobs[i].length, jobs[i].sequence);
+        }
+    } else {
+        static thread_local std::vector<int> groups;
+        groups.clear();
+        int groupBytes = 0;
+        for (int i = 0; i < count; i++) {
+            if (groupBytes == 0) {
+                groups.push_back(i);
+            }
+            groupBytes += jobs[i].frameLength;
+            if (groupBytes >= BULK_CHUNK_SIZE) {
+                groupBytes = 0;
+            }
+        }
+        groups.push_back(count);
+        // 线程本地变量在工作线程上指向各自的实例，交给工作线程的必须是调用线程的引用
+        const std::vector<FrameJob>& work = jobs;
+        const std::vector<int>& bounds = groups;
+        pool.ParallelFor((uint32_t)bounds.size() - 1, [&](uint32_t group) {
+            for (int i = bounds[group]; i < bounds[group + 1]; i++) {
+                SealFrame(crypto, work[i].frame, work[i].text, work[i].length, work[i].sequence);
+            }
+        });
+    }
+    Metrics::Add(METRIC_FRAMES_OUT, count);
+    return total;
+}
+
+// 校验并解密到 dest（可与 payload 相同），返回（可能仍是压缩的）明文长度
+static int DecryptPayload(SessionCrypto& crypto, char* payload, uint32_t length, uint8_t flags, char* dest, int capacity) {
+    bool tagged = (flags & FRAME_FLAG_AUTH) != 0;
+    if (tagged != crypto.authenticated) {
+        return -1;
+    }
+    int plainTextLength;
+    if (crypto.authenticated) {
+        char header[FRAME_HEADER_SIZE];
+        EncodeFrameHeader(header, length, flags);
+        plainTextLength = OpenAuthenticated(crypto, crypto.recvSequence, crypto.recvDirection, header, FRAME_HEADER_SIZE,
+                                            payload, (int)length, dest, capacity);
+    } else if (crypto.aes) {
+        TRACE_SCOPE("AesOp::Open");
+        MetricTimer timer(METRIC_DECRYPT_NS);
+        if ((int)length > capacity) {
+            return -1;
+        }
+        uint8_t nonce[AES_GCM_NONCE_SIZE];
+        FrameNonce(nonce, crypto.recvDirection, crypto.recvSequence);
+        crypto.aes->CtrCrypt(nonce, payload, dest, length);
+        plainTextLength = (int)length;
+    } else {
+        return crypto.des.DecryptTo(payload, (int)length, dest, capacity);
+    }
+    if (plainTextLength >= 0) {
+        crypto.recvSequence++;
+    }
+    return plainTextLength;
+}
+
+int OpenMessage(SessionCrypto& crypto, char* payload, uint32_t length, uint8_t flags, char*& plainText) {
+    bool compressed = (flags & FRAME_FLAG_COMPRESSED) != 0;
+    if (compressed && !crypto.compressed) {
+        return -1;
+    }
+    int plainTextLength = DecryptPayload(crypto, payload, length, flags, payload, (int)length);
+    plainText = payload;
+    if (plainTextLength < 0 || !compressed) {
+        return plainTextLength;
+    }
+
+    if (plainTextLength < COMPRESSED_HEADER_SIZE) {
+        return -1;
+    }
+    uint32_t originalLength = 0;
+    for (int i = 0; i < COMPRESSED_HEADER_SIZE; i++) {
+        originalLength = (originalLength << 8) | (uint8_t)payload[i];
+    }
+    if (originalLength > COMPRESSED_MAX_ORIGINAL_LENGTH) {
+        return -1;
+    }
+    TRACE_SCOPE("decompress");
+    static thread_local std::vector<char> scratch;
+    if (scratch.size() < originalLength) {
+        scratch.resize(originalLength);
+    }
+    int decompressedLength = Compressor::Decompress(payload + COMPRESSED_HEADER_SIZE, plainTextLength - COMPRESSED_HEADER_SIZE,
+                                                    scratch.data(), (int)originalLength);
+    if (decompressedLength != (int)originalLength) {
+        return -1;
+    }
+    plainText = scratch.data();
+    return decompressedLength;
+}
+
+int OpenMessageTo(SessionCrypto& crypto, char* payload, uint32_t length, uint8_t flags, char* dest, int capacity) {
+    if (!(flags & FRAME_FLAG_COMPRESSED)) {
+        return DecryptPayload(crypto, payload, length, flags, dest, capacity);
+    }
+    char* plainText;
+    int plainTextLength = OpenMessage(crypto, payload, length, flags, plainText);
+    if (plainTextLength < 0 || plainTextLength > capacity) {
+        return -1;
+    }
+    memcpy(dest, plainText, plainTextLength);
+    return plainTextLength;
+}
+
+int SealedLength(const SessionCrypto& crypto, int length) {
+    // AES 是流式的，密文与明文等长；DES 要填充到整分组
+    int cipherTextLength = crypto.aes ? length : DesOp::CipherLength(length);
+    return cipherTextLength + (crypto.authenticated ? FRAME_TAG_LENGTH : 0);
+}
+
+// 数据报的方向字节是帧方向字节的小写形式：两条通道的序号各自从 0 开始，nonce 与 MAC 输入仍不会重合
+int SealDatagram(SessionCrypto& crypto, uint64_t sequence, const char* header, int headerLength,
+                 const char* text, int length, char* payload) {
+    return SealAuthenticated(crypto, sequence, crypto.sendDirection | 0x20, header, headerLength, text, length, payload);
+}
+
+int OpenDatagram(SessionCrypto& crypto, uint64_t sequence, const char* header, int headerLength, char* payload, int length) {
+    return OpenAuthenticated(crypto, sequence, crypto.recvDirection | 0x20, header, headerLength, payload, length, payload, length);
+}
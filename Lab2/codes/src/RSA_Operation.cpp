@@ -1,8 +1,10 @@
 #include "RSA_Operation.h"
+#include "Trace.h"
 #include <cassert>
 #include <iostream>
 
 uint64_t RSA::ModExp(uint64_t base, uint64_t exp, uint64_t mod) {
+    TRACE_SCOPE("RSA::ModExp");
     base = base % mod;
     uint64_t idx = (1LL << 63);
     while (!(exp & idx)) {
@@ -99,6 +101,7 @@ RSA::RSA() {
 RSA::~RSA() = default;
 
 bool RSA::GenerateKey() {
+    TRACE_SCOPE("RSA::GenerateKey");
     std::random_device rd;
     std::mt19937 gen(rd());
     std::uniform_int_distribution<uint64_t> dis(0x20000000, 0xFFFFFFFF);
@@ -138,6 +141,13 @@ uint64_t RSA::Encrypt(uint32_t plainText, uint64_t e, uint64_t n) {
     return ModExp((uint64_t)plainText, e, n);
 }
 
+void RSA::SetKey(uint64_t e, uint64_t d, uint64_t n) {
+    p = 0; q = 0; phi = 0;
+    this->e = e;
+    this->d = d;
+    this->n = n;
+}
+
 uint32_t RSA::Decrypt(uint64_t cipherText) {
     return (uint32_t)ModExp(cipherText, d, n);
 }
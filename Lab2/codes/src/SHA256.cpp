@@ -0,0 +1,218 @@
+// SHA256
+#include "SHA256.h"
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHA256_HAVE_SHANI 1
+#endif
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t Rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+void Sha256::CompressGeneric(uint32_t* state, const uint8_t* data, size_t blocks) {
+    while (blocks--) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = ((uint32_t)data[i * 4] << 24) | ((uint32_t)data[i * 4 + 1] << 16) |
+                   ((uint32_t)data[i * 4 + 2] << 8) | (uint32_t)data[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        data += SHA256_BLOCK_SIZE;
+    }
+}
+
+#ifdef SHA256_HAVE_SHANI
+// SHA-NI：每条 sha256rnds2 完成两轮，消息扩展由 sha256msg1/msg2 完成
+__attribute__((target("sha,sse4.1")))
+void Sha256::CompressShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_loadu_si128((const __m128i*)&state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i*)&state[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);                 // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);           // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);   // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);        // CDGH
+
+    while (blocks--) {
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+        __m128i m[4];
+        for (int i = 0; i < 4; i++) {
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), MASK);
+        }
+        for (int g = 0; g < 16; g++) {
+            __m128i& cur = m[g & 3];
+            __m128i& prev = m[(g + 3) & 3];
+            __m128i& next = m[(g + 1) & 3];
+            __m128i msg = _mm_add_epi32(cur, _mm_loadu_si128((const __m128i*)&K[g * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g <= 14) {
+                next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4)), cur);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g <= 12) {
+                prev = _mm_sha256msg1_epu32(prev, cur);
+            }
+        }
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+        data += SHA256_BLOCK_SIZE;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);              // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);           // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);        // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);           // ABEF
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+bool Sha256::HasShaNi() {
+    static const bool supported = __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+#else
+void Sha256::CompressShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+    CompressGeneric(state, data, blocks);
+}
+
+bool Sha256::HasShaNi() {
+    return false;
+}
+#endif
+
+void Sha256::Compress(uint32_t* state, const uint8_t* data, size_t blocks) {
+    if (HasShaNi()) {
+        CompressShaNi(state, data, blocks);
+    } else {
+        CompressGeneric(state, data, blocks);
+    }
+}
+
+Sha256::Sha256() {
+    Init();
+}
+
+void Sha256::Init() {
+    static const uint32_t IV[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(state, IV, sizeof(state));
+    bufferLength = 0;
+    totalLength = 0;
+}
+
+void Sha256::Update(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    totalLength += length;
+    if (bufferLength > 0) {
+        size_t take = SHA256_BLOCK_SIZE - bufferLength;
+        if (take > length) {
+            take = length;
+        }
+        memcpy(buffer + bufferLength, bytes, take);
+        bufferLength += (uint32_t)take;
+        bytes += take;
+        length -= take;
+        if (bufferLength < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        Compress(state, buffer, 1);
+        bufferLength = 0;
+    }
+    size_t blocks = length / SHA256_BLOCK_SIZE;
+    if (blocks > 0) {
+        Compress(state, bytes, blocks);
+        bytes += blocks * SHA256_BLOCK_SIZE;
+        length -= blocks * SHA256_BLOCK_SIZE;
+    }
+    memcpy(buffer, bytes, length);
+    bufferLength = (uint32_t)length;
+}
+
+void Sha256::Final(uint8_t* digest) {
+    uint64_t bitLength = totalLength * 8;
+    uint8_t padding[SHA256_BLOCK_SIZE * 2] = {0x80};
+    size_t padLength = (bufferLength < 56 ? 56 : 120) - bufferLength;
+    for (int i = 0; i < 8; i++) {
+        padding[padLength + i] = (uint8_t)(bitLength >> (56 - i * 8));
+    }
+    Update(padding, padLength + 8);
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)state[i];
+    }
+}
+
+void Sha256::Hash(const void* data, size_t length, uint8_t* digest) {
+    Sha256 context;
+    context.Update(data, length);
+    context.Final(digest);
+}
+
+void Hmac::SetKey(const uint8_t* key, size_t length) {
+    uint8_t block[SHA256_BLOCK_SIZE] = {0};
+    if (length > SHA256_BLOCK_SIZE) {
+        Sha256::Hash(key, length, block);
+    } else {
+        memcpy(block, key, length);
+    }
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    Sha256 context;
+    context.Update(pad, SHA256_BLOCK_SIZE);
+    memcpy(innerState, context.state, sizeof(innerState));
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    context.Init();
+    context.Update(pad, SHA256_BLOCK_SIZE);
+    memcpy(outerState, context.state, sizeof(outerState));
+}
+
+Sha256 Hmac::Resume(const uint32_t* state) {
+    Sha256 context;
+    memcpy(context.state, state, sizeof(context.state));
+    context.totalLength = SHA256_BLOCK_SIZE;
+    return context;
+}
+
+void Hmac::Finish(Sha256& context, uint8_t* mac) const {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    context.Final(digest);
+    Sha256 result = Resume(outerState);
+    result.Update(digest, SHA256_DIGEST_SIZE);
+    result.Final(mac);
+}
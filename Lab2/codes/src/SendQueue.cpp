@@ -0,0 +1,327 @@
+// SendQueue
+#include "SendQueue.h"
+#include "Frame.h"
+#include "Metrics.h"
+#include "SharedMemory.h"
+#include "Trace.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+SendQueue::SendQueue(BufferPool& pool) {
+    this->pool = &pool;
+    current = nullptr;
+    segmentHead = 0;
+    queuedBytes = 0;
+    zeroCopy = false;
+    zeroCopyNextId = 0;
+    zeroCopyHead = 0;
+    highWatermark = SEND_QUEUE_HIGH_WATERMARK;
+    lowWatermark = SEND_QUEUE_LOW_WATERMARK;
+    paused = false;
+    pausedSince = 0;
+    stats = {};
+    shared = nullptr;
+    socketBytes = 0;
+}
+
+SendQueue::~SendQueue() {
+    for (size_t i = segmentHead; i < segments.size(); i++) {
+        pool->Release(segments[i].slab);
+    }
+    for (size_t i = zeroCopyHead; i < zeroCopyPending.size(); i++) {
+        pool->Release(zeroCopyPending[i].slab);
+    }
+    if (current) {
+        pool->Release(current);
+    }
+}
+
+uint64_t SendQueue::NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SendQueue::SetWatermarks(size_t high, size_t low) {
+    highWatermark = high;
+    lowWatermark = low < high ? low : high;
+}
+
+bool SendQueue::EnableZeroCopy(int fd) {
+#ifdef SO_ZEROCOPY
+    int one = 1;
+    zeroCopy = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+#endif
+    return zeroCopy;
+}
+
+char* SendQueue::Reserve(uint32_t length) {
+    if (current && current->capacity - current->used >= length) {
+        return current->data + current->used;
+    }
+    // 当前 slab 放不下：交还“正在填充”的引用，换一块新的
+    if (current) {
+        pool->Release(current);
+    }
+    current = pool->Acquire(length);
+    return current->data;
+}
+
+void SendQueue::Commit(uint32_t length) {
+    // 与上一段在同一 slab 中首尾相接时直接合并，减少 iovec 数量
+    SendSegment* last = segmentHead == segments.size() ? nullptr : &segments.back();
+    if (last && last->slab == current && last->offset + last->length == current->used) {
+        last->length += length;
+    } else {
+        segments.push_back({current, current->used, length});
+        current->refs++;
+    }
+    current->used += length;
+    queuedBytes += length;
+    if (!paused && queuedBytes >= highWatermark) {
+        paused = true;
+        pausedSince = NowNanos();
+        stats.pauses++;
+        Metrics::Add(METRIC_BACKPRESSURE_EVENTS);
+    }
+}
+
+void SendQueue::Consume(size_t length) {
+    queuedBytes -= length;
+    while (length > 0) {
+        SendSegment& head = segments[segmentHead];
+        if (length < head.length) {
+            head.offset += (uint32_t)length;
+            head.length -= (uint32_t)length;
+            return;
+        }
+        length -= head.length;
+        pool->Release(head.slab);
+        segmentHead++;
+    }
+    if (segmentHead == segments.size()) {
+        segments.clear();
+        segmentHead = 0;
+    }
+}
+
+// 队列清空后把正在填充的 slab 还给共享池；池的空闲链表后进先出，下一次借到的通常还是它
+void SendQueue::ReleaseIdle() {
+    if (current && segmentHead == segments.size()) {
+        pool->Release(current);
+        current = nullptr;
+    }
+    if (segments.empty() && segments.capacity() > SEND_QUEUE_MAX_IOV) {
+        segments.shrink_to_fit();
+    }
+    if (zeroCopyHead == zeroCopyPending.size()) {
+        zeroCopyPending.clear();
+        zeroCopyHead = 0;
+        if (zeroCopyPending.capacity() > SEND_QUEUE_MAX_IOV) {
+            zeroCopyPending.shrink_to_fit();
+        }
+    }
+}
+
+bool SendQueue::WaitsForSocket() const {
+    if (shared != nullptr && shared->Sending()) {
+        return socketBytes > 0;
+    }
+    return !Empty();
+}
+
+ssize_t SendQueue::Flush(int fd) {
+    if (shared != nullptr && shared->IsOpen()) {
+        if (!shared->Sending() && shared->PeerAttached()) {
+            char* header = Reserve(FRAME_HEADER_SIZE);
+            EncodeFrameHeader(header, 0, FRAME_FLAG_SHARED_MEMORY);
+            Commit(FRAME_HEADER_SIZE);
+            socketBytes = queuedBytes;
+            shared->StartSending();
+        }
+        if (shared->Sending()) {
+            return FlushShared(fd);
+        }
+    }
+    ssize_t total = 0;
+    bool copyHead = false;          // 锁页内存额度不足（ENOBUFS）时本帧退回拷贝发送
+    while (segmentHead < segments.size()) {
+        SendSegment& head = segments[segmentHead];
+        iovec iov[SEND_QUEUE_MAX_IOV];
+        msghdr msg{};
+        msg.msg_iov = iov;
+        int flags = MSG_NOSIGNAL;
+
+        if (zeroCopy && !copyHead && head.length >= ZEROCOPY_THRESHOLD) {
+            // 大帧单独发送，内核直接引用 slab 所在的用户页
+            iov[0].iov_base = head.slab->data + head.offset;
+            iov[0].iov_len = head.length;
+            msg.msg_iovlen = 1;
+            flags |= MSG_ZEROCOPY;
+        } else {
+            // 小帧聚合成一次 sendmsg，遇到需要零拷贝的大帧为止
+            int count = 0;
+            for (auto it = segments.begin() + segmentHead; it != segments.end() && count < SEND_QUEUE_MAX_IOV; ++it) {
+                if (zeroCopy && count > 0 && it->length >= ZEROCOPY_THRESHOLD) {
+                    break;
+                }
+                iov[count].iov_base = it->slab->data + it->offset;
+                iov[count].iov_len = it->length;
+                count++;
+            }
+            msg.msg_iovlen = count;
+        }
+
+        ssize_t len = TRACE_CALL("sendmsg", sendmsg(fd, &msg, flags));
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+                copyHead = true;
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                stats.wouldBlock++;
+                break;
+            }
+            return -1;
+        }
+        size_t attempted = 0;
+        for (size_t i = 0; i < msg.msg_iovlen; i++) {
+            attempted += iov[i].iov_len;
+        }
+        if (flags & MSG_ZEROCOPY) {
+            // 在完成通知到达前 slab 不能被复用
+            head.slab->refs++;
+            zeroCopyPending.push_back({zeroCopyNextId++, head.slab});
+        }
+        Consume(len);
+        total += len;
+        Metrics::Add(METRIC_BYTES_OUT, len);
+        copyHead = false;
+        if ((size_t)len < attempted) {
+            // 发送缓冲区已满，剩余部分等 socket 可写时再续写
+            stats.partialWrites++;
+            break;
+        }
+    }
+    FinishFlush();
+    return total;
+}
+
+// 切换帧之前的数据仍按顺序经 socket 发出（只在切换时发生一次），之后的数据拷入共享内存环
+ssize_t SendQueue::FlushShared(int fd) {
+    ssize_t total = 0;
+    while (socketBytes > 0) {
+        SendSegment& head = segments[segmentHead];
+        size_t length = head.length < socketBytes ? head.length : socketBytes;
+        ssize_t len = TRACE_CALL("send", send(fd, head.slab->data + head.offset, length, MSG_NOSIGNAL));
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                stats.wouldBlock++;
+                FinishFlush();
+                return total;
+            }
+            return -1;
+        }
+        Consume(len);
+        socketBytes -= len;
+        total += len;
+        Metrics::Add(METRIC_BYTES_OUT, len);
+    }
+    size_t written = 0;
+    while (segmentHead < segments.size()) {
+        SendSegment& head = segments[segmentHead];
+        size_t length = shared->Write(head.slab->data + head.offset, head.length);
+        if (length == 0) {
+            break;
+        }
+        Consume(length);
+        written += length;
+    }
+    if (written > 0) {
+        shared->Wake(fd);
+        Metrics::Add(METRIC_BYTES_OUT, written);
+    }
+    FinishFlush();
+    return total + (ssize_t)written;
+}
+
+void SendQueue::FinishFlush() {
+    if (paused && queuedBytes <= lowWatermark) {
+        paused = false;
+        uint64_t pausedNanos = NowNanos() - pausedSince;
+        stats.pausedNanos += pausedNanos;
+        Metrics::Add(METRIC_BACKPRESSURE_NS, pausedNanos);
+    }
+    ReleaseIdle();
+}
+
+void SendQueue::Save(HandoffWriter& out) const {
+    out.PutU32(zeroCopyNextId);
+    out.PutU64(socketBytes);
+    out.PutU64(queuedBytes);
+    for (size_t i = segmentHead; i < segments.size(); i++) {
+        out.Put(segments[i].slab->data + segments[i].offset, segments[i].length);
+    }
+}
+
+bool SendQueue::Restore(HandoffReader& in) {
+    zeroCopyNextId = in.GetU32();
+    socketBytes = in.GetU64();
+    size_t length = in.GetU64();
+    const char* data = in.Take(length);
+    if (data == nullptr) {
+        return false;
+    }
+    while (length > 0) {
+        uint32_t chunk = length < pool->GetSlabSize() ? (uint32_t)length : pool->GetSlabSize();
+        memcpy(Reserve(chunk), data, chunk);
+        Commit(chunk);
+        data += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+void SendQueue::ReapCompletions(int fd) {
+    while (true) {
+        char control[128];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+            break;
+        }
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool ipErr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                         (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!ipErr) {
+                continue;
+            }
+            auto* err = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cm));
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            // 通知给出的是一个闭区间 [ee_info, ee_data] 内已完成的调用序号
+            uint32_t lo = err->ee_info, hi = err->ee_data;
+            while (zeroCopyHead < zeroCopyPending.size()) {
+                uint32_t id = zeroCopyPending[zeroCopyHead].id;
+                if (id - lo > hi - lo) {
+                    break;
+                }
+                pool->Release(zeroCopyPending[zeroCopyHead].slab);
+                zeroCopyHead++;
+            }
+        }
+    }
+    ReleaseIdle();
+}
@@ -0,0 +1,253 @@
+// SharedMemoryChannel
+#include "SharedMemory.h"
+#include "Frame.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+
+#define SHARED_MEMORY_DATA_OFFSET 4096      // 控制块之后按页对齐放两个环
+#define SHARED_MEMORY_SEGMENT_SIZE (SHARED_MEMORY_DATA_OFFSET + 2 * (size_t)SHARED_MEMORY_RING_SIZE)
+
+SharedMemoryChannel::SharedMemoryChannel() {
+    segment = nullptr;
+    fd = -1;
+    data[0] = data[1] = nullptr;
+    mappedSize = 0;
+    side = 0;
+    name[0] = '\0';
+    sending = false;
+    receiving = false;
+    endSeen = false;
+}
+
+SharedMemoryChannel::~SharedMemoryChannel() {
+    Close();
+}
+
+bool SharedMemoryChannel::Open(uint64_t id, bool isServer) {
+    static_assert(sizeof(SharedSegment) <= SHARED_MEMORY_DATA_OFFSET, "control block must fit in one page");
+    snprintf(name, sizeof(name), "/encchat-%016llx", (unsigned long long)id);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        std::cerr << "Error: Failed to open shared memory " << name << "." << std::endl;
+        return false;
+    }
+    // 名字由会话密钥派生，别人猜不到；仍然拒绝不属于自己或大小不对的对象
+    struct stat st;
+    if (ftruncate(fd, SHARED_MEMORY_SEGMENT_SIZE) < 0 || fstat(fd, &st) < 0 || st.st_uid != geteuid() ||
+        (size_t)st.st_size != SHARED_MEMORY_SEGMENT_SIZE) {
+        std::cerr << "Error: Failed to set up shared memory " << name << "." << std::endl;
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    if (!Map(fd, id, isServer ? 0 : 1)) {
+        shm_unlink(name);
+        return false;
+    }
+    // 两端都已映射后名字不再需要；任何一端先退出时由 Close 删除
+    if (segment->attached.fetch_add(1) + 1 == 2) {
+        shm_unlink(name);
+    }
+    return true;
+}
+
+bool SharedMemoryChannel::Map(int fd, uint64_t id, int side) {
+    snprintf(name, sizeof(name), "/encchat-%016llx", (unsigned long long)id);
+    void* map = mmap(nullptr, SHARED_MEMORY_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        std::cerr << "Error: Failed to map shared memory " << name << "." << std::endl;
+        close(fd);
+        return false;
+    }
+    segment = static_cast<SharedSegment*>(map);
+    this->fd = fd;
+    mappedSize = SHARED_MEMORY_SEGMENT_SIZE;
+    this->side = side;
+    data[0] = static_cast<char*>(map) + SHARED_MEMORY_DATA_OFFSET;
+    data[1] = data[0] + SHARED_MEMORY_RING_SIZE;
+    return true;
+}
+
+void SharedMemoryChannel::Close() {
+    if (segment == nullptr) {
+        return;
+    }
+    shm_unlink(name);
+    Detach();
+}
+
+void SharedMemoryChannel::Detach() {
+    if (segment == nullptr) {
+        return;
+    }
+    munmap(segment, mappedSize);
+    close(fd);
+    segment = nullptr;
+    fd = -1;
+    sending = false;
+    receiving = false;
+    endSeen = false;
+}
+
+void SharedMemoryChannel::Save(HandoffWriter& out) const {
+    out.PutFd(fd);
+    out.PutU8((uint8_t)side);
+    out.PutU8(sending);
+    out.PutU8(receiving);
+    out.PutU8(endSeen);
+}
+
+bool SharedMemoryChannel::Restore(HandoffReader& in, uint64_t id) {
+    int fd = in.TakeFd();
+    int side = in.GetU8();
+    sending = in.GetU8() != 0;
+    receiving = in.GetU8() != 0;
+    endSeen = in.GetU8() != 0;
+    struct stat st;
+    if (!in.Ok() || fstat(fd, &st) < 0 || (size_t)st.st_size != SHARED_MEMORY_SEGMENT_SIZE) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    return Map(fd, id, side);
+}
+
+bool SharedMemoryChannel::PeerAttached() const {
+    return segment->attached.load(std::memory_order_acquire) >= 2;
+}
+
+size_t SharedMemoryChannel::Write(const char* source, size_t length) {
+    SharedRing& ring = Out();
+    uint64_t position = ring.tail.load(std::memory_order_relaxed);
+    if (SHARED_MEMORY_RING_SIZE - (size_t)(position - ring.cachedHead) < length) {
+        ring.cachedHead = ring.head.load(std::memory_order_acquire);
+    }
+    size_t free = SHARED_MEMORY_RING_SIZE - (size_t)(position - ring.cachedHead);
+    if (length > free) {
+        length = free;
+    }
+    if (length == 0) {
+        return 0;
+    }
+    char* buffer = data[side];
+    size_t offset = position & (SHARED_MEMORY_RING_SIZE - 1);
+    size_t first = SHARED_MEMORY_RING_SIZE - offset < length ? SHARED_MEMORY_RING_SIZE - offset : length;
+    memcpy(buffer + offset, source, first);
+    memcpy(buffer, source + first, length - first);
+    ring.tail.store(position + length, std::memory_order_release);
+    return length;
+}
+
+size_t SharedMemoryChannel::ReadableRegion(const char*& source) {
+    SharedRing& ring = In();
+    uint64_t position = ring.head.load(std::memory_order_relaxed);
+    size_t offset = position & (SHARED_MEMORY_RING_SIZE - 1);
+    if ((size_t)(ring.cachedTail - position) < SHARED_MEMORY_RING_SIZE - offset) {
+        ring.cachedTail = ring.tail.load(std::memory_order_acquire);
+    }
+    size_t used = (size_t)(ring.cachedTail - position);
+    source = data[1 - side] + offset;
+    return used < SHARED_MEMORY_RING_SIZE - offset ? used : SHARED_MEMORY_RING_SIZE - offset;
+}
+
+void SharedMemoryChannel::Consume(size_t length) {
+    SharedRing& ring = In();
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
+
+bool SharedMemoryChannel::Readable() {
+    SharedRing& ring = In();
+    return ring.tail.load(std::memory_order_acquire) != ring.head.load(std::memory_order_relaxed);
+}
+
+bool SharedMemoryChannel::Writable() {
+    SharedRing& ring = Out();
+    return ring.tail.load(std::memory_order_relaxed) - ring.head.load(std::memory_order_acquire) < SHARED_MEMORY_RING_SIZE;
+}
+
+bool SharedMemoryChannel::PeerClosed() const {
+    return segment->closed[1 - side].load(std::memory_order_acquire) != 0;
+}
+
+void SharedMemoryChannel::Shutdown(int fd) {
+    segment->closed[side].store(1, std::memory_order_release);
+    Wake(fd);
+}
+
+bool SharedMemoryChannel::Pending(bool wantData, bool wantSpace) {
+    bool data = wantData && receiving && ((!endSeen && PeerClosed()) || Readable());
+    if (data || (wantSpace && sending && Writable())) {
+        if (segment->parked[side].load(std::memory_order_relaxed)) {
+            segment->parked[side].store(0, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    return false;
+}
+
+// 与 Wake 配对：先登记再检查，对方先写数据再检查登记，两边之间用全屏障保证不会同时错过对方
+bool SharedMemoryChannel::Park(bool wantData, bool wantSpace) {
+    segment->parked[side].store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return !Pending(wantData, wantSpace);
+}
+
+void SharedMemoryChannel::Wake(int fd) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::atomic<uint32_t>& peer = segment->parked[1 - side];
+    if (peer.load(std::memory_order_relaxed) && peer.exchange(0)) {
+        // 门铃是一个空的保活帧：不认识共享内存的读者（例如回放抓包）会直接跳过它
+        char doorbell[FRAME_HEADER_SIZE];
+        EncodeFrameHeader(doorbell, 0, FRAME_FLAG_KEEPALIVE);
+        TRACE_CALL("send", send(fd, doorbell, sizeof(doorbell), MSG_NOSIGNAL | MSG_DONTWAIT));
+        Metrics::Add(METRIC_SHARED_MEMORY_WAKEUPS);
+    }
+}
+
+bool SharedMemoryChannel::DrainDoorbells(int fd) {
+    char doorbells[256];
+    while (true) {
+        ssize_t len = TRACE_CALL("recv", recv(fd, doorbells, sizeof(doorbells), MSG_DONTWAIT));
+        if (len > 0) {
+            continue;
+        }
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        // 连接断开：对方进程已经退出，不会再写入也不会再读取
+        if (len == 0) {
+            errno = ECONNRESET;
+        }
+        return false;
+    }
+}
+
+bool SharedMemoryChannel::IsLocalPeer(int fd) {
+    sockaddr_in local, peer;
+    socklen_t localLength = sizeof(local), peerLength = sizeof(peer);
+    if (getsockname(fd, (sockaddr*)&local, &localLength) < 0 || getpeername(fd, (sockaddr*)&peer, &peerLength) < 0 ||
+        local.sin_family != AF_INET || peer.sin_family != AF_INET) {
+        return false;
+    }
+    return (ntohl(peer.sin_addr.s_addr) >> 24) == 127 || peer.sin_addr.s_addr == local.sin_addr.s_addr;
+}
+
+uint64_t SharedMemoryChannel::SpinNanos() {
+    const char* value = getenv(SHARED_MEMORY_SPIN_ENV);
+    return (uint64_t)(value != nullptr ? atoi(value) : SHARED_MEMORY_DEFAULT_SPIN_US) * 1000;
+}
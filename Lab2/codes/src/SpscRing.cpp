@@ -0,0 +1,51 @@
+// SpscRing
+#include "SpscRing.h"
+#include <cstdlib>
+
+SpscRing::SpscRing(size_t size) {
+    capacity = 4096;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    mask = capacity - 1;
+    buffer = static_cast<char*>(aligned_alloc(4096, capacity));
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    cachedTail = 0;
+    cachedHead = 0;
+}
+
+SpscRing::~SpscRing() {
+    free(buffer);
+}
+
+size_t SpscRing::WritableRegion(char*& data) {
+    uint64_t position = tail.load(std::memory_order_relaxed);
+    size_t offset = position & mask;
+    // 缓存的 head 限制了可写区域时才去读消费者的位置
+    if (capacity - (size_t)(position - cachedHead) < capacity - offset) {
+        cachedHead = head.load(std::memory_order_acquire);
+    }
+    size_t free = capacity - (size_t)(position - cachedHead);
+    data = buffer + offset;
+    return free < capacity - offset ? free : capacity - offset;
+}
+
+void SpscRing::Produce(size_t length) {
+    tail.store(tail.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
+
+size_t SpscRing::ReadableRegion(const char*& data) {
+    uint64_t position = head.load(std::memory_order_relaxed);
+    size_t offset = position & mask;
+    if ((size_t)(cachedTail - position) < capacity - offset) {
+        cachedTail = tail.load(std::memory_order_acquire);
+    }
+    size_t used = (size_t)(cachedTail - position);
+    data = buffer + offset;
+    return used < capacity - offset ? used : capacity - offset;
+}
+
+void SpscRing::Consume(size_t length) {
+    head.store(head.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
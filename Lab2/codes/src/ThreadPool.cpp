@@ -0,0 +1,147 @@
+// WorkStealingPool
+#include "ThreadPool.h"
+#include <cstdlib>
+
+// 当前线程正在执行某个任务的块：块内再次提交（例如批量加密中的大帧）直接串行执行
+static thread_local bool participating = false;
+
+static inline uint64_t PackRange(uint32_t begin, uint32_t end) {
+    return ((uint64_t)end << 32) | begin;
+}
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    job = nullptr;
+    generation = 0;
+    active = 0;
+    stopping = false;
+    if (threads > POOL_MAX_THREADS) {
+        threads = POOL_MAX_THREADS;
+    }
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+WorkStealingPool& WorkStealingPool::Instance() {
+    static WorkStealingPool pool([] {
+        const char* value = getenv(POOL_THREADS_ENV);
+        int threads = value ? atoi(value) : (int)std::thread::hardware_concurrency();
+        return threads > 0 ? threads : 1;
+    }());
+    return pool;
+}
+
+void WorkStealingPool::Participate(ParallelJob& job, int index) {
+    uint32_t done = 0;
+    StealRange& own = job.ranges[index];
+    participating = true;
+    while (true) {
+        uint64_t range = own.range.load(std::memory_order_acquire);
+        uint32_t begin = (uint32_t)range, end = (uint32_t)(range >> 32);
+        if (begin < end) {
+            if (own.range.compare_exchange_weak(range, PackRange(begin + 1, end), std::memory_order_acq_rel)) {
+                (*job.function)(begin);
+                done++;
+            }
+            continue;
+        }
+
+        // 自己的区间已领完：从其他线程区间的后端窃取一半。只有所有区间都为空时才退出
+        bool pending = false;
+        for (int i = 1; i < job.participants; i++) {
+            StealRange& victim = job.ranges[(index + i) % job.participants];
+            uint64_t victimRange = victim.range.load(std::memory_order_acquire);
+            uint32_t victimBegin = (uint32_t)victimRange, victimEnd = (uint32_t)(victimRange >> 32);
+            if (victimBegin >= victimEnd) {
+                continue;
+            }
+            pending = true;
+            uint32_t middle = victimBegin + (victimEnd - victimBegin) / 2;
+            if (victim.range.compare_exchange_strong(victimRange, PackRange(victimBegin, middle), std::memory_order_acq_rel)) {
+                // 自己的区间为空时没有其他线程会修改它，直接写入
+                own.range.store(PackRange(middle, victimEnd), std::memory_order_release);
+                break;
+            }
+        }
+        if (!pending) {
+            break;
+        }
+    }
+    participating = false;
+    if (done > 0) {
+        job.remaining.fetch_sub(done, std::memory_order_acq_rel);
+    }
+}
+
+void WorkStealingPool::WorkerLoop(int index) {
+    uint64_t seen = 0;
+    while (true) {
+        ParallelJob* current;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [&] { return stopping || (job != nullptr && generation != seen); });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            current = job;
+            active++;
+        }
+        if (index < current->participants) {
+            Participate(*current, index);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+        }
+        idle.notify_one();
+    }
+}
+
+void WorkStealingPool::ParallelFor(uint32_t chunks, const std::function<void(uint32_t)>& function) {
+    std::unique_lock<std::mutex> submit(submitMutex, std::defer_lock);
+    if (chunks <= 1 || workers.empty() || participating || !submit.try_lock()) {
+        for (uint32_t i = 0; i < chunks; i++) {
+            function(i);
+        }
+        return;
+    }
+
+    // 初始按线程数均分为连续区间，每个线程顺序处理相邻的块，预取与缓存都更友好
+    ParallelJob current;
+    current.function = &function;
+    current.participants = Concurrency();
+    current.remaining.store(chunks, std::memory_order_relaxed);
+    for (int i = 0; i < current.participants; i++) {
+        uint32_t begin = (uint32_t)((uint64_t)chunks * i / current.participants);
+        uint32_t end = (uint32_t)((uint64_t)chunks * (i + 1) / current.participants);
+        current.ranges[i].range.store(PackRange(begin, end), std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &current;
+        generation++;
+    }
+    wakeup.notify_all();
+
+    Participate(current, 0);
+    // 剩下的块正在其他线程上执行，通常很快结束
+    while (current.remaining.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+    // 任务对象在栈上：等所有工作线程都离开后才能返回
+    std::unique_lock<std::mutex> lock(mutex);
+    job = nullptr;
+    idle.wait(lock, [this] { return active == 0; });
+}
@@ -0,0 +1,162 @@
+// TimerWheel
+#include "TimerWheel.h"
+#include "Trace.h"
+#include <chrono>
+
+TimerWheel::TimerWheel() {
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_LEVEL_SLOTS; slot++) {
+            slots[level][slot] = nullptr;
+        }
+        occupied[level] = 0;
+    }
+    current = NowTicks();
+    count = 0;
+}
+
+static inline int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t TimerWheel::NowTicks() {
+    return (uint64_t)NowMs() / TIMER_TICK_MS;
+}
+
+void TimerWheel::Init(TimerNode* node, void (*callback)(void*), void* context) {
+    node->next = nullptr;
+    node->pprev = nullptr;
+    node->expires = 0;
+    node->callback = callback;
+    node->context = context;
+}
+
+void TimerWheel::Unlink(TimerNode* node) {
+    if (node->next) {
+        node->next->pprev = node->pprev;
+    }
+    *node->pprev = node->next;
+    node->next = nullptr;
+    node->pprev = nullptr;
+}
+
+// 按剩余格数选层：第 l 层容纳剩余 [64^l, 64^(l+1)) 格的定时器，槽号取到期格数的第 l 组 6 位。
+// 这样第 l 层的槽总是在“当前格的第 l 组 6 位走到该槽”时下沉，下沉后剩余格数必然落入更低的层
+void TimerWheel::Place(TimerNode* node) {
+    uint64_t delta = node->expires - current;
+    uint64_t expires = node->expires;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= (1ull << (TIMER_LEVEL_BITS * (level + 1)))) {
+        level++;
+    }
+    if (delta >= (1ull << (TIMER_LEVEL_BITS * TIMER_LEVELS))) {
+        // 超出范围：先放在最高层最远的槽，下沉时按真实到期时间重新放置
+        expires = current + (1ull << (TIMER_LEVEL_BITS * TIMER_LEVELS)) - 1;
+    }
+    int slot = (int)((expires >> (TIMER_LEVEL_BITS * level)) & (TIMER_LEVEL_SLOTS - 1));
+    TimerNode** head = &slots[level][slot];
+    node->next = *head;
+    if (*head) {
+        (*head)->pprev = &node->next;
+    }
+    *head = node;
+    node->pprev = head;
+    occupied[level] |= 1ull << slot;
+}
+
+void TimerWheel::Schedule(TimerNode* node, uint64_t ticks) {
+    if (Pending(node)) {
+        Cancel(node);
+    }
+    node->expires = current + (ticks > 0 ? ticks : 1);
+    Place(node);
+    count++;
+}
+
+void TimerWheel::Cancel(TimerNode* node) {
+    if (!Pending(node)) {
+        return;
+    }
+    // 节点可能在正在处理的局部链表里，此时不属于任何槽，位图由推进过程维护
+    TimerNode** head = node->pprev;
+    Unlink(node);
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        if (head >= &slots[level][0] && head < &slots[level][TIMER_LEVEL_SLOTS] && *head == nullptr) {
+            occupied[level] &= ~(1ull << (head - &slots[level][0]));
+        }
+    }
+    count--;
+}
+
+void TimerWheel::Cascade(int level) {
+    int slot = (int)((current >> (TIMER_LEVEL_BITS * level)) & (TIMER_LEVEL_SLOTS - 1));
+    TimerNode* node = slots[level][slot];
+    slots[level][slot] = nullptr;
+    occupied[level] &= ~(1ull << slot);
+    while (node) {
+        TimerNode* next = node->next;
+        Place(node);
+        node = next;
+    }
+}
+
+uint64_t TimerWheel::Advance(uint64_t now) {
+    uint64_t fired = 0;
+    while (current < now) {
+        // 没有任何定时器时直接跳到 now
+        if (count == 0) {
+            current = now;
+            break;
+        }
+        current++;
+        for (int level = 1; level < TIMER_LEVELS; level++) {
+            if ((current & ((1ull << (TIMER_LEVEL_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            Cascade(level);
+        }
+
+        int slot = (int)(current & (TIMER_LEVEL_SLOTS - 1));
+        if (slots[0][slot] == nullptr) {
+            continue;
+        }
+        // 整个槽先摘到局部链表上；回调中取消或重新调度其他节点都是安全的
+        TRACE_SCOPE("TimerWheel::Expire");
+        TimerNode* pending = slots[0][slot];
+        slots[0][slot] = nullptr;
+        occupied[0] &= ~(1ull << slot);
+        pending->pprev = &pending;
+        while (pending) {
+            TimerNode* node = pending;
+            Unlink(node);
+            if (node->expires > current) {
+                // 超出时间轮范围的定时器：还没到真实到期时间
+                Place(node);
+                continue;
+            }
+            count--;
+            fired++;
+            node->callback(node->context);
+        }
+    }
+    return fired;
+}
+
+int TimerWheel::NextTimeoutMs() const {
+    if (count == 0) {
+        return -1;
+    }
+    // 第 0 层的定时器都在未来 63 格之内；否则至少要在第 0 层转完一圈时醒来做下沉
+    uint64_t ticks = TIMER_LEVEL_SLOTS - (current & (TIMER_LEVEL_SLOTS - 1));
+    if (occupied[0] != 0) {
+        int index = (int)(current & (TIMER_LEVEL_SLOTS - 1));
+        uint64_t rotated = (occupied[0] >> index) | (index ? occupied[0] << (TIMER_LEVEL_SLOTS - index) : 0);
+        rotated &= ~1ull;
+        if (rotated != 0) {
+            uint64_t next = (uint64_t)__builtin_ctzll(rotated);
+            ticks = next < ticks ? next : ticks;
+        }
+    }
+    int64_t remaining = (int64_t)((current + ticks) * TIMER_TICK_MS) - NowMs();
+    return remaining > 0 ? (int)remaining : 0;
+}
@@ -0,0 +1,82 @@
+// Trace
+#include "Trace.h"
+
+#ifdef ENCCHAT_TRACE
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+std::atomic<TraceBuffer*> Trace::buffers(nullptr);
+
+// 进程启动时记录一对 (TSC, 纳秒)，导出时再取一对，据此把 TSC 换算为时间
+static uint64_t SteadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static const uint64_t baseTicks = Trace::Now();
+static const uint64_t baseNanos = SteadyNanos();
+
+uint64_t Trace::Now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return SteadyNanos();
+#endif
+}
+
+TraceBuffer* Trace::Register() {
+    auto* buffer = new TraceBuffer();
+    buffer->head = 0;
+    buffer->tid = (uint32_t)syscall(SYS_gettid);
+    TraceBuffer* head = buffers.load(std::memory_order_relaxed);
+    do {
+        buffer->next = head;
+    } while (!buffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+    return buffer;
+}
+
+bool Trace::Dump(const char* path) {
+    uint64_t endTicks = Now();
+    uint64_t endNanos = SteadyNanos();
+    double nanosPerTick = endTicks > baseTicks ? (double)(endNanos - baseNanos) / (endTicks - baseTicks) : 1.0;
+
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        std::cerr << "Error: Failed to open trace file " << path << "." << std::endl;
+        return false;
+    }
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    int pid = (int)getpid();
+    for (TraceBuffer* buffer = buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+        for (uint64_t i = head - count; i < head; i++) {
+            const TraceEvent& event = buffer->events[i & (TRACE_RING_SIZE - 1)];
+            double ts = (event.begin - baseTicks) * nanosPerTick / 1000.0;
+            double dur = (event.end - event.begin) * nanosPerTick / 1000.0;
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                    first ? "" : ",\n", event.name, ts, dur, pid, buffer->tid);
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+void Trace::DumpFromEnv() {
+    const char* path = getenv(TRACE_FILE_ENV);
+    if (Dump(path ? path : TRACE_DEFAULT_FILE)) {
+        std::cout << "Trace written to " << (path ? path : TRACE_DEFAULT_FILE) << "." << std::endl;
+    }
+}
+
+#endif
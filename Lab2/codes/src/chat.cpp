@@ -1,9 +1,14 @@
 // Chat
 #include "chat.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
+#include <string>
+#include <cerrno>
 #include <fcntl.h>      // 用于 fcntl
-#include <sys/select.h> // 用于 select
+#include <sys/epoll.h>  // 用于 EPOLLIN 等事件掩码
 
 Chat::Chat() {
     Init();
@@ -28,8 +33,27 @@ void Chat::Init() {
     clientSocket = -1;
     serverIp = DEFAULT_SERVER_IP;
     serverPort = DEFAULT_SERVER_PORT;
-    isRunning = false;
+    messageLength = 0;
     exited = false;
+    inputOpen = true;
+    socketEvents = EPOLLIN | EPOLLRDHUP;
+    pipeMode = false;
+    writeShutdown = false;
+    peerClosed = false;
+    pipeOutputLength = 0;
+    chatting = false;
+}
+
+void Chat::SetEndpoint(const char* ip, int port) {
+    serverIp = ip;
+    serverPort = port;
+}
+
+void Chat::SetPipeMode(bool enabled) {
+    pipeMode = enabled;
+    if (enabled) {
+        pipeOutput.resize(PIPE_OUTPUT_SIZE);
+    }
 }
 
 // 设置 socket 为非阻塞模式
@@ -38,113 +62,443 @@ static void setNonBlocking(int sockfd) {
     fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
 }
 
-void Chat::Connect() {
-    clientSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (clientSocket < 0) {
-        std::cerr << "Error: Failed to create socket." << std::endl;
-        return;
+// 加密一条消息并排入发送队列：直接加密到 slab 中，不再为每条消息分配密文缓冲区
+void Chat::Send(const char* text, int length) {
+    QueueMessage(sendQueue, crypto, text, length);
+}
+
+bool Chat::Flush() {
+    if (sendQueue.Flush(clientSocket) < 0) {
+        std::cerr << "Error: Failed to send message." << std::endl;
+        loop.Stop();
+        return false;
     }
-    // 设置客户端 socket 为非阻塞模式
-    setNonBlocking(clientSocket);
+    UpdateInterest();
+    return true;
+}
 
-    struct sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(serverPort);
-    serverAddr.sin_addr.s_addr = inet_addr(serverIp);
+// 根据发送队列状态调整关注的事件：有积压时等待 EPOLLOUT 续写。
+// 超过高水位时 PumpInput 停止从输入环中取数据，回落到低水位后由 EPOLLOUT 恢复
+// 经共享内存发送时 socket 上的门铃也表示环中腾出了空间，对端关闭写方向后仍要关注可读
+void Chat::UpdateInterest() {
+    bool reading = !peerClosed || shared.Sending();
+    uint32_t events = (reading ? (uint32_t)(EPOLLIN | EPOLLRDHUP) : 0u) | (sendQueue.WaitsForSocket() ? (uint32_t)EPOLLOUT : 0u);
+    if (events != socketEvents) {
+        loop.Modify(clientSocket, events);
+        socketEvents = events;
+    }
+    // 输入了退出命令：等积压的数据全部写出后再结束
+    if (exited && sendQueue.Empty()) {
+        loop.Stop();
+    }
+    // 管道模式输入结束：数据全部写出后关闭写方向，对端据此结束输出，本端继续接收直到对端关闭
+    if (pipeMode && !inputOpen && sendQueue.Empty() && !writeShutdown) {
+        if (shared.Sending()) {
+            shared.Shutdown(clientSocket);
+        } else {
+            shutdown(clientSocket, SHUT_WR);
+        }
+        writeShutdown = true;
+    }
+    if (pipeMode && writeShutdown && peerClosed) {
+        loop.Stop();
+    }
+}
 
-    if (connect(clientSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        // 非阻塞 connect 返回 -1 是正常情况，
-        // 通过 select() 判断是否连通
-        fd_set writefds;
-        FD_ZERO(&writefds);
-        FD_SET(clientSocket, &writefds);
-        timeval tv;
-        tv.tv_sec = 10; // 超时 10 秒
-        tv.tv_usec = 0;
-        int ret = select(clientSocket + 1, NULL, &writefds, NULL, &tv);
-        if(ret <= 0) {
-            std::cerr << "Error: Failed to connect to server." << std::endl;
-            return;
+// 取出输入线程已写入环中的全部数据，成批加密后合并为一次 sendmsg。发送队列到达高水位时先发送，
+// 仍未回落则停止（环随之写满，输入线程等待），之后由 EPOLLOUT 再次调用；环取空后登记休眠，由 eventfd 唤醒
+void Chat::PumpInput() {
+    bool queued = false;
+    while (inputOpen && !exited && loop.IsRunning()) {
+        if (sendQueue.IsPaused()) {
+            queued = false;
+            if (!Flush() || sendQueue.IsPaused()) {
+                return;
+            }
+        }
+        const char* data;
+        size_t length = input.Peek(data);
+        if (length == 0) {
+            if (input.AtEnd()) {
+                OnInputEnd();
+                return;
+            }
+            if (input.Park()) {
+                break;
+            }
+            continue;
         }
+        input.Consume(pipeMode ? QueuePipeInput(data, length) : QueueLines(data, length));
+        queued = true;
     }
-    std::cout << "Connected to server." << std::endl;
+    if (queued) {
+        Flush();
+    }
+}
+
+// 输入结束（例如无人值守的机器人客户端或管道写完），只停止发送，继续接收
+void Chat::OnInputEnd() {
+    if (input.Failed()) {
+        std::cerr << "Error: Failed to read from stdin." << std::endl;
+    }
+    inputOpen = false;
+    if (!pipeMode && messageLength > 0) {
+        Send(message, messageLength);
+        messageLength = 0;
+    }
+    Flush();
+}
+
+void Chat::SendBatch() {
+    if (!batch.empty()) {
+        QueueMessages(sendQueue, crypto, batch.data(), (int)batch.size());
+        batch.clear();
+    }
+}
+
+// 管道模式：最多取 PIPE_BATCH_SIZE 字节，按 PIPE_FRAME_SIZE 切成多帧作为一批加密
+size_t Chat::QueuePipeInput(const char* data, size_t length) {
+    if (length > PIPE_BATCH_SIZE) {
+        length = PIPE_BATCH_SIZE;
+    }
+    for (size_t offset = 0; offset < length; offset += PIPE_FRAME_SIZE) {
+        size_t chunk = length - offset < PIPE_FRAME_SIZE ? length - offset : PIPE_FRAME_SIZE;
+        batch.push_back({data + offset, (int)chunk});
+    }
+    SendBatch();
+    return length;
+}
+
+// 把输出缓冲区写到标准输出；标准输出是阻塞的，写不动时自然对 socket 形成背压
+void Chat::WriteOutput() {
+    size_t written = 0;
+    while (written < pipeOutputLength) {
+        ssize_t len = write(STDOUT_FILENO, pipeOutput.data() + written, pipeOutputLength - written);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error: Failed to write to stdout." << std::endl;
+            loop.Stop();
+            break;
+        }
+        written += len;
+    }
+    pipeOutputLength = 0;
 }
 
-void Chat::Send() {
-    std::cin.getline(message, MAX_MESSAGE_LENGTH);
-    char* cipherText = nullptr;
-    int cipherTextLength = -1;
+// 按行切分输入：完整的行直接引用环中的数据，攒成一批加密；上次留下的半行先在 message 中补齐。
+// 返回消费的字节数，输入了退出命令时停在该行之后
+size_t Chat::QueueLines(const char* data, size_t length) {
+    size_t offset = 0;
+    while (offset < length) {
+        size_t limit = MAX_MESSAGE_LENGTH - 1 - messageLength;
+        size_t available = length - offset < limit ? length - offset : limit;
+        const char* newline = static_cast<const char*>(memchr(data + offset, '\n', available));
+        size_t take = newline != nullptr ? newline - (data + offset) : available;
+        if (newline == nullptr && take < limit) {
+            // 行还没结束：留到下一批
+            memcpy(message + messageLength, data + offset, take);
+            messageLength += (int)take;
+            offset += take;
+            break;
+        }
+        // 超过 MAX_MESSAGE_LENGTH - 1 仍没有换行，则按最大长度截断发送
+        size_t consumed = newline != nullptr ? take + 1 : take;
+        bool more;
+        if (messageLength > 0) {
+            memcpy(message + messageLength, data + offset, take);
+            int lineLength = messageLength + (int)take;
+            messageLength = 0;
+            // message 之后会被下一段半行覆盖，这一行不能留在批中
+            more = HandleLine(message, lineLength);
+            SendBatch();
+        } else {
+            more = HandleLine(data + offset, (int)take);
+        }
+        offset += consumed;
+        if (!more) {
+            break;
+        }
+    }
+    SendBatch();
+    return offset;
+}
 
-    if (strcmp(message, EXIT_COMMAND) == 0) {
-        isRunning = false;
+// 普通消息加入本批；命令先把本批发出再执行。返回 false 表示输入了退出命令
+bool Chat::HandleLine(const char* line, int length) {
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+    int prefixLength = (int)strlen(FILE_SEND_COMMAND);
+    if (length >= prefixLength && memcmp(line, FILE_SEND_COMMAND, prefixLength) == 0) {
+        SendBatch();
+        std::string path(line + prefixLength, length - prefixLength);
+        if (fileSender.Start(path.c_str(), sendQueue, crypto)) {
+            PumpFile();
+        }
+        return true;
+    }
+    batch.push_back({line, length});
+    if (length == (int)strlen(EXIT_COMMAND) && memcmp(line, EXIT_COMMAND, length) == 0) {
+        SendBatch();
+        fileSender.Finish();
         exited = true;
+        return false;
     }
+    return true;
+}
 
-    des.Encrypt(message, strlen(message), cipherText, cipherTextLength);
-    if (send(clientSocket, cipherText, cipherTextLength, 0) < 0) {
-        std::cerr << "Error: Failed to send message." << std::endl;
-        delete[] cipherText;
+void Chat::OnSocket(uint32_t events) {
+    if (events & EPOLLERR) {
+        // 错误队列中可能只是零拷贝完成通知，而不是真正的连接错误
+        sendQueue.ReapCompletions(clientSocket);
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        getsockopt(clientSocket, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+        if (error != 0) {
+            events |= EPOLLHUP;
+        }
+    }
+    // 对端已半关闭后又出现 EPOLLHUP：连接已完全关闭，剩余数据无法再发送
+    if (peerClosed && (events & EPOLLHUP)) {
+        loop.Stop();
+        return;
+    }
+    if (shared.Sending() && (events & EPOLLIN)) {
+        events |= EPOLLOUT;
+    }
+    if (events & EPOLLOUT) {
+        if (!Flush()) {
+            return;
+        }
+        PumpFile();
+        PumpInput();
+    }
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) {
+        OnReceive();
+    }
+}
+
+// 文件发送由 EPOLLOUT 驱动：队列回落到低水位以下时继续排入数据块，全部写出后报告速率
+void Chat::PumpFile() {
+    if (!fileSender.Active()) {
+        return;
+    }
+    if (!fileSender.Pump(sendQueue, crypto, clientSocket)) {
+        std::cerr << "Error: Failed to send file." << std::endl;
+        fileSender.Finish();
+        loop.Stop();
+        return;
+    }
+    if (!Flush()) {
         return;
     }
-    delete[] cipherText;
+    if (fileSender.Done() && sendQueue.Empty()) {
+        fileSender.Finish();
+    }
 }
 
-void Chat::ReceiveThread() {
+void Chat::OnReceive() {
     const char* info = isServer ? "Client" : "Server";
-    char* plainText = nullptr;
-    int plainTextLength = -1;
-    
-    while (isRunning) {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(clientSocket, &readfds);
-        timeval tv;
-        tv.tv_sec = 1;  // 超时 1 秒，避免长时间阻塞
-        tv.tv_usec = 0;
-        int ret = select(clientSocket + 1, &readfds, NULL, NULL, &tv);
-        if(ret > 0 && FD_ISSET(clientSocket, &readfds)) {
-            memset(buffer, 0, sizeof(buffer));
-            ssize_t len = recv(clientSocket, buffer, sizeof(buffer), 0);
-            if (len <= 0) {
-                isRunning = false;
-                if (!exited) {
-                    std::cerr << "Error: Failed to receive message or connection closed." << std::endl;
+
+    ssize_t len = reader.Fill(clientSocket);
+    if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (len <= 0) {
+        if (pipeMode && len == 0) {
+            // 对端写完并关闭写方向：输出剩余数据，本端输入也发送完毕后再结束
+            WriteOutput();
+            peerClosed = true;
+            UpdateInterest();
+            return;
+        }
+        if (!exited) {
+            std::cerr << "Error: Failed to receive message or connection closed." << std::endl;
+        }
+        loop.Stop();
+        return;
+    }
+
+    char* cipherText;
+    uint32_t cipherTextLength;
+    uint8_t flags;
+    while (reader.Next(cipherText, cipherTextLength, flags)) {
+        // 中继服务器在连接空闲时发送的保活帧
+        if (flags & FRAME_FLAG_KEEPALIVE) {
+            continue;
+        }
+        // 文件数据直接解密到输出文件中
+        if (flags & FRAME_FLAG_FILE_DATA) {
+            if (!fileReceiver.Write(crypto, cipherText, cipherTextLength, flags)) {
+                std::cerr << "Error: Malformed file data received." << std::endl;
+                fileReceiver.Abort();
+                loop.Stop();
+                return;
+            }
+            if (fileReceiver.Done()) {
+                fileReceiver.Finish();
+            }
+            continue;
+        }
+
+        // 原地解密之前先把密文帧追加到日志（只是一次内存拷贝）
+        if (journal.IsOpen()) {
+            char header[FRAME_HEADER_SIZE];
+            EncodeFrameHeader(header, cipherTextLength, flags);
+            journal.Append(header, FRAME_HEADER_SIZE, cipherText, cipherTextLength);
+        }
+
+        // 管道模式：未压缩的帧直接解密进输出缓冲区，整批帧处理完才写一次标准输出
+        if (pipeMode && (flags & ~FRAME_FLAGS_TRANSPORT) == 0) {
+            if (pipeOutputLength + cipherTextLength > pipeOutput.size()) {
+                WriteOutput();
+                if (cipherTextLength > pipeOutput.size()) {
+                    pipeOutput.resize(cipherTextLength);
                 }
-                break;
             }
-            plainText = nullptr;
-            plainTextLength = -1;
-            des.Decrypt(buffer, len, plainText, plainTextLength);
-        
-            // 检查退出命令
-            if (strcmp(plainText, EXIT_COMMAND) == 0) {
-                isRunning = false;
-                delete[] plainText;
-                std::cout << info << " exited." << std::endl;
-                break;
+            char* text = cipherText;
+            int plainTextLength = (flags & FRAME_FLAG_COMPRESSED)
+                ? OpenMessage(crypto, cipherText, cipherTextLength, flags, text)
+                : OpenMessageTo(crypto, cipherText, cipherTextLength, flags, pipeOutput.data() + pipeOutputLength,
+                                (int)(pipeOutput.size() - pipeOutputLength));
+            if (plainTextLength < 0) {
+                std::cerr << "Error: Malformed or forged frame received." << std::endl;
+                loop.Stop();
+                return;
             }
-        
-            std::cout << info << ": " << plainText << std::endl;
-            delete[] plainText;
+            if (text != cipherText) {
+                // 压缩帧解压在线程本地缓冲区中，长度可能超过密文
+                if (pipeOutputLength + plainTextLength > pipeOutput.size()) {
+                    WriteOutput();
+                    if ((size_t)plainTextLength > pipeOutput.size()) {
+                        pipeOutput.resize(plainTextLength);
+                    }
+                }
+                memcpy(pipeOutput.data() + pipeOutputLength, text, plainTextLength);
+            }
+            pipeOutputLength += plainTextLength;
+            continue;
         }
-        else if(ret < 0) {
-            isRunning = false;
-            std::cerr << "Error: select() failed." << std::endl;
-            break;
+
+        // 帧在接收缓冲区内原地校验并解密，不再为每条消息分配明文缓冲区
+        char* text;
+        int plainTextLength = OpenMessage(crypto, cipherText, cipherTextLength, flags, text);
+        if (plainTextLength < 0) {
+            std::cerr << "Error: Malformed or forged frame received." << std::endl;
+            loop.Stop();
+            return;
+        }
+        if (flags & FRAME_FLAG_FILE_OFFER) {
+            if (!fileReceiver.Begin(text, plainTextLength)) {
+                std::cerr << "Error: Rejected file offer." << std::endl;
+            } else if (fileReceiver.Done()) {
+                fileReceiver.Finish();
+            }
+            continue;
+        }
+        std::string plainText(text, plainTextLength);
+
+        // 检查退出命令
+        if (plainText == EXIT_COMMAND) {
+            std::cout << info << " exited." << std::endl;
+            loop.Stop();
+            return;
         }
+
+        std::cout << info << ": " << plainText << '\n';
+    }
+    if (reader.Oversized()) {
+        std::cerr << "Error: Oversized frame received." << std::endl;
+        loop.Stop();
+        return;
+    }
+    // 一批消息只刷新一次输出
+    if (pipeMode) {
+        WriteOutput();
+    } else {
+        std::cout.flush();
+    }
+}
+
+// 单线程聊天循环：标准输入与 socket 共用一个 epoll，无需接收线程与 1 秒轮询。
+// 在握手协程完成后调用，只注册处理函数，循环本身由 RunServer / RunClient 运行
+void Chat::StartChat() {
+    const char* journalDir = getenv(JOURNAL_DIR_ENV);
+    if (journalDir != nullptr && journal.Open(journalDir)) {
+        std::cout << "Journaling received messages to " << journalDir << "." << std::endl;
+    }
+    sendQueue.EnableZeroCopy(clientSocket);
+    StartSharedMemory();
+    loop.Add(clientSocket, EPOLLIN | EPOLLRDHUP, [this](uint32_t events) { OnSocket(events); });
+    if (input.Start(STDIN_FILENO)) {
+        loop.Add(input.NotifyFd(), EPOLLIN, [this](uint32_t) {
+            input.ClearNotify();
+            PumpInput();
+        });
+    } else {
+        inputOpen = false;
+    }
+    UpdateInterest();
+    PumpInput();
+    Metrics::Add(METRIC_ACTIVE_SESSIONS);
+    chatting = true;
+}
+
+// 协商了共享内存时映射环，对方也映射后 SendQueue / FrameReader 自动切换；
+// 事件循环在最近一次活动后忙轮询一段时间，期间收发消息不经过系统调用
+void Chat::StartSharedMemory() {
+    if (crypto.sharedMemoryId == 0 || !shared.Open(crypto.sharedMemoryId, isServer)) {
+        return;
+    }
+    sendQueue.UseSharedMemory(&shared);
+    reader.UseSharedMemory(&shared);
+    loop.SetPoller([this]() { return PollShared(); },
+                   [this]() { return shared.Park(true, !sendQueue.Empty()); }, SharedMemoryChannel::SpinNanos());
+    std::cout << "Shared memory transport enabled." << std::endl;
+}
+
+bool Chat::PollShared() {
+    if (!shared.Pending(true, !sendQueue.Empty())) {
+        return false;
+    }
+    OnSocket(EPOLLIN);
+    return true;
+}
+
+void Chat::FinishChat() {
+    if (!chatting) {
+        return;
+    }
+    chatting = false;
+    Metrics::Add(METRIC_ACTIVE_SESSIONS, (uint64_t)-1);
+    input.Stop();
+
+    const SendQueueStats& stats = sendQueue.GetStats();
+    if (stats.pauses > 0) {
+        std::cout << "Backpressure: paused " << stats.pauses << " times, "
+                  << stats.pausedNanos / 1000000 << " ms in total, "
+                  << stats.partialWrites << " partial writes." << std::endl;
     }
+    journal.Close();
+    Close();
+    shared.Close();
+}
+
+void Chat::Stop() {
+    loop.Stop();
 }
 
 void Chat::Close() {
-    isRunning = false;
+    loop.Stop();
     if (serverSocket >= 0) {
         close(serverSocket);
+        serverSocket = -1;
     }
     if (clientSocket >= 0) {
         close(clientSocket);
-    }
-    if (receiveThread.joinable()) {
-        receiveThread.join();
+        clientSocket = -1;
     }
 }
 
@@ -164,6 +518,9 @@ void Chat::RunServer() {
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_port = htons(serverPort);
     serverAddr.sin_addr.s_addr = INADDR_ANY; // 接受任意 IP
+    // 脚本中反复启动时不必等待上一次连接的 TIME_WAIT 结束
+    int reuse = 1;
+    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
 
     if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
         std::cerr << "Error: Failed to bind." << std::endl;
@@ -175,151 +532,135 @@ void Chat::RunServer() {
         return;
     }
     
-    // 使用 select() 等待连接到来
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(serverSocket, &readfds);
-    timeval tv;
-    tv.tv_sec = 10;   // 等待10秒
-    tv.tv_usec = 0;
-    int ret = select(serverSocket + 1, &readfds, NULL, NULL, &tv);
-    if(ret <= 0) {
-        std::cerr << "Error: No incoming connection within timeout." << std::endl;
-        return;
-    }
-    
-    struct sockaddr_in clientAddr;
-    socklen_t clientAddrLen = sizeof(clientAddr);
-    clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
-    if (clientSocket < 0) {
-        std::cerr << "Error: Failed to accept." << std::endl;
-        return;
-    } else {
-        std::cout << "Client connected." << std::endl;
-    }
-    // 设置 clientSocket 为非阻塞模式
-    setNonBlocking(clientSocket);
+    // 等待连接与密钥交换都在协程中进行，挂起时事件循环照常运行
+    Spawn(AcceptPeer());
+    loop.Run();
+    FinishChat();
+}
 
-    // RSA 密钥生成（最多重试 3 次）
-    const int N_RETRY = 3;
-    for (int i = 0; i < N_RETRY; i++) {
-        if (rsa.GenerateKey()) {
-            std::cout << "RSA key generated successfully." << std::endl;
-            break;
-        }
-        if (i == N_RETRY - 1) {
-            std::cerr << "Error: Failed to generate RSA key." << std::endl;
-            std::cerr << "Server Exiting..." << std::endl;
-            return;
+Task<void> Chat::AcceptPeer() {
+    AsyncSocket listener(loop, serverSocket);
+    clientSocket = co_await listener.Accept(CHAT_ACCEPT_TIMEOUT_MS);
+    if (clientSocket < 0) {
+        if (errno == ETIMEDOUT) {
+            std::cerr << "Error: No incoming connection within timeout." << std::endl;
         } else {
-            std::cerr << "Warning: Failed to generate RSA key. Retrying..." << std::endl;
+            std::cerr << "Error: Failed to accept." << std::endl;
         }
+        loop.Stop();
+        co_return;
+    }
+    listener.Detach();
+    std::cout << "Client connected." << std::endl;
+    uint64_t handshakeStart = Metrics::NowNanos();
+
+    // RSA 密钥生成（最多重试 RSA_KEYGEN_RETRY 次）
+    if (!GenerateServerKey(rsa)) {
+        std::cerr << "Error: Failed to generate RSA key." << std::endl;
+        std::cerr << "Server Exiting..." << std::endl;
+        loop.Stop();
+        co_return;
     }
+    std::cout << "RSA key generated successfully." << std::endl;
     
     // 显示 RSA 详细配置信息
     rsa.PrintConfig();
     
-    // 发送公钥和模数给客户端
-    uint64_t e = rsa.GetPublicKey();
-    uint64_t n = rsa.GetModulus();
-    if (send(clientSocket, reinterpret_cast<const char*>(&e), sizeof(e), 0) < 0) {
-        std::cerr << "Error: Failed to send public key." << std::endl;
-        return;
-    }
-    if (send(clientSocket, reinterpret_cast<const char*>(&n), sizeof(n), 0) < 0) {
-        std::cerr << "Error: Failed to send modulus." << std::endl;
-        return;
+    // 发送公钥和模数给客户端，等待客户端发送 DES 密钥（加密后的 DES key）
+    AsyncSocket peer(loop, clientSocket);
+    // 只向本机上的对端提供共享内存
+    uint64_t offered = HANDSHAKE_FEATURES_SUPPORTED;
+    if (!SharedMemoryChannel::IsLocalPeer(clientSocket)) {
+        offered &= ~(uint64_t)HANDSHAKE_FEATURE_SHARED_MEMORY;
     }
-    
-    // 使用 select() 等待客户端发送 DES 密钥（加密后的 DES key）
-    FD_ZERO(&readfds);
-    FD_SET(clientSocket, &readfds);
-    tv.tv_sec = 5;  // 等待5秒
-    tv.tv_usec = 0;
-    ret = select(clientSocket + 1, &readfds, NULL, NULL, &tv);
-    if(ret <= 0) {
-        std::cerr << "Error: Timeout waiting for DES key." << std::endl;
-        return;
+    HandshakeStatus status = co_await AcceptHandshake(peer, rsa, crypto, CHAT_HANDSHAKE_TIMEOUT_MS, offered);
+    peer.Detach();
+    if (status != HANDSHAKE_DONE) {
+        if (status == HANDSHAKE_SEND_FAILED) {
+            std::cerr << "Error: Failed to send public key." << std::endl;
+        } else if (status == HANDSHAKE_TIMEOUT) {
+            std::cerr << "Error: Timeout waiting for DES key." << std::endl;
+        } else {
+            std::cerr << "Error: Failed to receive DES key." << std::endl;
+        }
+        loop.Stop();
+        co_return;
     }
+    Metrics::Add(METRIC_HANDSHAKES);
+    Metrics::Record(METRIC_HANDSHAKE_NS, Metrics::NowNanos() - handshakeStart);
     
-    uint64_t desKey_enc[8];
-    if (recv(clientSocket, reinterpret_cast<char*>(desKey_enc), sizeof(desKey_enc), 0) < 0) {
-        std::cerr << "Error: Failed to receive DES key." << std::endl;
-        return;
+    std::cout << "Key exchange completed, session cipher: " << SessionCipherName(crypto) << "." << std::endl;
+    if (crypto.authenticated) {
+        std::cout << "Message authentication enabled." << std::endl;
     }
-    
-    uint8_t desKey[8];
-    for (int i = 0; i < 8; i++) {
-        desKey[i] = rsa.Decrypt(desKey_enc[i]);
+    if (crypto.compressed) {
+        std::cout << "Compression enabled." << std::endl;
     }
-    des.SetKey((char*)desKey);
-    
-    std::cout << "Key exchange completed." << std::endl;
     std::cout << "You can start chatting now." << std::endl;
     
-    auto chatLoop = [this]() {
-        isRunning = true;
-        receiveThread = std::thread(&Chat::ReceiveThread, this);
-        while (isRunning) {
-            Send();
-        }
-        Close();
-    };
-    
-    chatLoop();
+    StartChat();
 }
 
 void Chat::RunClient() {
     isServer = false;
-    Connect();
-    
-    des.RandomGenKey();
-    uint8_t* desKey = des.GetKey();
-    
-    // 等待服务器发来公钥和模数
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(clientSocket, &readfds);
-    timeval tv;
-    tv.tv_sec = 5;   // 等待5秒
-    tv.tv_usec = 0;
-    int ret = select(clientSocket + 1, &readfds, NULL, NULL, &tv);
-    if(ret <= 0) {
-        std::cerr << "Error: Timeout waiting for public key and modulus." << std::endl;
-        return;
+    Spawn(ConnectPeer());
+    loop.Run();
+    FinishChat();
+}
+
+Task<void> Chat::ConnectPeer() {
+    clientSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (clientSocket < 0) {
+        std::cerr << "Error: Failed to create socket." << std::endl;
+        loop.Stop();
+        co_return;
+    }
+    // 设置客户端 socket 为非阻塞模式
+    setNonBlocking(clientSocket);
+
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(serverPort);
+    serverAddr.sin_addr.s_addr = inet_addr(serverIp);
+
+    AsyncSocket peer(loop, clientSocket);
+    if (!co_await peer.Connect(serverAddr, CHAT_CONNECT_TIMEOUT_MS)) {
+        std::cerr << "Error: Failed to connect to server." << std::endl;
+        loop.Stop();
+        co_return;
     }
+    std::cout << "Connected to server." << std::endl;
+    uint64_t handshakeStart = Metrics::NowNanos();
     
-    uint64_t e, n;
-    if (recv(clientSocket, reinterpret_cast<char*>(&e), sizeof(e), 0) < 0) {
-        std::cerr << "Error: Failed to receive public key." << std::endl;
-        return;
+    // 等待服务器发来公钥和模数，回送加密后的 DES 会话密钥
+    uint64_t features = HANDSHAKE_FEATURES_REQUESTED;
+    if (SharedMemoryChannel::IsLocalPeer(clientSocket)) {
+        features |= HANDSHAKE_FEATURE_SHARED_MEMORY;
     }
-    if (recv(clientSocket, reinterpret_cast<char*>(&n), sizeof(n), 0) < 0) {
-        std::cerr << "Error: Failed to receive modulus." << std::endl;
-        return;
+    HandshakeStatus status = co_await ConnectHandshake(peer, crypto, features, CHAT_HANDSHAKE_TIMEOUT_MS);
+    peer.Detach();
+    if (status != HANDSHAKE_DONE) {
+        if (status == HANDSHAKE_TIMEOUT) {
+            std::cerr << "Error: Timeout waiting for public key and modulus." << std::endl;
+        } else if (status == HANDSHAKE_RECV_FAILED) {
+            std::cerr << "Error: Failed to receive public key." << std::endl;
+        } else {
+            std::cerr << "Error: Failed to send DES key." << std::endl;
+        }
+        loop.Stop();
+        co_return;
     }
+    Metrics::Add(METRIC_HANDSHAKES);
+    Metrics::Record(METRIC_HANDSHAKE_NS, Metrics::NowNanos() - handshakeStart);
     
-    uint64_t desKey_enc[8];
-    for (int i = 0; i < 8; i++) {
-        desKey_enc[i] = RSA::Encrypt((uint32_t)desKey[i], e, n);
+    std::cout << "Key exchange completed, session cipher: " << SessionCipherName(crypto) << "." << std::endl;
+    if (crypto.authenticated) {
+        std::cout << "Message authentication enabled." << std::endl;
     }
-    delete[] desKey;
-    
-    if (send(clientSocket, reinterpret_cast<const char*>(desKey_enc), sizeof(desKey_enc), 0) < 0) {
-        std::cerr << "Error: Failed to send DES key." << std::endl;
-        return;
+    if (crypto.compressed) {
+        std::cout << "Compression enabled." << std::endl;
     }
     
-    std::cout << "Key exchange completed." << std::endl;
-    
-    auto chatLoop = [this]() {
-        isRunning = true;
-        receiveThread = std::thread(&Chat::ReceiveThread, this);
-        while (isRunning) {
-            Send();
-        }
-        Close();
-    };
-    
-    chatLoop();
-}
\ No newline at end of file
+    StartChat();
+}
@@ -0,0 +1,1047 @@
+// Server
+#include "server.h"
+#include "Trace.h"
+#include "Journal.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+
+Server::Server(int port, ServerMode mode) {
+    this->port = port;
+    this->mode = mode;
+    listenSocket = -1;
+    signalFd = -1;
+    handoffSocket = -1;
+    handedOff = false;
+    handshakeJobs = 0;
+    batching = true;
+    sessionCount = 0;
+    handshakes = 0;
+    messages = 0;
+    dropped = 0;
+    timeouts = 0;
+    evictions = 0;
+    TimerWheel::Init(&keyTimer, [](void* context) {
+        Server* server = static_cast<Server*>(context);
+        server->RotateKeyInBackground();
+        server->loop.Timers().Schedule(&server->keyTimer, TIMER_TICKS(SERVER_KEY_ROTATION_MS));
+    }, this);
+    // 只为唤醒事件循环，排队的握手在本轮末尾处理
+    TimerWheel::Init(&admissionTimer, [](void*) {}, this);
+}
+
+Server::~Server() {
+    for (auto& session : sessions) {
+        if (session) {
+            // 交接之后共享内存对象归新进程所有，只解除本进程的映射，不能删除名字
+            if (handedOff && session->shared) {
+                session->shared->Detach();
+            }
+            CloseSession(session.get());
+        }
+    }
+    if (listenSocket >= 0) {
+        close(listenSocket);
+    }
+    if (signalFd >= 0) {
+        close(signalFd);
+    }
+    if (handoffSocket >= 0) {
+        close(handoffSocket);
+    }
+    loop.Timers().Cancel(&keyTimer);
+}
+
+// 生成新的服务器密钥；之后的握手使用新密钥，进行中的握手仍持有旧密钥。
+// 只在启动时（事件循环运行之前）直接调用，运行中的更换见 RotateKeyInBackground
+bool Server::RotateKey() {
+    auto next = std::make_shared<ServerKey>();
+    if (!GenerateServerKey(next->rsa)) {
+        std::cerr << "Error: Failed to generate RSA key." << std::endl;
+        return false;
+    }
+    next->hello = {next->rsa.GetPublicKey(), next->rsa.GetModulus(), HANDSHAKE_FEATURES_SUPPORTED};
+    key = std::move(next);
+    return true;
+}
+
+// 定期更换：新密钥在工作线程上生成，生成期间照常使用旧密钥
+void Server::RotateKeyInBackground() {
+    auto next = std::make_shared<ServerKey>();
+    bool submitted = workers.Submit([next]() {
+        if (GenerateServerKey(next->rsa)) {
+            next->hello = {next->rsa.GetPublicKey(), next->rsa.GetModulus(), HANDSHAKE_FEATURES_SUPPORTED};
+        }
+    }, [this, next]() {
+        if (next->hello.n == 0) {
+            std::cerr << "Error: Failed to generate RSA key, keeping the current one." << std::endl;
+            return;
+        }
+        key = next;
+    });
+    if (!submitted) {
+        std::cerr << "Error: Crypto workers are busy, keeping the current RSA key." << std::endl;
+    }
+}
+
+bool Server::Listen() {
+    listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenSocket < 0) {
+        std::cerr << "Error: Failed to create socket." << std::endl;
+        return false;
+    }
+    int one = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(listenSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        std::cerr << "Error: Failed to bind." << std::endl;
+        return false;
+    }
+    if (listen(listenSocket, SERVER_LISTEN_BACKLOG) < 0) {
+        std::cerr << "Error: Failed to listen." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Server::Run() {
+    // 大量并发会话需要提高文件描述符上限
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    const char* path = getenv(HANDOFF_SOCKET_ENV);
+    int previous = path != nullptr ? HandoffConnect(path) : -1;
+    if (previous >= 0) {
+        // 热重启：监听 socket、服务器密钥与全部会话都从正在运行的旧进程接过来
+        bool resumed = TakeOver(previous);
+        close(previous);
+        if (!resumed) {
+            return false;
+        }
+    } else {
+        // 所有会话共用一对 RSA 密钥：握手时不再逐个生成，会话也不必各自保存私钥
+        if (!RotateKey()) {
+            return false;
+        }
+        if (!Listen() || !datagrams.Open(port)) {
+            return false;
+        }
+    }
+    loop.Timers().Schedule(&keyTimer, TIMER_TICKS(SERVER_KEY_ROTATION_MS));
+    loop.Add(listenSocket, EPOLLIN, [this](uint32_t) { OnAccept(); });
+    loop.Add(datagrams.Fd(), EPOLLIN, [this](uint32_t) { OnDatagrams(); });
+    loop.Add(workers.Fd(), EPOLLIN, [this](uint32_t) { workers.Complete(); });
+    if (path != nullptr) {
+        handoffSocket = HandoffListen(path);
+        if (handoffSocket >= 0) {
+            handoffPath = path;
+            loop.Add(handoffSocket, EPOLLIN, [this](uint32_t) { OnHandoff(); });
+            std::cout << "Waiting for hot restart on " << path << "." << std::endl;
+        }
+    }
+
+    batching = CryptoBatch::SelfTest();
+    if (!batching) {
+        std::cerr << "Error: Batched DES self test failed, encrypting each session separately." << std::endl;
+    }
+    // 各回调只把消息排入发送队列，整轮事件处理完后统一加密并 Flush，一批加密覆盖本轮涉及的所有会话；
+    // 已建立会话的数据发出之后才处理排队的握手
+    loop.SetRoundEnd([this]() {
+        if (!handedOff) {
+            FlushDirty();
+            AdmitHandshakes();
+            FlushDirty();
+        }
+    });
+
+    const char* dir = getenv(CAPTURE_DIR_ENV);
+    if (dir != nullptr) {
+        if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+            std::cerr << "Error: Failed to create capture directory " << dir << "." << std::endl;
+        } else {
+            captureDir = dir;
+            std::cout << "Capturing received traffic to " << dir << "." << std::endl;
+        }
+    }
+
+    // SIGINT / SIGTERM 通过 signalfd 进入事件循环，优雅退出
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd >= 0) {
+        loop.Add(signalFd, EPOLLIN, [this](uint32_t) { Stop(); });
+    }
+
+    std::cout << "Server listening on port " << port << " ("
+              << (mode == SERVER_MODE_ECHO ? "echo" : "relay") << " mode)." << std::endl;
+    PrintMemory();
+    loop.Run();
+    PrintMemory();
+    // 交接之后路径已属于新进程
+    if (handedOff) {
+        std::cout << "Handed over " << sessionCount << " sessions to the new process." << std::endl;
+    } else if (handoffSocket >= 0) {
+        unlink(handoffPath.c_str());
+    }
+
+    std::cout << "Server stopped: " << handshakes << " handshakes, " << messages << " messages, "
+              << dropped << " dropped, " << timeouts << " handshake timeouts, " << evictions << " idle evictions." << std::endl;
+    return true;
+}
+
+void Server::Stop() {
+    loop.Stop();
+}
+
+// 每轮至多接受 SERVER_ACCEPT_BATCH 个连接（监听 socket 是水平触发的，其余留到下一轮），
+// 准入队列已满或来源超过速率的连接立即关闭，不为它做任何握手工作
+void Server::OnAccept() {
+    for (int accepted = 0; accepted < SERVER_ACCEPT_BATCH; accepted++) {
+        sockaddr_in peer;
+        socklen_t peerLength = sizeof(peer);
+        int fd = accept4(listenSocket, (sockaddr*)&peer, &peerLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "Error: Failed to accept." << std::endl;
+            }
+            return;
+        }
+        uint64_t now = Metrics::NowNanos();
+        if (handshakeQueue.size() >= SERVER_MAX_QUEUED_HANDSHAKES ||
+            !admission.AdmitSource(peer.sin_family == AF_INET ? peer.sin_addr.s_addr : 0, now)) {
+            close(fd);
+            Metrics::Add(METRIC_HANDSHAKES_REJECTED);
+            continue;
+        }
+
+        auto session = NewSession(fd);
+        session->handshake = std::make_unique<SessionHandshake>();
+        session->handshake->acceptTime = now;
+        session->handshake->keyLength = 0;
+        session->handshake->queued = false;
+        session->handshake->waited = false;
+        session->handshake->decrypting = false;
+        session->handshake->peerClosed = false;
+        session->handshake->job = 0;
+        session->handshake->key = key;
+
+        // 只向本机上的客户端提供共享内存
+        HandshakeHello hello = key->hello;
+        if (!SharedMemoryChannel::IsLocalPeer(fd)) {
+            hello.features &= ~(uint64_t)HANDSHAKE_FEATURE_SHARED_MEMORY;
+        }
+        session->handshake->features = hello.features;
+        if (TRACE_CALL("send", send(fd, &hello, sizeof(hello), MSG_NOSIGNAL)) != (ssize_t)sizeof(hello)) {
+            close(fd);
+            continue;
+        }
+        session->sendQueue.EnableZeroCopy(fd);
+        Session* raw = AddSession(std::move(session));
+        loop.Timers().Schedule(&raw->timer, TIMER_TICKS(SERVER_HANDSHAKE_TIMEOUT_MS));
+    }
+}
+
+// 新连接与热重启接过来的连接共用：初始化为尚未握手、正在读取的状态
+std::unique_ptr<Session> Server::NewSession(int fd) {
+    auto session = std::make_unique<Session>();
+    session->fd = fd;
+    session->state = SESSION_AWAIT_KEY;
+    session->events = EPOLLIN | EPOLLRDHUP;
+    session->readPaused = false;
+    session->dirty = false;
+    session->server = this;
+    session->lastReceive = session->lastSend = (uint32_t)loop.Timers().Now();
+    TimerWheel::Init(&session->timer, [](void* context) {
+        Session* session = static_cast<Session*>(context);
+        session->server->OnSessionTimer(session);
+    }, session.get());
+    return session;
+}
+
+// 登记到会话表并开始关注连接上的事件
+Session* Server::AddSession(std::unique_ptr<Session> session) {
+    Session* raw = session.get();
+    int fd = raw->fd;
+    if ((size_t)fd >= sessions.size()) {
+        sessions.resize(fd + 1);
+    }
+    sessions[fd] = std::move(session);
+    sessionCount++;
+    Metrics::Add(METRIC_ACTIVE_SESSIONS);
+    Metrics::Add(METRIC_SESSION_BYTES, sizeof(Session) + (raw->handshake ? sizeof(SessionHandshake) : 0));
+    loop.Add(fd, raw->events, [this, raw](uint32_t events) { OnSession(raw, events); });
+    return raw;
+}
+
+void Server::OnSession(Session* session, uint32_t events) {
+    if (events & EPOLLERR) {
+        // 错误队列中可能只是零拷贝完成通知
+        session->sendQueue.ReapCompletions(session->fd);
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        getsockopt(session->fd, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+        if (error != 0) {
+            CloseSession(session);
+            return;
+        }
+    }
+    // 经共享内存发送时门铃也可能表示环中腾出了空间
+    if (session->shared && session->shared->Sending() && (events & EPOLLIN)) {
+        events |= EPOLLOUT;
+    }
+    bool alive = true;
+    if (events & EPOLLOUT) {
+        alive = FlushSession(session);
+    }
+    if (alive && (events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))) {
+        if (session->readPaused && session->shared) {
+            // 暂停读取时环中的数据留着，只读掉门铃
+            alive = session->shared->DrainDoorbells(session->fd);
+        } else {
+            alive = session->state == SESSION_AWAIT_KEY ? OnKeyMessage(session, events) : OnFrames(session);
+        }
+    }
+    if (!alive) {
+        CloseSession(session);
+    }
+}
+
+// 只读取密钥报文剩余的字节，之后的数据留给帧解析
+bool Server::OnKeyMessage(Session* session, uint32_t events) {
+    SessionHandshake* handshake = session->handshake.get();
+    // 排队或解密中：连接断开（HUP）才放弃握手；对方只是关闭了发送方向（RDHUP）时，
+    // 密钥报文之后的帧可能还在缓冲区里，记下来并停止关注（电平触发下会一直报告），建立后再处理
+    if (handshake->queued || handshake->decrypting) {
+        if (events & EPOLLHUP) {
+            return false;
+        }
+        handshake->peerClosed = true;
+        session->events = 0;
+        loop.Modify(session->fd, session->events);
+        return true;
+    }
+    char* dst = reinterpret_cast<char*>(&handshake->keyMessage) + handshake->keyLength;
+    ssize_t len = TRACE_CALL("recv", recv(session->fd, dst, sizeof(HandshakeKey) - handshake->keyLength, 0));
+    if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return true;
+    }
+    if (len <= 0) {
+        return false;
+    }
+    handshake->keyLength += (int)len;
+    if (handshake->keyLength < (int)sizeof(HandshakeKey)) {
+        return true;
+    }
+    if (handshakeQueue.size() >= SERVER_MAX_QUEUED_HANDSHAKES) {
+        Metrics::Add(METRIC_HANDSHAKES_REJECTED);
+        return false;
+    }
+    QueueHandshake(session);
+    return true;
+}
+
+// 密钥报文已收齐：不再读取（之后的数据留给帧解析），只关注对方关闭（见 OnKeyMessage），等本轮末尾按令牌处理
+void Server::QueueHandshake(Session* session) {
+    session->handshake->queued = true;
+    handshakeQueue.push_back(session);
+    session->events = EPOLLRDHUP;
+    loop.Modify(session->fd, session->events);
+}
+
+// 每轮至多把 SERVER_HANDSHAKES_PER_ROUND 个排队的握手交给工作线程，每个消耗一个全局令牌；
+// 处理不完时在下一个令牌补充时醒来（工作线程占满时由完成通知唤醒）
+void Server::AdmitHandshakes() {
+    if (handshakeQueue.empty()) {
+        return;
+    }
+    uint64_t now = Metrics::NowNanos();
+    for (int i = 0; i < SERVER_HANDSHAKES_PER_ROUND && !handshakeQueue.empty() &&
+                    workers.InFlight() < CRYPTO_WORKERS_CAPACITY && admission.Take(now); i++) {
+        Session* session = handshakeQueue.front();
+        handshakeQueue.pop_front();
+        session->handshake->queued = false;
+        Metrics::Add(METRIC_HANDSHAKES_ADMITTED);
+        if (!StartHandshake(session)) {
+            CloseSession(session);
+        }
+    }
+    if (handshakeQueue.empty()) {
+        return;
+    }
+    for (Session* session : handshakeQueue) {
+        if (!session->handshake->waited) {
+            session->handshake->waited = true;
+            Metrics::Add(METRIC_HANDSHAKES_QUEUED);
+        }
+    }
+    loop.Timers().Schedule(&admissionTimer, TIMER_TICKS(admission.NanosUntilToken(now) / 1000000));
+}
+
+// 会话密钥的 RSA 解密与密钥编排交给工作线程，任务只持有密钥报文与服务器密钥的副本；
+// 完成前会话只关注对方关闭，期间关闭的会话其结果被丢弃
+bool Server::StartHandshake(Session* session) {
+    SessionHandshake* handshake = session->handshake.get();
+    handshake->decrypting = true;
+    handshake->job = ++handshakeJobs;
+    auto result = std::make_shared<HandshakeResult>();
+    std::shared_ptr<ServerKey> serverKey = handshake->key;
+    HandshakeKey keyMessage = handshake->keyMessage;
+    uint64_t offered = handshake->features;
+    int fd = session->fd;
+    uint64_t job = handshake->job;
+    return workers.Submit([result, serverKey, keyMessage, offered]() {
+        result->features = SelectFeatures(keyMessage.features, offered);
+        DecryptSessionKey(serverKey->rsa, keyMessage, SessionKeyLength(result->features), result->sessionKey);
+        SetupSessionCrypto(result->crypto, result->sessionKey, result->features, true);
+    }, [this, fd, job, result]() { OnHandshakeDone(fd, job, *result); });
+}
+
+void Server::OnHandshakeDone(int fd, uint64_t job, HandshakeResult& result) {
+    // 会话可能已经关闭，fd 也可能已被新的连接复用
+    if ((size_t)fd >= sessions.size() || !sessions[fd] || !sessions[fd]->handshake || sessions[fd]->handshake->job != job) {
+        return;
+    }
+    Session* session = sessions[fd].get();
+    session->crypto = std::move(result.crypto);
+    if (!FinishHandshake(session, result.sessionKey, result.features)) {
+        CloseSession(session);
+    }
+}
+
+// 工作线程算好会话密码之后建立会话
+bool Server::FinishHandshake(Session* session, const uint8_t* sessionKey, uint64_t features) {
+    SessionHandshake* handshake = session->handshake.get();
+    bool peerClosed = handshake->peerClosed;
+    if (session->crypto.aes) {
+        Metrics::Add(METRIC_SESSION_BYTES, sizeof(AesOp));
+    }
+    StartDatagram(session);
+    if (session->crypto.sharedMemoryId != 0) {
+        StartSharedMemory(session);
+    }
+    if (!captureDir.empty()) {
+        StartCapture(session, sessionKey, features);
+    }
+    session->state = SESSION_ESTABLISHED;
+    Metrics::Record(METRIC_HANDSHAKE_NS, Metrics::NowNanos() - handshake->acceptTime);
+    session->handshake.reset();
+    Metrics::Add(METRIC_SESSION_BYTES, -(uint64_t)sizeof(SessionHandshake));
+    // 握手截止改为空闲与保活检查
+    session->lastReceive = (uint32_t)loop.Timers().Now();
+    loop.Timers().Schedule(&session->timer, TIMER_TICKS(SERVER_KEEPALIVE_MS < SERVER_IDLE_TIMEOUT_MS ? SERVER_KEEPALIVE_MS : SERVER_IDLE_TIMEOUT_MS));
+    handshakes++;
+    Metrics::Add(METRIC_HANDSHAKES);
+    UpdateInterest(session);
+    // 对方已经关闭：不再等下一轮事件，现在就读出缓冲的帧，之后读到末尾时关闭
+    if (peerClosed) {
+        return OnFrames(session);
+    }
+    return true;
+}
+
+bool Server::OnFrames(Session* session) {
+    ssize_t len = session->reader.Fill(session->fd);
+    if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return true;
+    }
+    if (len <= 0) {
+        return false;
+    }
+    session->lastReceive = (uint32_t)loop.Timers().Now();
+    if ((size_t)session->fd < captures.size() && captures[session->fd]) {
+        captures[session->fd]->Append(session->reader.Tail(len), (uint32_t)len);
+    }
+
+    char* cipherText;
+    uint32_t cipherTextLength;
+    uint8_t flags;
+    while (session->reader.Next(cipherText, cipherTextLength, flags)) {
+        if (flags & FRAME_FLAG_KEEPALIVE) {
+            continue;
+        }
+        char* plainText;
+        int plainTextLength = OpenMessage(session->crypto, cipherText, cipherTextLength, flags, plainText);
+        if (plainTextLength < 0) {
+            return false;
+        }
+        bool chatMessage = (flags & ~FRAME_FLAGS_TRANSPORT) == 0;
+        if (chatMessage && plainTextLength == (int)strlen(EXIT_COMMAND) && memcmp(plainText, EXIT_COMMAND, plainTextLength) == 0) {
+            return false;
+        }
+        messages++;
+
+        if (mode == SERVER_MODE_ECHO) {
+            Deliver(session, plainText, plainTextLength, flags & ~FRAME_FLAGS_TRANSPORT);
+            continue;
+        }
+        for (auto& entry : sessions) {
+            Session* target = entry.get();
+            if (target == nullptr || target == session || target->state != SESSION_ESTABLISHED) {
+                continue;
+            }
+            // 慢消费者不能让服务器无限缓冲：超过高水位的目标直接丢弃
+            if (target->sendQueue.IsPaused()) {
+                dropped++;
+                continue;
+            }
+            Deliver(target, plainText, plainTextLength, flags & ~FRAME_FLAGS_TRANSPORT);
+        }
+    }
+    // 帧头声明的长度超过协议上限：不等这一帧收完，直接关闭会话
+    if (session->reader.Oversized()) {
+        return false;
+    }
+
+    // 回显模式下发送者自己的队列积压时暂停读取它
+    if (mode == SERVER_MODE_ECHO && session->sendQueue.IsPaused() && !session->readPaused) {
+        session->readPaused = true;
+        UpdateInterest(session);
+    }
+    return true;
+}
+
+// 抓包从会话建立开始：握手之后收到的所有字节按 recv 的分块原样写入，连同解密所需的会话密钥
+void Server::StartCapture(Session* session, const uint8_t* sessionKey, uint64_t features) {
+    char name[64];
+    snprintf(name, sizeof(name), "/capture-%llu-%d.cap", (unsigned long long)JournalNow(), session->fd);
+    auto capture = std::make_unique<CaptureWriter>();
+    if (!capture->Open(captureDir + name, sessionKey, features, true)) {
+        return;
+    }
+    if ((size_t)session->fd >= captures.size()) {
+        captures.resize(session->fd + 1);
+    }
+    captures[session->fd] = std::move(capture);
+}
+
+// 数据报在本批全部处理完后统一回复确认并 sendmmsg，一批收到的多条消息合成少数几次系统调用
+void Server::OnDatagrams() {
+    uint64_t now = Metrics::NowNanos();
+    while (true) {
+        int count = datagrams.Receive();
+        for (int i = 0; i < count; i++) {
+            OnDatagram(datagrams.Data(i), datagrams.Length(i), datagrams.From(i), now);
+        }
+        for (Session* session : ackSessions) {
+            session->datagram->SendAcks(datagrams);
+        }
+        ackSessions.clear();
+        datagrams.Flush();
+        if (count < DATAGRAM_BATCH) {
+            break;
+        }
+    }
+}
+
+void Server::OnDatagram(char* data, int length, const sockaddr_in& from, uint64_t now) {
+    uint64_t id;
+    if (!DatagramChannel::PeekId(data, length, id)) {
+        return;
+    }
+    auto it = datagramSessions.find(id);
+    if (it == datagramSessions.end()) {
+        return;
+    }
+    Session* session = it->second;
+    DatagramChannel* channel = session->datagram.get();
+    bool ackPending = channel->AckPending();
+    char* text;
+    int textLength;
+    bool reliable;
+    DatagramResult result = channel->Receive(data, length, from, now, text, textLength, reliable);
+    if (!ackPending && channel->AckPending()) {
+        ackSessions.push_back(session);
+    }
+    if (result != DATAGRAM_MESSAGE) {
+        return;
+    }
+    session->lastReceive = (uint32_t)loop.Timers().Now();
+    messages++;
+
+    if (mode == SERVER_MODE_ECHO) {
+        SendDatagram(session, text, textLength, reliable, now);
+        return;
+    }
+    for (auto& entry : sessions) {
+        Session* target = entry.get();
+        if (target == nullptr || target == session || target->state != SESSION_ESTABLISHED) {
+            continue;
+        }
+        if (target->datagram && target->datagram->HasPeer()) {
+            SendDatagram(target, text, textLength, reliable, now);
+        } else if (target->sendQueue.IsPaused()) {
+            dropped++;
+        } else {
+            Deliver(target, text, textLength, 0);
+        }
+    }
+}
+
+void Server::SendDatagram(Session* target, const char* text, int length, bool reliable, uint64_t now) {
+    DatagramChannel* channel = target->datagram.get();
+    if (channel->Send(datagrams, text, length, reliable, now) < 0) {
+        dropped++;
+        return;
+    }
+    if (reliable && !TimerWheel::Pending(&channel->timer)) {
+        loop.Timers().Schedule(&channel->timer, TIMER_TICKS(channel->Rto() / 1000000));
+    }
+}
+
+// 重发定时器：时间轮的精度为 TIMER_TICK_MS，实际重发时刻会向后取整到格
+void Server::OnDatagramTimer(Session* session) {
+    uint64_t next = session->datagram->Retransmit(datagrams, Metrics::NowNanos());
+    datagrams.Flush();
+    if (next > 0) {
+        loop.Timers().Schedule(&session->datagram->timer, TIMER_TICKS((next + 999999) / 1000000));
+    }
+}
+
+// 会话号由会话密钥派生，极少数重复时后来的会话只能使用 TCP
+bool Server::StartDatagram(Session* session) {
+    if (session->crypto.datagramId == 0 || !datagramSessions.emplace(session->crypto.datagramId, session).second) {
+        return false;
+    }
+    session->datagram = std::make_unique<DatagramChannel>(session->crypto);
+    TimerWheel::Init(&session->datagram->timer, [](void* context) {
+        Session* session = static_cast<Session*>(context);
+        session->server->OnDatagramTimer(session);
+    }, session);
+    Metrics::Add(METRIC_SESSION_BYTES, sizeof(DatagramChannel));
+    return true;
+}
+
+// 映射会话的共享内存环；对方也映射后帧改经环收发。第一个这样的会话出现时事件循环开始忙轮询
+void Server::StartSharedMemory(Session* session) {
+    auto channel = std::make_unique<SharedMemoryChannel>();
+    if (channel->Open(session->crypto.sharedMemoryId, true)) {
+        AttachSharedMemory(session, std::move(channel));
+    }
+}
+
+void Server::AttachSharedMemory(Session* session, std::unique_ptr<SharedMemoryChannel> channel) {
+    session->shared = std::move(channel);
+    session->sendQueue.UseSharedMemory(session->shared.get());
+    session->reader.UseSharedMemory(session->shared.get());
+    Metrics::Add(METRIC_SESSION_BYTES, sizeof(SharedMemoryChannel));
+    sharedSessions.push_back(session);
+    if (sharedSessions.size() == 1) {
+        loop.SetPoller([this]() { return PollShared(); }, [this]() { return ParkShared(); }, SharedMemoryChannel::SpinNanos());
+    }
+}
+
+// 处理环中有数据（读取未暂停时）或等到了空间的会话；处理中关闭的会话被末尾的会话换到当前位置
+bool Server::PollShared() {
+    bool progress = false;
+    for (size_t i = 0; i < sharedSessions.size();) {
+        Session* session = sharedSessions[i];
+        if (!session->shared->Pending(!session->readPaused, !session->sendQueue.Empty())) {
+            i++;
+            continue;
+        }
+        progress = true;
+        OnSession(session, EPOLLIN);
+        if (i < sharedSessions.size() && sharedSessions[i] == session) {
+            i++;
+        }
+    }
+    FlushDirty();
+    return progress;
+}
+
+bool Server::ParkShared() {
+    for (Session* session : sharedSessions) {
+        if (!session->shared->Park(!session->readPaused, !session->sendQueue.Empty())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Server::Deliver(Session* target, const char* text, int length, uint8_t flags) {
+    // 在目标会话上封装后超过帧长上限（例如 AES 会话发来的最长消息中继给 DES 会话）时丢弃
+    if (QueueMessage(target->sendQueue, target->crypto, text, length, flags, batching ? &batch : nullptr) < 0) {
+        dropped++;
+        return;
+    }
+    if (!target->dirty) {
+        target->dirty = true;
+        dirtySessions.push_back(target);
+    }
+}
+
+bool Server::FlushSession(Session* session) {
+    batch.Flush();
+    ssize_t written = session->sendQueue.Flush(session->fd);
+    if (written < 0) {
+        return false;
+    }
+    if (written > 0) {
+        session->lastSend = (uint32_t)loop.Timers().Now();
+    }
+    if (session->readPaused && !session->sendQueue.IsPaused()) {
+        session->readPaused = false;
+    }
+    UpdateInterest(session);
+    return true;
+}
+
+// 本轮事件中被写入数据的会话统一 Flush 一次，多条消息合并为一次 sendmsg
+void Server::FlushDirty() {
+    std::vector<Session*> pending;
+    pending.swap(dirtySessions);
+    for (Session* session : pending) {
+        session->dirty = false;
+        if (!FlushSession(session)) {
+            CloseSession(session);
+        }
+    }
+}
+
+void Server::UpdateInterest(Session* session) {
+    uint32_t events = EPOLLRDHUP;
+    // 经共享内存发送的会话即使暂停读取也要收门铃（环中腾出了空间）
+    if (!session->readPaused || (session->shared && session->shared->Sending())) {
+        events |= EPOLLIN;
+    }
+    if (session->sendQueue.WaitsForSocket()) {
+        events |= EPOLLOUT;
+    }
+    if (events != session->events) {
+        loop.Modify(session->fd, events);
+        session->events = events;
+    }
+}
+
+void Server::CloseSession(Session* session) {
+    // 批中可能还有写在这个会话发送队列里的帧
+    batch.Flush();
+    int fd = session->fd;
+    if (session->dirty) {
+        for (auto& pending : dirtySessions) {
+            if (pending == session) {
+                pending = dirtySessions.back();
+                dirtySessions.pop_back();
+                break;
+            }
+        }
+    }
+    if (session->handshake && session->handshake->queued) {
+        handshakeQueue.erase(std::find(handshakeQueue.begin(), handshakeQueue.end(), session));
+    }
+    loop.Timers().Cancel(&session->timer);
+    loop.Remove(fd);
+    close(fd);
+    if ((size_t)fd < captures.size()) {
+        captures[fd].reset();
+    }
+    if (session->datagram) {
+        loop.Timers().Cancel(&session->datagram->timer);
+        datagramSessions.erase(session->datagram->Id());
+        for (auto& pending : ackSessions) {
+            if (pending == session) {
+                pending = ackSessions.back();
+                ackSessions.pop_back();
+                break;
+            }
+        }
+    }
+    if (session->shared) {
+        for (auto& pending : sharedSessions) {
+            if (pending == session) {
+                pending = sharedSessions.back();
+                sharedSessions.pop_back();
+                break;
+            }
+        }
+    }
+    uint64_t bytes = sizeof(Session) + (session->handshake ? sizeof(SessionHandshake) : 0) +
+                     (session->crypto.aes ? sizeof(AesOp) : 0) + (session->datagram ? sizeof(DatagramChannel) : 0) +
+                     (session->shared ? sizeof(SharedMemoryChannel) : 0);
+    sessions[fd].reset();
+    sessionCount--;
+    Metrics::Add(METRIC_ACTIVE_SESSIONS, (uint64_t)-1);
+    Metrics::Add(METRIC_SESSION_BYTES, -bytes);
+}
+
+// 会话内存：空闲会话只有固定结构（AES 会话另有一份轮密钥）；握手中的会话多一份握手状态；收发缓冲按借用量统计
+void Server::PrintMemory() {
+    size_t established = 0, holding = 0;
+    for (auto& session : sessions) {
+        if (session) {
+            established += session->state == SESSION_ESTABLISHED;
+            holding += session->reader.Holding() || session->sendQueue.Holding();
+        }
+    }
+    BufferPool& pool = BufferPool::ThreadLocal();
+    std::cout << "Session memory: " << sizeof(Session) << " bytes per idle session (+"
+              << sizeof(SessionHandshake) << " during the handshake, +" << sizeof(AesOp) << " with AES, +"
+              << sizeof(DatagramChannel) << " with datagrams, +" << sizeof(EventLoop::Handler)
+              << " event handler); " << sessionCount << " sessions (" << established << " established, "
+              << holding << " holding buffers), " << pool.BorrowedBytes() << " buffer bytes borrowed, "
+              << pool.CachedBytes() << " cached." << std::endl;
+}
+
+// 会话定时器到期：握手未完成即超时断开；已建立的会话按最近收发时间判断空闲驱逐与保活，
+// 然后重新调度到下一个最早的截止时间
+void Server::OnSessionTimer(Session* session) {
+    if (session->state == SESSION_AWAIT_KEY) {
+        timeouts++;
+        Metrics::Add(METRIC_HANDSHAKE_TIMEOUTS);
+        CloseSession(session);
+        return;
+    }
+    uint32_t now = (uint32_t)loop.Timers().Now();
+    uint32_t idle = now - session->lastReceive;
+    if (idle >= TIMER_TICKS(SERVER_IDLE_TIMEOUT_MS)) {
+        evictions++;
+        Metrics::Add(METRIC_IDLE_EVICTIONS);
+        CloseSession(session);
+        return;
+    }
+    uint32_t quiet = now - session->lastSend;
+    if (quiet >= TIMER_TICKS(SERVER_KEEPALIVE_MS)) {
+        QueueKeepalive(session);
+        if (!FlushSession(session)) {
+            CloseSession(session);
+            return;
+        }
+        quiet = 0;
+    }
+    uint64_t untilIdle = TIMER_TICKS(SERVER_IDLE_TIMEOUT_MS) - idle;
+    uint64_t untilKeepalive = TIMER_TICKS(SERVER_KEEPALIVE_MS) - quiet;
+    loop.Timers().Schedule(&session->timer, untilIdle < untilKeepalive ? untilIdle : untilKeepalive);
+}
+
+void Server::QueueKeepalive(Session* session) {
+    char* header = session->sendQueue.Reserve(FRAME_HEADER_SIZE);
+    EncodeFrameHeader(header, 0, FRAME_FLAG_KEEPALIVE);
+    session->sendQueue.Commit(FRAME_HEADER_SIZE);
+    Metrics::Add(METRIC_KEEPALIVES);
+}
+
+// 新进程连上来：序列化全部状态交给它，等它恢复完毕后停止事件循环，之后不再碰任何 socket。
+// 交接失败时什么都没有改变，照常服务
+void Server::OnHandoff() {
+    int sock = HandoffAccept(handoffSocket);
+    if (sock < 0) {
+        return;
+    }
+    uint64_t start = Metrics::NowNanos();
+    // 本轮已排入的消息先加密发出，交出去的发送队列里只有密文
+    FlushDirty();
+    HandoffWriter out;
+    SaveState(out);
+    if (!out.Send(sock) || !HandoffWait(sock)) {
+        std::cerr << "Error: Hot restart failed, continuing to serve." << std::endl;
+        close(sock);
+        return;
+    }
+    handedOff = true;
+    loop.Stop();
+    HandoffSignal(sock);
+    close(sock);
+    std::cout << "Hot restart: sessions paused for " << (Metrics::NowNanos() - start) / 1000 << " us." << std::endl;
+}
+
+void Server::SaveState(HandoffWriter& out) {
+    out.PutFd(listenSocket);
+    out.PutFd(datagrams.Fd());
+    out.PutU64(key->rsa.GetPublicKey());
+    out.PutU64(key->rsa.GetPrivateKey());
+    out.PutU64(key->rsa.GetModulus());
+    out.PutU64(handshakes);
+    out.PutU64(messages);
+    out.PutU64(dropped);
+    out.PutU64(timeouts);
+    out.PutU64(evictions);
+    out.PutU64(sessionCount);
+    for (auto& session : sessions) {
+        if (session) {
+            SaveSession(out, session.get());
+        }
+    }
+}
+
+// 握手中的会话带上已收到的半个密钥报文和发给它的那把服务器密钥；已建立的会话带上密码状态、
+// 半帧、未发出的密文以及数据报与共享内存状态。抓包文件不交接，新进程中这些会话不再抓包
+void Server::SaveSession(HandoffWriter& out, Session* session) {
+    out.PutFd(session->fd);
+    out.PutU8(session->state);
+    out.PutU32(session->lastReceive);
+    out.PutU32(session->lastSend);
+    if (session->state == SESSION_AWAIT_KEY) {
+        SessionHandshake* handshake = session->handshake.get();
+        out.PutU64(handshake->acceptTime);
+        out.PutU32((uint32_t)handshake->keyLength);
+        out.PutU64(handshake->features);
+        out.Put(&handshake->keyMessage, sizeof(handshake->keyMessage));
+        out.PutU64(handshake->key->rsa.GetPublicKey());
+        out.PutU64(handshake->key->rsa.GetPrivateKey());
+        out.PutU64(handshake->key->rsa.GetModulus());
+        return;
+    }
+    SaveSessionCrypto(out, session->crypto);
+    session->reader.Save(out);
+    session->sendQueue.Save(out);
+    out.PutU8(session->datagram != nullptr);
+    if (session->datagram) {
+        session->datagram->Save(out);
+    }
+    out.PutU8(session->shared != nullptr);
+    if (session->shared) {
+        session->shared->Save(out);
+    }
+}
+
+// 恢复完全部状态后确认，旧进程停止收发后才返回；此前不在任何 socket 上收发
+bool Server::TakeOver(int sock) {
+    HandoffReader in;
+    if (!in.Receive(sock)) {
+        std::cerr << "Error: Failed to receive state from the running server." << std::endl;
+        return false;
+    }
+    listenSocket = in.TakeFd();
+    int datagramSocket = in.TakeFd();
+    uint64_t e = in.GetU64(), d = in.GetU64(), n = in.GetU64();
+    key = std::make_shared<ServerKey>();
+    key->rsa.SetKey(e, d, n);
+    key->hello = {e, n, HANDSHAKE_FEATURES_SUPPORTED};
+    handshakes = in.GetU64();
+    messages = in.GetU64();
+    dropped = in.GetU64();
+    timeouts = in.GetU64();
+    evictions = in.GetU64();
+    uint64_t count = in.GetU64();
+    if (!in.Ok() || !datagrams.Adopt(datagramSocket)) {
+        std::cerr << "Error: Malformed hot restart state." << std::endl;
+        return false;
+    }
+    sockaddr_in address;
+    socklen_t addressLength = sizeof(address);
+    if (getsockname(listenSocket, (sockaddr*)&address, &addressLength) == 0) {
+        port = ntohs(address.sin_port);
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (!RestoreSession(in)) {
+            std::cerr << "Error: Malformed hot restart state." << std::endl;
+            return false;
+        }
+    }
+    if (!in.AtEnd()) {
+        std::cerr << "Error: Malformed hot restart state." << std::endl;
+        return false;
+    }
+    if (!HandoffSignal(sock) || !HandoffWait(sock)) {
+        std::cerr << "Error: The running server did not release its sessions." << std::endl;
+        return false;
+    }
+    Metrics::Add(METRIC_HANDOFF_SESSIONS, count);
+    std::cout << "Resumed " << count << " sessions from the previous server process." << std::endl;
+    return true;
+}
+
+bool Server::RestoreSession(HandoffReader& in) {
+    int fd = in.TakeFd();
+    SessionState state = (SessionState)in.GetU8();
+    if (fd < 0) {
+        return false;
+    }
+    auto restored = NewSession(fd);
+    restored->state = state;
+    restored->lastReceive = in.GetU32();
+    restored->lastSend = in.GetU32();
+    if (state == SESSION_AWAIT_KEY) {
+        auto handshake = std::make_unique<SessionHandshake>();
+        handshake->acceptTime = in.GetU64();
+        handshake->keyLength = (int)in.GetU32();
+        handshake->queued = false;
+        handshake->waited = false;
+        handshake->decrypting = false;
+        handshake->peerClosed = false;
+        handshake->job = 0;
+        handshake->features = in.GetU64();
+        in.Get(&handshake->keyMessage, sizeof(handshake->keyMessage));
+        uint64_t e = in.GetU64(), d = in.GetU64(), n = in.GetU64();
+        if (e == key->hello.e && n == key->hello.n) {
+            handshake->key = key;
+        } else {
+            // 在旧进程更换密钥之前开始的握手
+            handshake->key = std::make_shared<ServerKey>();
+            handshake->key->rsa.SetKey(e, d, n);
+            handshake->key->hello = {e, n, HANDSHAKE_FEATURES_SUPPORTED};
+        }
+        restored->handshake = std::move(handshake);
+        Session* session = AddSession(std::move(restored));
+        session->sendQueue.EnableZeroCopy(fd);
+        uint64_t elapsed = (Metrics::NowNanos() - session->handshake->acceptTime) / 1000000;
+        loop.Timers().Schedule(&session->timer, TIMER_TICKS(elapsed < SERVER_HANDSHAKE_TIMEOUT_MS ? SERVER_HANDSHAKE_TIMEOUT_MS - elapsed : 0));
+        if (!in.Ok() || session->handshake->keyLength > (int)sizeof(HandshakeKey)) {
+            return false;
+        }
+        // 在旧进程中已收齐密钥、排队或正在解密的握手
+        if (session->handshake->keyLength == (int)sizeof(HandshakeKey)) {
+            QueueHandshake(session);
+        }
+        return true;
+    }
+
+    // 先登记，恢复中途失败时由析构函数统一清理
+    Session* session = AddSession(std::move(restored));
+    if (!RestoreSessionCrypto(in, session->crypto, true)) {
+        return false;
+    }
+    if (session->crypto.aes) {
+        Metrics::Add(METRIC_SESSION_BYTES, sizeof(AesOp));
+    }
+    session->sendQueue.EnableZeroCopy(fd);
+    if (!session->reader.Restore(in) || !session->sendQueue.Restore(in)) {
+        return false;
+    }
+    if (in.GetU8()) {
+        if (!StartDatagram(session) || !session->datagram->Restore(in)) {
+            return false;
+        }
+        if (session->datagram->Outstanding() > 0) {
+            loop.Timers().Schedule(&session->datagram->timer, TIMER_TICKS(session->datagram->Rto() / 1000000));
+        }
+    }
+    if (in.GetU8()) {
+        auto channel = std::make_unique<SharedMemoryChannel>();
+        if (!channel->Restore(in, session->crypto.sharedMemoryId)) {
+            return false;
+        }
+        AttachSharedMemory(session, std::move(channel));
+    }
+    if (mode == SERVER_MODE_ECHO && session->sendQueue.IsPaused()) {
+        session->readPaused = true;
+    }
+    UpdateInterest(session);
+    loop.Timers().Schedule(&session->timer, TIMER_TICKS(SERVER_KEEPALIVE_MS < SERVER_IDLE_TIMEOUT_MS ? SERVER_KEEPALIVE_MS : SERVER_IDLE_TIMEOUT_MS));
+    return in.Ok();
+}
@@ -0,0 +1,184 @@
+// des_keysearch：已知一组明文/密文，在基准密钥上穷举最低若干个有效密钥位，
+// 用所有核心并行搜索并报告每秒尝试的密钥数，据此估算穷举完整 56 位密钥空间所需的时间
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include "DES_Operation.h"
+#include "KeySearch.h"
+#include "ThreadPool.h"
+
+#define KEYSEARCH_MAX_CHUNKS_PER_PASS (1u << 20)
+#define KEYSEARCH_DEFAULT_KEY "Luhaozhe"           // Lab1 中写死的密钥
+
+struct SearchOptions {
+    uint8_t plainText[8] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+    uint8_t cipherText[8];
+    bool haveCipher = false;
+    uint8_t key[8];
+    bool haveBase = false;
+    uint8_t base[8];
+    int bits = 28;                                  // 枚举的有效密钥位数
+    int threads = (int)std::thread::hardware_concurrency();
+    double seconds = 0;                             // 大于 0 时到时停止
+};
+
+static void Usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--plain HEX16] [--cipher HEX16] [--key TEXT8] [--base HEX16]"
+              << " [--bits N] [--threads N] [--seconds S]" << std::endl;
+    std::cerr << "Without --cipher the plaintext is encrypted under --key (default \"" << KEYSEARCH_DEFAULT_KEY
+              << "\") and the low --bits effective bits of that key are searched." << std::endl;
+}
+
+static bool ParseHex(const char* text, uint8_t* bytes) {
+    if (strncmp(text, "0x", 2) == 0 || strncmp(text, "0X", 2) == 0) {
+        text += 2;
+    }
+    if (strlen(text) != 16) {
+        return false;
+    }
+    for (int i = 0; i < 8; i++) {
+        char digits[3] = {text[2 * i], text[2 * i + 1], 0};
+        char* end;
+        bytes[i] = (uint8_t)strtoul(digits, &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void PrintKey(uint64_t key) {
+    uint8_t bytes[8];
+    DesKeySearch::KeyToBytes(key, bytes);
+    std::cout << std::hex << std::setfill('0');
+    for (uint8_t byte : bytes) {
+        std::cout << std::setw(2) << (int)byte;
+    }
+    std::cout << std::dec << std::setfill(' ');
+    bool printable = true;
+    for (uint8_t byte : bytes) {
+        printable = printable && byte >= 0x20 && byte < 0x7F;
+    }
+    if (printable) {
+        std::cout << " \"" << std::string((const char*)bytes, 8) << "\"";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SearchOptions options;
+    memcpy(options.key, KEYSEARCH_DEFAULT_KEY, 8);
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        bool valid = true;
+        if (strcmp(arg, "--plain") == 0) {
+            valid = ParseHex(value, options.plainText);
+        } else if (strcmp(arg, "--cipher") == 0) {
+            valid = options.haveCipher = ParseHex(value, options.cipherText);
+        } else if (strcmp(arg, "--key") == 0) {
+            valid = strlen(value) == 8;
+            memcpy(options.key, value, valid ? 8 : 0);
+        } else if (strcmp(arg, "--base") == 0) {
+            valid = options.haveBase = ParseHex(value, options.base);
+        } else if (strcmp(arg, "--bits") == 0) {
+            options.bits = atoi(value);
+            valid = options.bits >= 3 && options.bits <= KEYSEARCH_EFFECTIVE_BITS;
+        } else if (strcmp(arg, "--threads") == 0) {
+            options.threads = atoi(value);
+            valid = options.threads > 0;
+        } else if (strcmp(arg, "--seconds") == 0) {
+            options.seconds = atof(value);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    DesKeySearch search;
+    if (!search.SelfTest()) {
+        std::cerr << "Error: Key search kernel does not match DesOp." << std::endl;
+        return 1;
+    }
+    if (!options.haveCipher) {
+        DesOp des;
+        des.SetKey((const char*)options.key);
+        des.EncryptBlock(options.plainText, options.cipherText);
+    }
+    search.SetPair(options.plainText, options.cipherText);
+
+    // 被枚举的位从基准密钥中清零，其余位（包括校验位）保持不变
+    uint64_t range = 1ull << options.bits;
+    uint64_t baseKey = DesKeySearch::BytesToKey(options.haveBase ? options.base : options.key);
+    baseKey &= ~DesKeySearch::SpreadKeyBits(range - 1);
+    uint64_t chunkSize = options.bits < KEYSEARCH_CHUNK_BITS ? range : 1ull << KEYSEARCH_CHUNK_BITS;
+    uint64_t chunks = range / chunkSize;
+
+    std::cout << "Searching 2^" << options.bits << " keys around ";
+    PrintKey(baseKey);
+    std::cout << " on " << options.threads << " thread(s)..." << std::endl;
+
+    WorkStealingPool pool(options.threads);
+    std::mutex foundMutex;
+    std::vector<uint64_t> found;
+    std::atomic<uint64_t> searched(0);
+    std::atomic<bool> expired(false);
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.seconds));
+
+    for (uint64_t pass = 0; pass < chunks && !expired.load(std::memory_order_relaxed); pass += KEYSEARCH_MAX_CHUNKS_PER_PASS) {
+        uint32_t passChunks = (uint32_t)(chunks - pass < KEYSEARCH_MAX_CHUNKS_PER_PASS ? chunks - pass : KEYSEARCH_MAX_CHUNKS_PER_PASS);
+        pool.ParallelFor(passChunks, [&](uint32_t chunk) {
+            if (expired.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::vector<uint64_t> matches;
+            search.Search(baseKey, (pass + chunk) * chunkSize, chunkSize, matches);
+            searched.fetch_add(chunkSize, std::memory_order_relaxed);
+            if (!matches.empty()) {
+                std::lock_guard<std::mutex> lock(foundMutex);
+                found.insert(found.end(), matches.begin(), matches.end());
+            }
+            if (options.seconds > 0 && std::chrono::steady_clock::now() >= deadline) {
+                expired.store(true, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rate = searched.load() / elapsed;
+    double fullSeconds = (double)(1ull << KEYSEARCH_EFFECTIVE_BITS) / rate;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Searched " << searched.load() << " keys in " << elapsed << " s: "
+              << rate / 1e6 << " M keys/s (" << rate / 1e6 / options.threads << " M keys/s per thread)" << std::endl;
+    std::cout << "Full 2^56 key space at this rate: " << fullSeconds / 86400 << " days ("
+              << fullSeconds / 86400 / 365.25 << " years), half that on average." << std::endl;
+
+    // 一组明文/密文在 2^56 个密钥中平均约有 2^-8 个误报，用 DesOp 再校验一遍
+    for (uint64_t key : found) {
+        uint8_t keyBytes[8], check[8];
+        DesKeySearch::KeyToBytes(key, keyBytes);
+        DesOp des;
+        des.SetKey((const char*)keyBytes);
+        des.EncryptBlock(options.plainText, check);
+        std::cout << "Found key: ";
+        PrintKey(key);
+        std::cout << (memcmp(check, options.cipherText, 8) == 0 ? "" : " (rejected by DesOp)") << std::endl;
+    }
+    if (found.empty()) {
+        std::cout << "Key not found in the searched range." << std::endl;
+    }
+    return found.empty() ? 2 : 0;
+}
@@ -0,0 +1,599 @@
+// chat_loadgen：对本地服务器（回显模式）发起大量并发会话，
+// 使用与 Chat::RunClient 相同的 RSA 密钥交换和 DES 帧格式，统计握手速率、吞吐与延迟分布。
+// 每个会话的连接、握手与接收是一个协程，数千个会话在同一个事件循环线程上交替运行。
+// --transport udp 时握手仍走 TCP，消息改用加密数据报收发（见 Datagram.h）
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "AsyncProtocol.h"
+#include "AsyncSocket.h"
+#include "Coroutine.h"
+#include "Datagram.h"
+#include "EventLoop.h"
+#include "Frame.h"
+#include "Histogram.h"
+#include "Protocol.h"
+
+#define LOADGEN_TICK_NS 1000000                 // 1 ms 调度一次连接与消息
+#define LOADGEN_MIN_MESSAGE_SIZE 16             // 载荷前 8 字节为发送时间戳，后 8 字节为可靠数据报的编号
+#define LOADGEN_MAX_MESSAGE_SIZE (FRAME_MAX_LENGTH - 64)  // 留出填充、标签与压缩头，密封后不超过帧长上限
+#define LOADGEN_CONNECT_TIMEOUT_MS 10000
+#define LOADGEN_HANDSHAKE_TIMEOUT_MS 5000
+#define LOADGEN_DRAIN_MS 10000                  // 结束后等待可靠数据报重发与回显的最长时间
+#define LOADGEN_UNRELIABLE UINT64_MAX           // 不可靠数据报的编号
+
+struct LoadOptions {
+    const char* host = DEFAULT_SERVER_IP;
+    int port = DEFAULT_SERVER_PORT;
+    int connections = 1000;
+    double connectRate = 500;                   // 每秒新建连接数
+    int messageSize = 64;                       // 明文字节数
+    double messageRate = 10000;                 // 所有会话合计每秒消息数
+    double duration = 10;                       // 秒
+    uint64_t features = HANDSHAKE_FEATURES_REQUESTED;  // 向服务器请求的可选特性
+    bool datagram = false;                      // 消息走 UDP 数据报
+    double reliable = 1;                        // 要求确认与重发的数据报所占比例，介于 0 与 1 之间时两种混发
+};
+
+struct LoadSession {
+    int fd;
+    bool established;
+    bool closed;
+    bool dirty;
+    bool flushing;                              // 写协程正在等待 socket 可写
+    uint64_t connectStart;
+    std::unique_ptr<AsyncSocket> socket;
+    SessionCrypto crypto;
+    FrameReader reader;
+    SendQueue sendQueue;
+    std::unique_ptr<DatagramChannel> datagram;
+};
+
+static uint64_t NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class LoadGenerator {
+private:
+    LoadOptions options;
+    EventLoop loop;
+    int timerFd;
+    sockaddr_in serverAddr;
+    std::vector<std::unique_ptr<LoadSession>> sessions;
+    std::vector<LoadSession*> established;
+    std::vector<LoadSession*> dirtySessions;
+    std::vector<char> payload;
+    size_t nextSession;
+    DatagramSocket datagrams;                   // 所有会话共用一个 UDP socket
+    std::unordered_map<uint64_t, LoadSession*> datagramSessions;
+
+    uint64_t startTime;
+    uint64_t lastReport;
+    int started;
+    int failed;
+    uint64_t messagesSent;
+    uint64_t messagesReceived;
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    uint64_t skipped;                           // 目标会话处于背压而跳过的发送次数
+    uint64_t lastReceived;
+    double reliableCredit;                      // 按比例累积，满 1 时发一条可靠数据报
+    std::vector<bool> reliableEchoed;           // 下标为可靠数据报的编号
+    uint64_t reliableReceived;                  // 收到回显的可靠数据报（去重）
+    uint64_t drainStart;                        // 0 表示仍在发送
+    Histogram handshakeLatency;
+    Histogram messageLatency;
+
+    void StartConnect();
+    void OnTick();
+    Task<void> RunSession(LoadSession* session);
+    Task<void> FlushPending(LoadSession* session);
+    bool OnFrame(LoadSession* session, char* cipherText, uint32_t cipherTextLength, uint8_t flags);
+    bool SendMessage(LoadSession* session, uint64_t now);
+    void OnDatagrams();
+    bool FlushSession(LoadSession* session);
+    void Fail(LoadSession* session);
+    bool Drained(uint64_t now);
+
+public:
+    explicit LoadGenerator(const LoadOptions& options);
+    ~LoadGenerator();
+    bool Run();
+    // 打印结果；混发可靠数据报时检查每条没有收到回显的可靠消息都被发送方记为放弃，否则返回 false
+    bool Report();
+};
+
+LoadGenerator::LoadGenerator(const LoadOptions& options) : payload(options.messageSize, 'x') {
+    this->options = options;
+    timerFd = -1;
+    nextSession = 0;
+    startTime = 0;
+    lastReport = 0;
+    started = 0;
+    failed = 0;
+    messagesSent = 0;
+    messagesReceived = 0;
+    bytesSent = 0;
+    bytesReceived = 0;
+    skipped = 0;
+    lastReceived = 0;
+    reliableCredit = 0;
+    reliableReceived = 0;
+    drainStart = 0;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(options.port);
+    serverAddr.sin_addr.s_addr = inet_addr(options.host);
+}
+
+LoadGenerator::~LoadGenerator() {
+    // 关闭仍在运行的会话，挂起的会话协程被唤醒后结束并释放协程帧
+    for (auto& session : sessions) {
+        Fail(session.get());
+    }
+    if (timerFd >= 0) {
+        close(timerFd);
+    }
+}
+
+bool LoadGenerator::Run() {
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd < 0) {
+        std::cerr << "Error: Failed to create timer." << std::endl;
+        return false;
+    }
+    itimerspec spec{};
+    spec.it_interval.tv_nsec = LOADGEN_TICK_NS;
+    spec.it_value.tv_nsec = LOADGEN_TICK_NS;
+    timerfd_settime(timerFd, 0, &spec, nullptr);
+    loop.Add(timerFd, EPOLLIN, [this](uint32_t) {
+        uint64_t expirations;
+        while (read(timerFd, &expirations, sizeof(expirations)) > 0) {
+        }
+        OnTick();
+    });
+    if (options.datagram) {
+        if (!datagrams.Open(0)) {
+            return false;
+        }
+        // 回显一段的放弃发生在服务器上，这里看不到；只在去程模拟丢包，Report 才能逐条核对可靠消息
+        if (options.reliable > 0) {
+            datagrams.SendLossOnly();
+        }
+        loop.Add(datagrams.Fd(), EPOLLIN, [this](uint32_t) { OnDatagrams(); });
+    }
+
+    startTime = NowNanos();
+    lastReport = startTime;
+    loop.Run();
+    return true;
+}
+
+void LoadGenerator::StartConnect() {
+    started++;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        failed++;
+        return;
+    }
+    auto session = std::make_unique<LoadSession>();
+    session->fd = fd;
+    session->established = false;
+    session->closed = false;
+    session->dirty = false;
+    session->flushing = false;
+    session->connectStart = NowNanos();
+    session->socket = std::make_unique<AsyncSocket>(loop, fd);
+    LoadSession* raw = session.get();
+    sessions.push_back(std::move(session));
+    Spawn(RunSession(raw));
+}
+
+void LoadGenerator::OnTick() {
+    uint64_t now = NowNanos();
+    double elapsed = (now - startTime) / 1e9;
+    if (elapsed >= options.duration) {
+        if (Drained(now)) {
+            loop.Stop();
+        }
+        return;
+    }
+
+    // 按连接速率逐步建立会话
+    int targetConnections = (int)(options.connectRate * elapsed);
+    if (targetConnections > options.connections) {
+        targetConnections = options.connections;
+    }
+    while (started < targetConnections) {
+        StartConnect();
+    }
+
+    // 按消息速率在已建立的会话间轮流发送
+    uint64_t targetMessages = (uint64_t)(options.messageRate * elapsed);
+    size_t budget = established.size();
+    while (messagesSent < targetMessages && budget > 0) {
+        LoadSession* session = established[nextSession++ % established.size()];
+        budget--;
+        if (session->sendQueue.IsPaused() || !SendMessage(session, now)) {
+            skipped++;
+            continue;
+        }
+        budget = established.size();
+    }
+    if (options.datagram) {
+        for (LoadSession* session : established) {
+            session->datagram->Retransmit(datagrams, now);
+        }
+        datagrams.Flush();
+    }
+    for (LoadSession* session : dirtySessions) {
+        session->dirty = false;
+        if (!session->closed && !FlushSession(session)) {
+            Fail(session);
+        }
+    }
+    dirtySessions.clear();
+
+    if (now - lastReport >= 1000000000ULL) {
+        std::cout << "[" << std::fixed << std::setprecision(1) << elapsed << "s] sessions "
+                  << established.size() << "/" << started << ", failed " << failed
+                  << ", messages/s " << (messagesReceived - lastReceived) * 1e9 / (now - lastReport) << std::endl;
+        lastReceived = messagesReceived;
+        lastReport = now;
+    }
+}
+
+// 时间到后不再发送新消息，继续重发与接收回显，直到可靠数据报全部有了结果（回显或放弃）或等待超时
+bool LoadGenerator::Drained(uint64_t now) {
+    if (!options.datagram || reliableEchoed.empty()) {
+        return true;
+    }
+    if (drainStart == 0) {
+        drainStart = now;
+    }
+    bool outstanding = false;
+    uint64_t abandoned = 0;
+    for (LoadSession* session : established) {
+        session->datagram->Retransmit(datagrams, now);
+        outstanding = outstanding || session->datagram->Outstanding() > 0;
+        abandoned += session->datagram->Abandoned();
+    }
+    datagrams.Flush();
+    bool settled = !outstanding && reliableReceived + abandoned >= reliableEchoed.size();
+    return settled || now - drainStart >= (uint64_t)LOADGEN_DRAIN_MS * 1000000;
+}
+
+bool LoadGenerator::SendMessage(LoadSession* session, uint64_t now) {
+    memcpy(payload.data(), &now, sizeof(now));
+    if (session->datagram) {
+        reliableCredit += options.reliable;
+        bool reliable = reliableCredit >= 1;
+        uint64_t number = reliable ? reliableEchoed.size() : LOADGEN_UNRELIABLE;
+        memcpy(payload.data() + sizeof(now), &number, sizeof(number));
+        // 未确认的消息过多时算作背压跳过
+        int length = session->datagram->Send(datagrams, payload.data(), (int)payload.size(), reliable, now);
+        if (length < 0) {
+            return false;
+        }
+        if (reliable) {
+            reliableCredit -= 1;
+            reliableEchoed.push_back(false);
+        }
+        bytesSent += length;
+        messagesSent++;
+        return true;
+    }
+    bytesSent += QueueMessage(session->sendQueue, session->crypto, payload.data(), (int)payload.size());
+    messagesSent++;
+    if (!session->dirty) {
+        session->dirty = true;
+        dirtySessions.push_back(session);
+    }
+    return true;
+}
+
+// 收一批回显的数据报，记录延迟，成批回复确认
+void LoadGenerator::OnDatagrams() {
+    while (true) {
+        uint64_t now = NowNanos();
+        int count = datagrams.Receive();
+        for (int i = 0; i < count; i++) {
+            uint64_t id;
+            if (!DatagramChannel::PeekId(datagrams.Data(i), datagrams.Length(i), id)) {
+                continue;
+            }
+            auto it = datagramSessions.find(id);
+            if (it == datagramSessions.end() || it->second->closed) {
+                continue;
+            }
+            char* text;
+            int textLength;
+            bool reliable;
+            if (it->second->datagram->Receive(datagrams.Data(i), datagrams.Length(i), datagrams.From(i), now,
+                                              text, textLength, reliable) != DATAGRAM_MESSAGE ||
+                textLength < (int)sizeof(uint64_t)) {
+                continue;
+            }
+            uint64_t sentAt;
+            memcpy(&sentAt, text, sizeof(sentAt));
+            messageLatency.Record(now - sentAt);
+            messagesReceived++;
+            if (reliable && textLength >= LOADGEN_MIN_MESSAGE_SIZE) {
+                uint64_t number;
+                memcpy(&number, text + sizeof(sentAt), sizeof(number));
+                if (number < reliableEchoed.size() && !reliableEchoed[number]) {
+                    reliableEchoed[number] = true;
+                    reliableReceived++;
+                }
+            }
+            bytesReceived += datagrams.Length(i);
+        }
+        for (LoadSession* session : established) {
+            if (session->datagram->AckPending()) {
+                session->datagram->SendAcks(datagrams);
+            }
+        }
+        datagrams.Flush();
+        if (count < DATAGRAM_BATCH) {
+            break;
+        }
+    }
+}
+
+// 会话协程：连接、与 Chat::RunClient 完全一致的密钥交换，然后逐帧接收回显直到连接关闭
+Task<void> LoadGenerator::RunSession(LoadSession* session) {
+    AsyncSocket& socket = *session->socket;
+    if (!co_await socket.Connect(serverAddr, LOADGEN_CONNECT_TIMEOUT_MS)) {
+        Fail(session);
+        co_return;
+    }
+    HandshakeStatus status = co_await ConnectHandshake(socket, session->crypto, options.features, LOADGEN_HANDSHAKE_TIMEOUT_MS);
+    if (status != HANDSHAKE_DONE || session->closed) {
+        Fail(session);
+        co_return;
+    }
+    if (options.datagram) {
+        // 服务器未启用数据报时握手会去掉该特性
+        if (session->crypto.datagramId == 0) {
+            Fail(session);
+            co_return;
+        }
+        session->datagram = std::make_unique<DatagramChannel>(session->crypto);
+        session->datagram->SetPeer(serverAddr);
+        datagramSessions.emplace(session->crypto.datagramId, session);
+    }
+    session->established = true;
+    session->sendQueue.EnableZeroCopy(session->fd);
+    established.push_back(session);
+    handshakeLatency.Record(NowNanos() - session->connectStart);
+
+    char* cipherText;
+    uint32_t cipherTextLength;
+    uint8_t flags;
+    while (co_await ReadFrame(socket, session->reader, cipherText, cipherTextLength, flags)) {
+        if (!OnFrame(session, cipherText, cipherTextLength, flags)) {
+            break;
+        }
+    }
+    Fail(session);
+}
+
+bool LoadGenerator::OnFrame(LoadSession* session, char* cipherText, uint32_t cipherTextLength, uint8_t flags) {
+    if (flags & FRAME_FLAG_KEEPALIVE) {
+        return true;
+    }
+    char* plainText;
+    int plainTextLength = OpenMessage(session->crypto, cipherText, cipherTextLength, flags, plainText);
+    if (plainTextLength < (int)sizeof(uint64_t)) {
+        return false;
+    }
+    uint64_t sentAt;
+    memcpy(&sentAt, plainText, sizeof(sentAt));
+    messageLatency.Record(NowNanos() - sentAt);
+    messagesReceived++;
+    bytesReceived += FRAME_HEADER_SIZE + cipherTextLength;
+    return true;
+}
+
+// 写协程：发送队列有积压时等待可写并续写，直到写完或会话关闭
+Task<void> LoadGenerator::FlushPending(LoadSession* session) {
+    while (!session->closed && !session->sendQueue.Empty()) {
+        if (!co_await session->socket->Writable()) {
+            break;
+        }
+        if (session->sendQueue.Flush(session->fd) < 0) {
+            Fail(session);
+            break;
+        }
+    }
+    session->flushing = false;
+}
+
+bool LoadGenerator::FlushSession(LoadSession* session) {
+    if (session->sendQueue.CompletionsPending()) {
+        session->sendQueue.ReapCompletions(session->fd);
+    }
+    if (session->sendQueue.Flush(session->fd) < 0) {
+        return false;
+    }
+    if (!session->sendQueue.Empty() && !session->flushing) {
+        session->flushing = true;
+        Spawn(FlushPending(session));
+    }
+    return true;
+}
+
+void LoadGenerator::Fail(LoadSession* session) {
+    if (session->closed) {
+        return;
+    }
+    if (session->established) {
+        for (auto& entry : established) {
+            if (entry == session) {
+                entry = established.back();
+                established.pop_back();
+                break;
+            }
+        }
+    }
+    session->established = false;
+    session->closed = true;
+    // 唤醒挂在 socket 上的另一个协程（读或写），它们看到 closed 后退出
+    session->socket->Cancel();
+    close(session->fd);
+    failed++;
+}
+
+static void PrintLatency(const char* name, const Histogram& histogram) {
+    std::cout << name << " latency (us): p50 " << histogram.Percentile(0.50) / 1000.0
+              << ", p99 " << histogram.Percentile(0.99) / 1000.0
+              << ", p999 " << histogram.Percentile(0.999) / 1000.0
+              << ", max " << histogram.Max() / 1000.0 << std::endl;
+}
+
+bool LoadGenerator::Report() {
+    bool ok = true;
+    double elapsed = (NowNanos() - startTime) / 1e9;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Duration: " << elapsed << " s" << std::endl;
+    std::cout << "Sessions: " << established.size() << " established, " << failed << " failed, "
+              << started << " attempted" << std::endl;
+    std::cout << "Handshakes/s: " << handshakeLatency.Count() / elapsed << std::endl;
+    std::cout << "Messages: " << messagesSent << " sent, " << messagesReceived << " received, "
+              << skipped << " skipped by backpressure" << std::endl;
+    if (options.datagram) {
+        uint64_t retransmits = 0;
+        uint64_t abandoned = 0;
+        uint64_t rejected = 0;
+        for (auto& session : sessions) {
+            if (session->datagram) {
+                retransmits += session->datagram->Retransmits();
+                abandoned += session->datagram->Abandoned();
+                rejected += session->datagram->Rejected();
+            }
+        }
+        std::cout << "Datagrams: " << retransmits << " retransmitted, " << abandoned << " abandoned, "
+                  << rejected << " rejected" << std::endl;
+        if (!reliableEchoed.empty()) {
+            // 丢包只发生在去程：没有回显的可靠消息都应被本端重试用尽后放弃
+            uint64_t lost = reliableEchoed.size() - reliableReceived;
+            std::cout << "Reliable: " << reliableEchoed.size() << " sent, " << reliableReceived << " echoed, "
+                      << lost << " lost" << std::endl;
+            if (lost > abandoned) {
+                std::cerr << "Error: " << lost - abandoned << " reliable messages were lost without being reported as abandoned." << std::endl;
+                ok = false;
+            }
+        }
+    }
+    std::cout << "Messages/s: " << messagesReceived / elapsed << std::endl;
+    std::cout << "Bytes/s: " << (bytesSent + bytesReceived) / elapsed << " (sent "
+              << bytesSent / elapsed << ", received " << bytesReceived / elapsed << ")" << std::endl;
+    PrintLatency("Handshake", handshakeLatency);
+    PrintLatency("Message round-trip", messageLatency);
+    return ok;
+}
+
+static void Usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--host IP] [--port PORT] [--connections N] [--connect-rate N/s]"
+              << " [--message-size BYTES] [--message-rate N/s] [--duration SECONDS] [--auth 0|1] [--compress 0|1]"
+              << " [--cipher des|aes128|aes256] [--transport tcp|udp] [--reliable 0|1|SHARE]" << std::endl;
+    std::cerr << "The target must be a server started in echo mode (RSA_chat, option 'e')." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (strcmp(arg, "--host") == 0) {
+            options.host = value;
+        } else if (strcmp(arg, "--port") == 0) {
+            options.port = atoi(value);
+        } else if (strcmp(arg, "--connections") == 0) {
+            options.connections = atoi(value);
+        } else if (strcmp(arg, "--connect-rate") == 0) {
+            options.connectRate = atof(value);
+        } else if (strcmp(arg, "--message-size") == 0) {
+            options.messageSize = atoi(value);
+        } else if (strcmp(arg, "--message-rate") == 0) {
+            options.messageRate = atof(value);
+        } else if (strcmp(arg, "--duration") == 0) {
+            options.duration = atof(value);
+        } else if (strcmp(arg, "--auth") == 0) {
+            options.features = atoi(value) ? options.features | HANDSHAKE_FEATURE_AUTH : options.features & ~HANDSHAKE_FEATURE_AUTH;
+        } else if (strcmp(arg, "--compress") == 0) {
+            options.features = atoi(value) ? options.features | HANDSHAKE_FEATURE_COMPRESS : options.features & ~HANDSHAKE_FEATURE_COMPRESS;
+        } else if (strcmp(arg, "--cipher") == 0) {
+            // 只请求一种会话密码；des 即两种 AES 都不请求
+            options.features &= ~(uint64_t)HANDSHAKE_FEATURES_CIPHER;
+            if (strcmp(value, "aes128") == 0) {
+                options.features |= HANDSHAKE_FEATURE_AES128;
+            } else if (strcmp(value, "aes256") == 0) {
+                options.features |= HANDSHAKE_FEATURE_AES256;
+            } else if (strcmp(value, "des") != 0) {
+                Usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--transport") == 0) {
+            if (strcmp(value, "udp") == 0) {
+                options.datagram = true;
+            } else if (strcmp(value, "tcp") != 0) {
+                Usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--reliable") == 0) {
+            options.reliable = std::clamp(atof(value), 0.0, 1.0);
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.messageSize < LOADGEN_MIN_MESSAGE_SIZE) {
+        options.messageSize = LOADGEN_MIN_MESSAGE_SIZE;
+    }
+    if (options.messageSize > LOADGEN_MAX_MESSAGE_SIZE) {
+        std::cerr << "Error: Messages are limited to " << LOADGEN_MAX_MESSAGE_SIZE << " bytes." << std::endl;
+        return 1;
+    }
+    if (options.datagram) {
+        // 数据报的会话号与认证密钥都依赖 AUTH 特性
+        options.features |= HANDSHAKE_FEATURE_DATAGRAM | HANDSHAKE_FEATURE_AUTH;
+        if (options.messageSize > DATAGRAM_MAX_MESSAGE) {
+            std::cerr << "Error: Datagram messages are limited to " << DATAGRAM_MAX_MESSAGE << " bytes." << std::endl;
+            return 1;
+        }
+    }
+
+    // 数千个并发连接需要提高文件描述符上限
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    LoadGenerator generator(options);
+    if (!generator.Run()) {
+        return 1;
+    }
+    return generator.Report() ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+// chat_replay：把服务器抓下的会话（ENCCHAT_CAPTURE_DIR）按原始的 recv 分块重新送入
+// 与 Server::OnFrames 相同的拆帧、解密与分发路径，可按原始节奏或尽可能快地回放，
+// 分别统计各阶段耗时，用于离线、可重复地比较接收路径的改动
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include "BufferPool.h"
+#include "Capture.h"
+#include "Frame.h"
+#include "Histogram.h"
+#include "Metrics.h"
+#include "Protocol.h"
+#include "SendQueue.h"
+
+struct ReplayOptions {
+    const char* path = nullptr;
+    bool paced = false;             // 按抓包时的间隔回放
+    bool echo = false;              // 分发时按回显模式重新加密回复
+    int repeat = 1;
+};
+
+enum ReplayStage {
+    STAGE_FRAMING,                  // 拷入接收缓冲并拆帧
+    STAGE_DECRYPT,                  // 校验、解密与解压
+    STAGE_DISPATCH,                 // 识别消息类型，回显时重新加密排入发送队列
+    STAGE_COUNT
+};
+
+static const char* STAGE_NAMES[STAGE_COUNT] = {"framing", "decrypt", "dispatch"};
+
+struct ReplayStats {
+    uint64_t stageNanos[STAGE_COUNT] = {};
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t replies = 0;
+    Histogram decryptLatency;
+};
+
+// 回放一遍：每遍使用新的会话密码状态，认证帧的序号与抓包时一致
+static bool ReplayPass(const CaptureReader& capture, const ReplayOptions& options, ReplayStats& stats) {
+    const CaptureHeader& header = capture.Header();
+    SessionCrypto crypto;
+    SetupSessionCrypto(crypto, header.sessionKey, header.features, header.isServer != 0);
+    BufferPool& pool = BufferPool::ThreadLocal();
+    FrameReader reader(pool);
+
+    auto due = std::chrono::steady_clock::now();
+    for (const CaptureChunk& chunk : capture.Chunks()) {
+        if (options.paced) {
+            due += std::chrono::microseconds(chunk.interval);
+            std::this_thread::sleep_until(due);
+        }
+        // 回复只是为了计入加密开销，每块结束时连同发送队列一起丢弃
+        SendQueue replies(pool);
+        size_t fed = 0;
+        while (fed < chunk.length) {
+            uint64_t start = Metrics::NowNanos();
+            fed += reader.Feed(chunk.data + fed, chunk.length - fed);
+            while (true) {
+                char* cipherText;
+                uint32_t cipherTextLength;
+                uint8_t flags;
+                bool more = reader.Next(cipherText, cipherTextLength, flags);
+                uint64_t framed = Metrics::NowNanos();
+                stats.stageNanos[STAGE_FRAMING] += framed - start;
+                if (!more) {
+                    break;
+                }
+                stats.frames++;
+                stats.bytes += FRAME_HEADER_SIZE + cipherTextLength;
+                if (flags & FRAME_FLAG_KEEPALIVE) {
+                    start = framed;
+                    continue;
+                }
+
+                char* plainText;
+                int plainTextLength = OpenMessage(crypto, cipherText, cipherTextLength, flags, plainText);
+                uint64_t opened = Metrics::NowNanos();
+                stats.stageNanos[STAGE_DECRYPT] += opened - framed;
+                stats.decryptLatency.Record(opened - framed);
+                if (plainTextLength < 0) {
+                    std::cerr << "Error: Malformed or forged frame in capture (frame " << stats.frames << ")." << std::endl;
+                    return false;
+                }
+
+                // 与服务器相同：退出命令结束会话，其余消息回显或转发
+                bool chatMessage = (flags & ~FRAME_FLAGS_TRANSPORT) == 0;
+                bool quit = chatMessage && plainTextLength == (int)strlen(EXIT_COMMAND) &&
+                            memcmp(plainText, EXIT_COMMAND, plainTextLength) == 0;
+                if (!quit && options.echo) {
+                    QueueMessage(replies, crypto, plainText, plainTextLength, flags & ~FRAME_FLAGS_TRANSPORT);
+                    stats.replies++;
+                }
+                start = Metrics::NowNanos();
+                stats.stageNanos[STAGE_DISPATCH] += start - opened;
+                if (quit) {
+                    return true;
+                }
+            }
+            if (reader.Oversized()) {
+                std::cerr << "Error: Oversized frame in capture (frame " << stats.frames + 1 << ")." << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void Report(const CaptureReader& capture, const ReplayOptions& options, const ReplayStats& stats, double elapsed) {
+    uint64_t staged = 0;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        staged += stats.stageNanos[i];
+    }
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Replayed " << capture.Chunks().size() << " chunks, " << capture.Bytes() << " bytes x "
+              << options.repeat << (options.paced ? " (paced)" : "") << " in " << std::setprecision(3) << elapsed << " s" << std::endl;
+    std::cout << std::setprecision(1);
+    std::cout << "Frames: " << stats.frames << " (" << stats.frames / elapsed << "/s), "
+              << stats.bytes / elapsed / 1e6 << " MB/s";
+    if (options.echo) {
+        std::cout << ", " << stats.replies << " replies";
+    }
+    std::cout << std::endl;
+    std::cout << std::left << std::setw(10) << "stage" << std::right << std::setw(12) << "total ms"
+              << std::setw(12) << "ns/frame" << std::setw(8) << "share" << std::endl;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        std::cout << std::left << std::setw(10) << STAGE_NAMES[i] << std::right
+                  << std::setw(12) << stats.stageNanos[i] / 1e6
+                  << std::setw(12) << (stats.frames ? (double)stats.stageNanos[i] / stats.frames : 0.0)
+                  << std::setw(7) << (staged ? 100.0 * stats.stageNanos[i] / staged : 0.0) << "%" << std::endl;
+    }
+    const Histogram& histogram = stats.decryptLatency;
+    std::cout << "Decrypt latency (us): p50 " << histogram.Percentile(0.50) / 1000.0
+              << ", p99 " << histogram.Percentile(0.99) / 1000.0
+              << ", max " << histogram.Max() / 1000.0 << std::endl;
+}
+
+static void Usage(const char* program) {
+    std::cerr << "Usage: " << program << " CAPTURE [--paced] [--echo] [--repeat N]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    ReplayOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--paced") == 0) {
+            options.paced = true;
+        } else if (strcmp(arg, "--echo") == 0) {
+            options.echo = true;
+        } else if (strcmp(arg, "--repeat") == 0 && i + 1 < argc) {
+            options.repeat = atoi(argv[++i]);
+        } else if (arg[0] != '-' && options.path == nullptr) {
+            options.path = arg;
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.path == nullptr || options.repeat < 1) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    CaptureReader capture;
+    if (!capture.Open(options.path)) {
+        return 1;
+    }
+    ReplayStats stats;
+    uint64_t start = Metrics::NowNanos();
+    for (int pass = 0; pass < options.repeat; pass++) {
+        if (!ReplayPass(capture, options, stats)) {
+            return 1;
+        }
+    }
+    double elapsed = (Metrics::NowNanos() - start) / 1e9;
+    Report(capture, options, stats, elapsed > 0 ? elapsed : 1e-9);
+    return 0;
+}